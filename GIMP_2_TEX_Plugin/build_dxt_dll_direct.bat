@@ -14,7 +14,7 @@ if not exist "%MINGW_PATH%\g++.exe" (
 echo Using MinGW from: %MINGW_PATH%
 echo.
 
-"%MINGW_PATH%\g++.exe" -shared -O3 -static-libgcc -static-libstdc++ -o dxt_compress.dll dxt_compress.cpp
+"%MINGW_PATH%\g++.exe" -shared -O3 -mssse3 -static-libgcc -static-libstdc++ -o dxt_compress.dll dxt_compress.cpp
 
 if exist dxt_compress.dll (
     echo.
@@ -1,11 +1,17 @@
 /*
 Fast DXT5 compression library for GIMP TEX plugin
 Compile with: cl /LD /O2 dxt_compress.cpp /Fe:dxt_compress.dll
-Or with MinGW: g++ -shared -O3 -o dxt_compress.dll dxt_compress.cpp
+Or with MinGW: g++ -shared -O3 -mssse3 -o dxt_compress.dll dxt_compress.cpp
+(-mssse3 enables the pshufb swizzle; MSVC builds use the scalar loop)
 */
 
 #include <cstdint>
 #include <algorithm>
+#include <cstring>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 extern "C" {
 
@@ -344,4 +350,24 @@ __declspec(dllexport) void decompress_dxt5(const uint8_t* input, int width, int
     }
 }
 
+// Swap the red and blue channels: BGRA8 to RGBA and back. src and dst may be the same buffer
+// but must not otherwise overlap.
+__declspec(dllexport) void tex_swizzle_bgra(const uint8_t* src, uint8_t* dst, long long pixel_count) {
+    long long i = 0;
+#ifdef __SSSE3__
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(pixels, order));
+    }
+#endif
+    // Whole pixel loads and stores, which the compiler vectorizes when SSSE3 is not enabled
+    for (; i < pixel_count; i++) {
+        uint32_t pixel;
+        memcpy(&pixel, src + i * 4, 4);
+        pixel = (pixel & 0xFF00FF00u) | ((pixel >> 16) & 0xFFu) | ((pixel & 0xFFu) << 16);
+        memcpy(dst + i * 4, &pixel, 4);
+    }
+}
+
 } // extern "C"
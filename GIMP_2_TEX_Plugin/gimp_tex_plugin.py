@@ -284,10 +284,11 @@ def convert_dds_to_tex(dds_path, tex_path):
 
 _dxt_dll = None
 _has_fast_compression = False
+_has_swizzle = False
 
 def init_fast_compression():
     """Initialize fast DXT compression library"""
-    global _dxt_dll, _has_fast_compression
+    global _dxt_dll, _has_fast_compression, _has_swizzle
     
     if _has_fast_compression:
         return True
@@ -310,6 +311,16 @@ def init_fast_compression():
             ]
             _dxt_dll.compress_dxt5.restype = None
             
+            # Native BGRA8 conversion, missing from DLLs built before it was added
+            if hasattr(_dxt_dll, 'tex_swizzle_bgra'):
+                _dxt_dll.tex_swizzle_bgra.argtypes = [
+                    ctypes.POINTER(ctypes.c_ubyte),  # input
+                    ctypes.POINTER(ctypes.c_ubyte),  # output, may be the input
+                    ctypes.c_longlong                 # pixel count
+                ]
+                _dxt_dll.tex_swizzle_bgra.restype = None
+                _has_swizzle = True
+            
             _has_fast_compression = True
             sys.stderr.write("Fast DXT compression DLL loaded!\n")
             sys.stderr.flush()
@@ -446,6 +457,35 @@ def fast_decompress_dxt5(compressed_data, width, height):
         return None
 
 
+def fast_swizzle_bgra(pixel_data, width, height):
+    """Swap the red and blue channels (BGRA8 <-> RGBA) using the DLL. Returns None when the
+    DLL is not available."""
+    if not _has_fast_compression:
+        if not init_fast_compression():
+            return None
+    if not _has_swizzle:
+        return None
+    
+    try:
+        import ctypes
+        pixel_count = width * height
+        if len(pixel_data) < pixel_count * 4:
+            return None
+        if not isinstance(pixel_data, str):
+            pixel_data = bytes(bytearray(pixel_data))
+        
+        # One copy into a ctypes buffer, swapped in place
+        buffer = ctypes.create_string_buffer(pixel_data[:pixel_count * 4], pixel_count * 4)
+        pointer = ctypes.cast(buffer, ctypes.POINTER(ctypes.c_ubyte))
+        _dxt_dll.tex_swizzle_bgra(pointer, pointer, pixel_count)
+        return buffer.raw
+        
+    except Exception as e:
+        sys.stderr.write("Fast BGRA8 conversion failed: {}\n".format(str(e)))
+        sys.stderr.flush()
+        return None
+
+
 # ============================================================================
 # DXT1/DXT5 Decompression
 # ============================================================================
@@ -580,6 +620,10 @@ def decompress_tex_to_rgba(tex):
         data = str(data)
     
     if tex.format == TEXFormat.BGRA8:
+        fast_result = fast_swizzle_bgra(data, width, height)
+        if fast_result:
+            return fast_result
+        
         # BGRA8 is uncompressed - just copy with byte swap
         pixels = bytearray(width * height * 4)
         for i in range(0, len(data), 4):
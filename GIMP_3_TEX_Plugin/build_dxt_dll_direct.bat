@@ -14,7 +14,8 @@ if not exist "%MINGW_PATH%\g++.exe" (
 echo Using MinGW from: %MINGW_PATH%
 echo.
 
-"%MINGW_PATH%\g++.exe" -shared -O3 -march=native -fopenmp -static-libgcc -static-libstdc++ -o dxt_compress.dll dxt_compress.cpp
+rem Add -DTEX_TRACE to write a Chrome trace timeline (~/gimp_tex_plugin_3_trace.json) on every load/export
+"%MINGW_PATH%\g++.exe" -shared -O3 -march=native -fopenmp -static-libgcc -static-libstdc++ -o dxt_compress.dll dxt_compress.cpp tex_file.cpp tex_mip.cpp tex_thumbnail_cache.cpp tex_trace.cpp tex_alloc.cpp tex_size_estimate.cpp
 
 if exist dxt_compress.dll (
     echo.
@@ -0,0 +1,54 @@
+@echo off
+echo Building TEX command line tools with MinGW...
+echo.
+
+set MINGW_PATH=C:\Users\Frog\Desktop\mingw64\bin
+
+if not exist "%MINGW_PATH%\g++.exe" (
+    echo ERROR: g++.exe not found at %MINGW_PATH%
+    echo Please check the MinGW path
+    pause
+    exit /b 1
+)
+
+echo Using MinGW from: %MINGW_PATH%
+echo.
+
+set LIB_SOURCES=dxt_compress.cpp tex_file.cpp tex_mip.cpp tex_trace.cpp tex_alloc.cpp tex_size_estimate.cpp
+set FLAGS=-O3 -march=native -fopenmp -static-libgcc -static-libstdc++
+
+echo Building tex_batch_convert.exe...
+"%MINGW_PATH%\g++.exe" %FLAGS% -o tex_batch_convert.exe tex_batch_convert.cpp %LIB_SOURCES%
+
+echo Building dxt_benchmark.exe...
+"%MINGW_PATH%\g++.exe" %FLAGS% -o dxt_benchmark.exe dxt_benchmark.cpp tex_corpus.cpp tex_thumbnail_cache.cpp %LIB_SOURCES%
+
+echo Building tex_corpus_gen.exe...
+"%MINGW_PATH%\g++.exe" %FLAGS% -o tex_corpus_gen.exe tex_corpus_gen.cpp tex_corpus.cpp %LIB_SOURCES%
+
+echo Building dxt_quality.exe...
+"%MINGW_PATH%\g++.exe" %FLAGS% -DDXT_REFERENCE_ENCODERS -o dxt_quality.exe dxt_quality.cpp reference_encoders.cpp tex_metrics.cpp tex_corpus.cpp %LIB_SOURCES%
+
+echo Building dxt_fuzz.exe...
+"%MINGW_PATH%\g++.exe" %FLAGS% -o dxt_fuzz.exe dxt_fuzz.cpp %LIB_SOURCES%
+
+echo Building tex_size_check.exe...
+"%MINGW_PATH%\g++.exe" %FLAGS% -o tex_size_check.exe tex_size_check.cpp tex_corpus.cpp %LIB_SOURCES%
+
+set TOOLS_OK=1
+if not exist tex_batch_convert.exe set TOOLS_OK=0
+if not exist dxt_benchmark.exe set TOOLS_OK=0
+if not exist tex_corpus_gen.exe set TOOLS_OK=0
+if not exist dxt_quality.exe set TOOLS_OK=0
+if not exist dxt_fuzz.exe set TOOLS_OK=0
+if not exist tex_size_check.exe set TOOLS_OK=0
+
+echo.
+if "%TOOLS_OK%"=="1" (
+    echo SUCCESS! Tools built
+) else (
+    echo ERROR: some tools were not created
+    echo Check for compilation errors above
+)
+echo.
+pause
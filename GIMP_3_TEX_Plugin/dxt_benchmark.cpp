@@ -0,0 +1,1573 @@
+/*
+Benchmarks for the DXT codec kernels
+
+  dxt_benchmark kernels    Per block timing of every kernel variant on fixed block sets
+  dxt_benchmark images     Whole image throughput and thread scaling from 64x64 up to 16Kx16K;
+                           --pages regular,transparent,explicit also compares huge page backed buffers
+  dxt_benchmark prefetch   Cold cache 8K encode and decode at each software prefetch distance
+  dxt_benchmark memory     Load, export and thumbnail paths with library peak allocation and peak RSS
+  dxt_benchmark batch      4 MP of 16x16 to 256x256 DXT5 textures, decoded a call each and with decompress_batch
+
+Both modes can write their results with --csv file and --json file for plotting.
+With --baseline file.json the run is compared against stored results for the same machine
+class and exits with status 3 when any kernel got slower beyond the noise-aware threshold,
+or when a memory run allocates more at its peak than the baseline did. A baseline from another
+machine class (architecture, CPU model and thread count) is skipped, not compared.
+Baselines live in bench_baselines/<machine class>-<mode>.json.
+On Linux, kernels --counters also reads hardware performance counters (perf_event_open)
+around every kernel and reports IPC, cache misses and branch mispredicts per block.
+
+Compile with: g++ -O3 -march=native -fopenmp -o dxt_benchmark.exe dxt_benchmark.cpp tex_corpus.cpp dxt_compress.cpp tex_file.cpp tex_mip.cpp tex_alloc.cpp tex_thumbnail_cache.cpp
+*/
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef _WIN32
+#define PSAPI_VERSION 2  // GetProcessMemoryInfo from kernel32, no extra import library
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BENCH_HAS_PERF 1
+#endif
+
+#include "dxt_compress.h"
+#include "tex_corpus.h"
+
+// ============================================================================
+// Fixed block sets
+// ============================================================================
+
+// Each set is a 256x256 RGBA image, i.e. 4096 blocks
+static const int SET_SIZE = 256;
+static const int SET_BLOCKS = (SET_SIZE / 4) * (SET_SIZE / 4);
+
+struct BlockSet {
+    std::string name;
+    std::vector<uint8_t> rgba;
+    std::vector<uint8_t> dxt1;
+    std::vector<uint8_t> dxt5;
+};
+
+static uint32_t lcg_next(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static BlockSet make_block_set(const char* name) {
+    BlockSet set;
+    set.name = name;
+    set.rgba.resize(SET_SIZE * SET_SIZE * 4);
+    uint32_t state = 12345;
+
+    for (int y = 0; y < SET_SIZE; y++) {
+        for (int x = 0; x < SET_SIZE; x++) {
+            uint8_t* p = &set.rgba[(y * SET_SIZE + x) * 4];
+            if (set.name == "solid") {
+                // One color per block
+                int block = (y / 4) * (SET_SIZE / 4) + x / 4;
+                p[0] = (uint8_t)(block * 37);
+                p[1] = (uint8_t)(block * 91);
+                p[2] = (uint8_t)(block * 13);
+                p[3] = 255;
+            } else if (set.name == "gradient") {
+                p[0] = (uint8_t)x;
+                p[1] = (uint8_t)y;
+                p[2] = (uint8_t)((x + y) / 2);
+                p[3] = (uint8_t)(255 - y);
+            } else if (set.name == "noise") {
+                uint32_t r = lcg_next(state);
+                p[0] = (uint8_t)r;
+                p[1] = (uint8_t)(r >> 8);
+                p[2] = (uint8_t)(r >> 16);
+                p[3] = (uint8_t)lcg_next(state);
+            } else {
+                // alpha edge: opaque color on one side of a diagonal, transparent on the other
+                bool opaque = ((x + y * 3) % 8) < 4;
+                p[0] = (uint8_t)(x * 5);
+                p[1] = (uint8_t)(200 - y);
+                p[2] = 64;
+                p[3] = opaque ? 255 : 0;
+            }
+        }
+    }
+
+    set.dxt5.resize(SET_BLOCKS * 16);
+    compress_dxt5(set.rgba.data(), SET_SIZE, SET_SIZE, set.dxt5.data());
+
+    // DXT1 blocks are the color half of the DXT5 blocks
+    set.dxt1.resize(SET_BLOCKS * 8);
+    for (int i = 0; i < SET_BLOCKS; i++) {
+        memcpy(&set.dxt1[i * 8], &set.dxt5[i * 16 + 8], 8);
+    }
+    return set;
+}
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+struct BenchOptions {
+    int warmup = 3;
+    int reps = 15;
+    std::string filter;
+    int min_size = 64;
+    int max_size = 16384;
+    int max_threads = 0;  // 0 = all cores
+    CorpusKind dataset = CORPUS_GRADIENT;
+    uint64_t seed = 1;
+    std::string csv_path;
+    std::string json_path;
+    std::string baseline_path;
+    std::string machine_class;
+    double threshold = 10.0;  // percent slowdown tolerated on top of the confidence intervals
+    bool counters = false;
+    std::vector<int> page_modes = {TEX_PAGES_REGULAR};
+    std::vector<int> prefetch_distances = {0, 2, 4, 8, 16, 32, 64};
+};
+
+// One measured configuration; samples hold the primary metric of every repetition
+struct BenchResult {
+    std::string bench;
+    std::string kernel;
+    std::string isa;
+    std::string pages = "regular";  // page mode of the image buffers (images mode)
+    std::string dataset;
+    int width = 0;
+    int height = 0;
+    int threads = 1;
+    std::string unit;
+    std::vector<double> samples;
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+struct Summary {
+    double median;
+    double mean;
+    double stddev;
+    double min;
+};
+
+static Summary summarize(std::vector<double> values) {
+    Summary s;
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    s.median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    s.min = values[0];
+    double sum = 0;
+    for (double v : values) {
+        sum += v;
+    }
+    s.mean = sum / n;
+    double sq = 0;
+    for (double v : values) {
+        sq += (v - s.mean) * (v - s.mean);
+    }
+    s.stddev = n > 1 ? std::sqrt(sq / (n - 1)) : 0;
+    return s;
+}
+
+// ============================================================================
+// Hardware performance counters
+// ============================================================================
+
+enum CounterId {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_COUNT
+};
+
+static const char* COUNTER_NAMES[COUNTER_COUNT] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+// User space counters for the calling thread. Each counter is opened on its own so a CPU or
+// VM that lacks one (LLC misses are often missing) still reports the rest; counts are scaled
+// when the kernel had to multiplex them.
+class PerfCounters {
+public:
+    PerfCounters() {
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            fds_[i] = -1;
+            totals_[i] = 0;
+        }
+    }
+
+    ~PerfCounters() {
+#ifdef BENCH_HAS_PERF
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    // Returns the number of counters that could be opened
+    int open_all() {
+        int opened = 0;
+#ifdef BENCH_HAS_PERF
+        const uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const struct {
+            uint32_t type;
+            uint64_t config;
+        } events[COUNTER_COUNT] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, l1d_read_miss},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[i].type;
+            attr.config = events[i].config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds_[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds_[i] >= 0) {
+                opened++;
+            }
+        }
+#endif
+        return opened;
+    }
+
+    bool has(CounterId id) const { return fds_[id] >= 0; }
+    double total(CounterId id) const { return totals_[id]; }
+
+    void start() {
+#ifdef BENCH_HAS_PERF
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            totals_[i] = 0;
+            if (fds_[i] >= 0) {
+                ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void stop() {
+#ifdef BENCH_HAS_PERF
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (fds_[i] < 0) {
+                continue;
+            }
+            ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t values[3] = {0, 0, 0};  // count, time enabled, time running
+            if (read(fds_[i], values, sizeof(values)) == (ssize_t)sizeof(values) && values[2] > 0) {
+                totals_[i] = (double)values[0] * ((double)values[1] / (double)values[2]);
+            }
+        }
+#endif
+    }
+
+private:
+    int fds_[COUNTER_COUNT];
+    double totals_[COUNTER_COUNT];
+};
+
+// ============================================================================
+// Per block kernel timing
+// ============================================================================
+
+static uint64_t read_cycles() {
+#ifdef BENCH_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Runs body over the whole block set once per sample; returns per block figures.
+// When counters is given they cover all timed samples; returns the number of blocks they saw.
+template <typename Body>
+static double time_kernel(const BenchOptions& options, Body body, std::vector<double>& ns_per_block, std::vector<double>& cycles_per_block,
+                          PerfCounters* counters) {
+    // Enough passes per sample that one sample takes roughly a millisecond or more
+    int passes = 1;
+    for (;;) {
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < passes; p++) {
+            body();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (ns > 1e6 || passes >= (1 << 16)) {
+            break;
+        }
+        passes *= 2;
+    }
+
+    for (int i = 0; i < options.warmup; i++) {
+        body();
+    }
+
+    ns_per_block.clear();
+    cycles_per_block.clear();
+    if (counters) {
+        counters->start();
+    }
+    for (int r = 0; r < options.reps; r++) {
+        uint64_t c0 = read_cycles();
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < passes; p++) {
+            body();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        uint64_t c1 = read_cycles();
+        double blocks = (double)passes * SET_BLOCKS;
+        ns_per_block.push_back(ns / blocks);
+        cycles_per_block.push_back((double)(c1 - c0) / blocks);
+    }
+    if (counters) {
+        counters->stop();
+    }
+    return (double)passes * SET_BLOCKS * options.reps;
+}
+
+// Keeps the optimizer from discarding kernel output
+static volatile uint8_t g_sink;
+
+static int run_kernels(const BenchOptions& options, std::vector<BenchResult>& results) {
+    const char* set_names[] = {"solid", "gradient", "noise", "alpha_edge"};
+    std::vector<BlockSet> sets;
+    for (const char* name : set_names) {
+        sets.push_back(make_block_set(name));
+    }
+
+    PerfCounters counters;
+    bool use_counters = false;
+    if (options.counters) {
+        use_counters = counters.open_all() > 0;
+        if (!use_counters) {
+            printf("WARNING: no hardware counters available (needs Linux and perf_event_paranoid <= 2)\n");
+        }
+    }
+
+    printf("%-8s %-22s %-11s %10s %10s %12s %12s", "isa", "kernel", "blocks", "ns/block", "+-stddev", "blocks/s", "cycles/blk");
+    if (use_counters) {
+        printf(" %6s %10s %10s %10s", "IPC", "L1D/blk", "LLC/blk", "brmiss/blk");
+    }
+    printf("\n");
+
+    std::vector<uint8_t> out_blocks(SET_BLOCKS * 16);
+    std::vector<uint8_t> out_rgba(SET_SIZE * SET_SIZE * 4);
+    std::vector<double> ns, cycles;
+
+    for (int v = 0; v < DXT_KERNEL_VARIANT_COUNT; v++) {
+        const DxtKernelVariant& variant = DXT_KERNEL_VARIANTS[v];
+        if (!variant.supported()) {
+            printf("%-8s (not supported on this CPU, skipped)\n", variant.isa);
+            continue;
+        }
+
+        for (const BlockSet& set : sets) {
+            struct {
+                const char* name;
+                void (*run)(const DxtKernelVariant&, const BlockSet&, uint8_t*, uint8_t*);
+            } kernels[] = {
+                {"compress_dxt5_block", [](const DxtKernelVariant& v, const BlockSet& s, uint8_t* blocks, uint8_t*) {
+                     for (int i = 0; i < SET_BLOCKS; i++) {
+                         int bx = i % (SET_SIZE / 4), by = i / (SET_SIZE / 4);
+                         v.compress_dxt5_block(s.rgba.data(), bx * 4, by * 4, SET_SIZE, SET_SIZE, blocks + i * 16);
+                     }
+                 }},
+                {"decompress_dxt1_block", [](const DxtKernelVariant& v, const BlockSet& s, uint8_t*, uint8_t* rgba) {
+                     for (int i = 0; i < SET_BLOCKS; i++) {
+                         int bx = i % (SET_SIZE / 4), by = i / (SET_SIZE / 4);
+                         v.decompress_dxt1_block(&s.dxt1[i * 8], bx * 4, by * 4, SET_SIZE, SET_SIZE, rgba);
+                     }
+                 }},
+                {"decompress_dxt5_block", [](const DxtKernelVariant& v, const BlockSet& s, uint8_t*, uint8_t* rgba) {
+                     for (int i = 0; i < SET_BLOCKS; i++) {
+                         int bx = i % (SET_SIZE / 4), by = i / (SET_SIZE / 4);
+                         v.decompress_dxt5_block(&s.dxt5[i * 16], bx * 4, by * 4, SET_SIZE, SET_SIZE, rgba);
+                     }
+                 }},
+            };
+
+            for (auto& kernel : kernels) {
+                if (!options.filter.empty() && strstr(kernel.name, options.filter.c_str()) == nullptr &&
+                    set.name.find(options.filter) == std::string::npos) {
+                    continue;
+                }
+                double counted_blocks = time_kernel(options, [&] {
+                    kernel.run(variant, set, out_blocks.data(), out_rgba.data());
+                    g_sink = out_blocks[0] ^ out_rgba[0];
+                }, ns, cycles, use_counters ? &counters : nullptr);
+
+                Summary ns_stats = summarize(ns);
+                Summary cycle_stats = summarize(cycles);
+                printf("%-8s %-22s %-11s %10.2f %10.2f %12.0f %12.1f", variant.isa, kernel.name, set.name.c_str(),
+                       ns_stats.median, ns_stats.stddev, 1e9 / ns_stats.median, cycle_stats.median);
+
+                BenchResult result;
+                result.bench = "kernels";
+                result.kernel = kernel.name;
+                result.isa = variant.isa;
+                result.dataset = set.name;
+                result.width = SET_SIZE;
+                result.height = SET_SIZE;
+                result.unit = "ns_per_block";
+                result.samples = ns;
+                result.metrics = {{"ns_per_block", ns_stats.median}, {"stddev_ns", ns_stats.stddev},
+                                  {"blocks_per_s", 1e9 / ns_stats.median}, {"cycles_per_block", cycle_stats.median}};
+
+                // Missing counters print as "-" and are left out of the metrics
+                if (use_counters) {
+                    auto per_block = [&](CounterId id, const char* metric) {
+                        if (!counters.has(id)) {
+                            printf(" %10s", "-");
+                            return;
+                        }
+                        double value = counters.total(id) / counted_blocks;
+                        printf(" %10.3f", value);
+                        result.metrics.push_back({metric, value});
+                    };
+                    if (counters.has(COUNTER_CYCLES) && counters.has(COUNTER_INSTRUCTIONS) && counters.total(COUNTER_CYCLES) > 0) {
+                        double ipc = counters.total(COUNTER_INSTRUCTIONS) / counters.total(COUNTER_CYCLES);
+                        printf(" %6.2f", ipc);
+                        result.metrics.push_back({"ipc", ipc});
+                    } else {
+                        printf(" %6s", "-");
+                    }
+                    per_block(COUNTER_L1D_MISSES, "l1d_misses_per_block");
+                    per_block(COUNTER_LLC_MISSES, "llc_misses_per_block");
+                    per_block(COUNTER_BRANCH_MISSES, "branch_misses_per_block");
+                    for (int c = 0; c < COUNTER_COUNT; c++) {
+                        if (counters.has((CounterId)c)) {
+                            result.metrics.push_back({std::string(COUNTER_NAMES[c]) + "_total", counters.total((CounterId)c)});
+                        }
+                    }
+                }
+                printf("\n");
+                results.push_back(result);
+            }
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// Whole image throughput
+// ============================================================================
+
+static int available_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+static void set_threads(int threads) {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#else
+    (void)threads;
+#endif
+}
+
+static const char* PAGE_MODE_NAMES[] = {"regular", "transparent", "explicit"};
+
+static int run_images(const BenchOptions& options, std::vector<BenchResult>& results) {
+    int all_threads = options.max_threads > 0 ? options.max_threads : available_threads();
+    std::vector<int> thread_counts;
+    for (int t = 1; t < all_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(all_threads);
+
+    printf("%-16s %11s %-11s %7s %10s %9s %9s %9s %8s %7s %8s\n", "op", "size", "pages", "threads", "ms", "MP/s",
+           "GB/s in", "GB/s out", "eff", "cv%", "vs reg");
+
+    for (int size = options.min_size; size <= options.max_size; size *= 2) {
+        size_t pixels = (size_t)size * size;
+        size_t dxt5_bytes = (size_t)((size + 3) / 4) * ((size + 3) / 4) * 16;
+        // Median ms with regular pages per op and thread count, for the huge page gain
+        std::vector<double> regular_ms(3 * thread_counts.size(), 0);
+        bool out_of_memory = false;
+
+        for (int page_mode : options.page_modes) {
+            // Buffers come from the library allocator so the page mode applies to them; they are
+            // written once before timing, so page faults stay out of the measurement
+            tex_set_huge_pages(page_mode, 0);
+            TexAllocStats before;
+            tex_get_alloc_stats(&before);
+            TexBuffer rgba(pixels * 4);
+            TexBuffer dxt5(dxt5_bytes);
+            TexBuffer dxt1(dxt5_bytes / 2);
+            TexBuffer decoded(pixels * 4);
+            TexAllocStats after;
+            tex_get_alloc_stats(&after);
+            tex_set_huge_pages(TEX_PAGES_REGULAR, 0);
+            if (!rgba.ok() || !dxt5.ok() || !dxt1.ok() || !decoded.ok()) {
+                printf("%dx%d: not enough memory, stopping\n", size, size);
+                out_of_memory = true;
+                break;
+            }
+            long long huge_buffers = after.huge_page_allocs - before.huge_page_allocs;
+
+            corpus_generate(options.dataset, options.seed, size, size, rgba.data());
+            compress_dxt5(rgba.data(), size, size, dxt5.data());
+            for (size_t i = 0; i < dxt5_bytes / 16; i++) {
+                memcpy(dxt1.data() + i * 8, dxt5.data() + i * 16 + 8, 8);
+            }
+            memset(decoded.data(), 0, decoded.size());
+
+            struct {
+                const char* name;
+                const uint8_t* input;
+                size_t input_bytes;
+                uint8_t* output;
+                size_t output_bytes;
+                void (*run)(const uint8_t*, int, int, uint8_t*);
+            } ops[] = {
+                {"compress_dxt5", rgba.data(), pixels * 4, dxt5.data(), dxt5_bytes, compress_dxt5},
+                {"decompress_dxt1", dxt1.data(), dxt5_bytes / 2, decoded.data(), pixels * 4, decompress_dxt1},
+                {"decompress_dxt5", dxt5.data(), dxt5_bytes, decoded.data(), pixels * 4, decompress_dxt5},
+            };
+
+            for (int o = 0; o < 3; o++) {
+                auto& op = ops[o];
+                if (!options.filter.empty() && strstr(op.name, options.filter.c_str()) == nullptr) {
+                    continue;
+                }
+                double single_thread_ms = 0;
+                for (size_t t = 0; t < thread_counts.size(); t++) {
+                    int threads = thread_counts[t];
+                    set_threads(threads);
+                    for (int i = 0; i < options.warmup; i++) {
+                        op.run(op.input, size, size, op.output);
+                    }
+
+                    std::vector<double> ms;
+                    for (int r = 0; r < options.reps; r++) {
+                        auto start = std::chrono::steady_clock::now();
+                        op.run(op.input, size, size, op.output);
+                        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                    }
+                    g_sink = op.output[0];
+
+                    Summary stats = summarize(ms);
+                    if (threads == 1) {
+                        single_thread_ms = stats.median;
+                    }
+                    double& regular = regular_ms[o * thread_counts.size() + t];
+                    if (page_mode == TEX_PAGES_REGULAR) {
+                        regular = stats.median;
+                    }
+                    double mps = pixels / (stats.median * 1e3);
+                    double gbs_in = op.input_bytes / (stats.median * 1e6);
+                    double gbs_out = op.output_bytes / (stats.median * 1e6);
+                    double efficiency = single_thread_ms > 0 ? single_thread_ms / (stats.median * threads) : 0;
+                    double cv = stats.mean > 0 ? 100.0 * stats.stddev / stats.mean : 0;
+                    double speedup = regular > 0 ? regular / stats.median : 0;
+                    char speedup_text[16] = "-";
+                    if (speedup > 0 && page_mode != TEX_PAGES_REGULAR) {
+                        snprintf(speedup_text, sizeof(speedup_text), "%.3fx", speedup);
+                    }
+                    printf("%-16s %5dx%-5d %-11s %7d %10.3f %9.1f %9.2f %9.2f %8.2f %7.2f %8s\n", op.name, size, size,
+                           PAGE_MODE_NAMES[page_mode], threads, stats.median, mps, gbs_in, gbs_out, efficiency, cv, speedup_text);
+
+                    BenchResult result;
+                    result.bench = "images";
+                    result.kernel = op.name;
+                    result.isa = "native";
+                    result.pages = PAGE_MODE_NAMES[page_mode];
+                    result.dataset = corpus_kind_name(options.dataset);
+                    result.width = size;
+                    result.height = size;
+                    result.threads = threads;
+                    result.unit = "ms";
+                    result.samples = ms;
+                    result.metrics = {{"ms", stats.median}, {"mp_per_s", mps}, {"gb_per_s_in", gbs_in},
+                                      {"gb_per_s_out", gbs_out}, {"efficiency", efficiency}, {"cv_percent", cv},
+                                      {"huge_page_buffers", (double)huge_buffers}};
+                    if (page_mode != TEX_PAGES_REGULAR && speedup > 0) {
+                        result.metrics.push_back({"speedup_vs_regular", speedup});
+                    }
+                    results.push_back(result);
+                }
+            }
+            if (page_mode != TEX_PAGES_REGULAR) {
+                printf("%-16s %5dx%-5d %-11s %lld of 4 buffers got huge pages\n", "", size, size, PAGE_MODE_NAMES[page_mode], huge_buffers);
+            }
+        }
+        if (out_of_memory) {
+            break;
+        }
+    }
+    set_threads(available_threads());
+    return 0;
+}
+
+// ============================================================================
+// Memory use of the load and export paths
+// ============================================================================
+
+// Process high-water mark; it never goes down, so sizes are run smallest first
+static double peak_rss_mb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);  // bytes
+#else
+    return usage.ru_maxrss / 1024.0;  // kilobytes
+#endif
+#endif
+}
+
+static void write_tex_header(uint8_t* bytes, int width, int height, int format) {
+    const uint8_t header[12] = {
+        'T', 'E', 'X', 0,
+        (uint8_t)(width & 0xFF), (uint8_t)(width >> 8),
+        (uint8_t)(height & 0xFF), (uint8_t)(height >> 8),
+        1, (uint8_t)format, 0, 0
+    };
+    memcpy(bytes, header, 12);
+}
+
+// The native halves of what the plugin does: load decodes a TEX image held in memory into a
+// fresh RGBA buffer, export encodes RGBA into a fresh TEX image, thumbnail reads a file from
+// disk. Every buffer comes from the library allocator so its counters see the whole path.
+static int run_memory(const BenchOptions& options, std::vector<BenchResult>& results) {
+    const int thumbnail_dim = 256;
+    std::string temp_path = "dxt_benchmark_memory.tex";
+
+    printf("%-16s %11s %10s %9s %12s %8s %10s %12s\n", "op", "size", "ms", "MP/s", "peak alloc", "allocs", "bytes/px", "peak RSS MB");
+
+    int status = 0;
+    for (int size = options.min_size; size <= options.max_size && status == 0; size *= 2) {
+        size_t pixels = (size_t)size * size;
+        size_t dxt5_bytes = (size_t)tex_level_size(TEX_FORMAT_DXT5, size, size);
+        TexBuffer source(pixels * 4);
+        TexBuffer tex_file(12 + dxt5_bytes);
+        if (!source.ok() || !tex_file.ok()) {
+            printf("%dx%d: not enough memory, stopping\n", size, size);
+            break;
+        }
+        corpus_generate(options.dataset, options.seed, size, size, source.data());
+        write_tex_header(tex_file.data(), size, size, TEX_FORMAT_DXT5);
+        compress_dxt5(source.data(), size, size, tex_file.data() + 12);
+
+        FILE* f = fopen(temp_path.c_str(), "wb");
+        bool written = f && fwrite(tex_file.data(), 1, tex_file.size(), f) == tex_file.size();
+        if (f) {
+            fclose(f);
+        }
+        if (!written) {
+            fprintf(stderr, "ERROR: cannot write %s\n", temp_path.c_str());
+            status = 1;
+            break;
+        }
+
+        struct {
+            const char* name;
+            int (*run)(const TexBuffer& source, const TexBuffer& tex_file, int size, const std::string& temp_path, int thumbnail_dim);
+        } ops[] = {
+            {"load_dxt5", [](const TexBuffer&, const TexBuffer& tex_file, int size, const std::string&, int) {
+                 TexHeader header;
+                 if (tex_parse_header(tex_file.data(), &header) != TEX_OK) {
+                     return TEX_ERR_FORMAT;
+                 }
+                 TexBuffer rgba((size_t)size * size * 4);
+                 if (!rgba.ok()) {
+                     return TEX_ERR_NOMEM;
+                 }
+                 int result = tex_decode_level(header.format, tex_file.data() + 12, header.width, header.height, rgba.data());
+                 g_sink = rgba.data()[0];
+                 return result;
+             }},
+            {"export_dxt5", [](const TexBuffer& source, const TexBuffer&, int size, const std::string&, int) {
+                 TexBuffer out(12 + (size_t)tex_level_size(TEX_FORMAT_DXT5, size, size));
+                 if (!out.ok()) {
+                     return TEX_ERR_NOMEM;
+                 }
+                 write_tex_header(out.data(), size, size, TEX_FORMAT_DXT5);
+                 compress_dxt5(source.data(), size, size, out.data() + 12);
+                 g_sink = out.data()[12];
+                 return TEX_OK;
+             }},
+            {"thumbnail", [](const TexBuffer&, const TexBuffer&, int, const std::string& temp_path, int thumbnail_dim) {
+                 TexBuffer thumb((size_t)thumbnail_dim * thumbnail_dim * 4);
+                 int width, height;
+                 if (!thumb.ok()) {
+                     return TEX_ERR_NOMEM;
+                 }
+                 int result = tex_thumbnail(nullptr, temp_path.c_str(), thumbnail_dim, thumb.data(), &width, &height);
+                 return result < 0 ? result : TEX_OK;
+             }},
+        };
+
+        for (auto& op : ops) {
+            if (!options.filter.empty() && strstr(op.name, options.filter.c_str()) == nullptr) {
+                continue;
+            }
+            for (int i = 0; i < options.warmup; i++) {
+                op.run(source, tex_file, size, temp_path, thumbnail_dim);
+            }
+
+            // Peak and counts cover the timed repetitions only, on top of the inputs held here
+            TexAllocStats before;
+            tex_get_alloc_stats(&before);
+            tex_reset_alloc_stats();
+
+            std::vector<double> ms;
+            for (int r = 0; r < options.reps; r++) {
+                auto start = std::chrono::steady_clock::now();
+                int result = op.run(source, tex_file, size, temp_path, thumbnail_dim);
+                ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                if (result != TEX_OK) {
+                    fprintf(stderr, "ERROR: %s failed at %dx%d (%d)\n", op.name, size, size, result);
+                    status = 1;
+                }
+            }
+
+            TexAllocStats after;
+            tex_get_alloc_stats(&after);
+            double peak_bytes = (double)(after.bytes_peak - before.bytes_current);
+            double allocs_per_call = (double)after.alloc_count / options.reps;
+            double rss = peak_rss_mb();
+
+            Summary stats = summarize(ms);
+            double mps = pixels / (stats.median * 1e3);
+            printf("%-16s %5dx%-5d %10.3f %9.1f %9.2f MB %8.1f %10.2f %12.1f\n", op.name, size, size, stats.median, mps,
+                   peak_bytes / (1024.0 * 1024.0), allocs_per_call, peak_bytes / pixels, rss);
+
+            BenchResult result;
+            result.bench = "memory";
+            result.kernel = op.name;
+            result.isa = "native";
+            result.dataset = corpus_kind_name(options.dataset);
+            result.width = size;
+            result.height = size;
+            result.threads = available_threads();
+            result.unit = "ms";
+            result.samples = ms;
+            result.metrics = {{"ms", stats.median}, {"mp_per_s", mps}, {"peak_alloc_bytes", peak_bytes},
+                              {"allocs_per_call", allocs_per_call}, {"peak_rss_mb", rss}};
+            results.push_back(result);
+        }
+    }
+    remove(temp_path.c_str());
+    return status;
+}
+
+// ============================================================================
+// Software prefetch distance on cold caches
+// ============================================================================
+
+// Larger than the last level cache of current desktop CPUs; written before every timed run so
+// the image starts in memory, the way a freshly loaded 8K texture does
+static const size_t CACHE_FLUSH_BYTES = 128 * 1024 * 1024;
+
+static void flush_caches(TexBuffer& flush) {
+    memset(flush.data(), (int)(g_sink + 1), flush.size());
+    g_sink = flush.data()[flush.size() / 2];
+}
+
+static int run_prefetch(const BenchOptions& options, std::vector<BenchResult>& results) {
+    int size = options.max_size;
+    size_t pixels = (size_t)size * size;
+    size_t dxt5_bytes = (size_t)tex_level_size(TEX_FORMAT_DXT5, size, size);
+    TexBuffer rgba(pixels * 4);
+    TexBuffer dxt5(dxt5_bytes);
+    TexBuffer dxt1(dxt5_bytes / 2);
+    TexBuffer decoded(pixels * 4);
+    TexBuffer flush(CACHE_FLUSH_BYTES);
+    if (!rgba.ok() || !dxt5.ok() || !dxt1.ok() || !decoded.ok() || !flush.ok()) {
+        printf("%dx%d: not enough memory\n", size, size);
+        return 1;
+    }
+    corpus_generate(options.dataset, options.seed, size, size, rgba.data());
+    compress_dxt5(rgba.data(), size, size, dxt5.data());
+    for (size_t i = 0; i < dxt5_bytes / 16; i++) {
+        memcpy(dxt1.data() + i * 8, dxt5.data() + i * 16 + 8, 8);
+    }
+    int threads = options.max_threads > 0 ? options.max_threads : available_threads();
+    set_threads(threads);
+    int previous = tex_get_prefetch_distance();
+
+    struct {
+        const char* name;
+        const uint8_t* input;
+        uint8_t* output;
+        void (*run)(const uint8_t*, int, int, uint8_t*);
+    } ops[] = {
+        {"compress_dxt5", rgba.data(), dxt5.data(), compress_dxt5},
+        {"decompress_dxt1", dxt1.data(), decoded.data(), decompress_dxt1},
+        {"decompress_dxt5", dxt5.data(), decoded.data(), decompress_dxt5},
+    };
+
+    printf("Cold cache %dx%d, %d threads, %zu MB flushed before every run\n", size, size, threads, CACHE_FLUSH_BYTES >> 20);
+    printf("%-16s %9s %10s %9s %7s %8s\n", "op", "distance", "ms", "MP/s", "cv%", "vs off");
+    for (auto& op : ops) {
+        if (!options.filter.empty() && strstr(op.name, options.filter.c_str()) == nullptr) {
+            continue;
+        }
+        double off_ms = 0;
+        for (int distance : options.prefetch_distances) {
+            tex_set_prefetch_distance(distance);
+            for (int i = 0; i < options.warmup; i++) {
+                flush_caches(flush);
+                op.run(op.input, size, size, op.output);
+            }
+            std::vector<double> ms;
+            for (int r = 0; r < options.reps; r++) {
+                flush_caches(flush);
+                auto start = std::chrono::steady_clock::now();
+                op.run(op.input, size, size, op.output);
+                ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+            g_sink = op.output[0];
+
+            Summary stats = summarize(ms);
+            if (distance == 0) {
+                off_ms = stats.median;
+            }
+            double mps = pixels / (stats.median * 1e3);
+            double cv = stats.mean > 0 ? 100.0 * stats.stddev / stats.mean : 0;
+            double speedup = off_ms > 0 ? off_ms / stats.median : 0;
+            char speedup_text[16] = "-";
+            if (speedup > 0 && distance != 0) {
+                snprintf(speedup_text, sizeof(speedup_text), "%.3fx", speedup);
+            }
+            printf("%-16s %9d %10.3f %9.1f %7.2f %8s\n", op.name, distance, stats.median, mps, cv, speedup_text);
+
+            BenchResult result;
+            result.bench = "prefetch";
+            result.kernel = std::string(op.name) + "/prefetch=" + std::to_string(distance);
+            result.isa = "native";
+            result.dataset = corpus_kind_name(options.dataset);
+            result.width = size;
+            result.height = size;
+            result.threads = threads;
+            result.unit = "ms";
+            result.samples = ms;
+            result.metrics = {{"ms", stats.median}, {"mp_per_s", mps}, {"cv_percent", cv}, {"prefetch_blocks", (double)distance}};
+            if (distance != 0 && speedup > 0) {
+                result.metrics.push_back({"speedup_vs_off", speedup});
+            }
+            results.push_back(result);
+        }
+    }
+
+    int tuned = tex_autotune_prefetch();
+    printf("tex_autotune_prefetch picks %d blocks on this machine (library default was %d)\n", tuned, previous);
+    tex_set_prefetch_distance(previous);
+    set_threads(available_threads());
+    return 0;
+}
+
+// ============================================================================
+// Many small textures: a decode call per image against one decompress_batch
+// ============================================================================
+
+// Pixels decoded per size, split over as many textures as it takes
+static const size_t BATCH_PIXELS = 4 << 20;
+
+static int run_batch(const BenchOptions& options, std::vector<BenchResult>& results) {
+    int threads = options.max_threads > 0 ? options.max_threads : available_threads();
+    set_threads(threads);
+    printf("%-16s %11s %7s %7s %10s %9s %7s %8s\n", "op", "size", "images", "threads", "ms", "MP/s", "cv%", "vs each");
+
+    for (int size = options.min_size; size <= options.max_size; size *= 2) {
+        int count = (int)std::max<size_t>(1, BATCH_PIXELS / ((size_t)size * size));
+        size_t level_bytes = (size_t)tex_level_size(TEX_FORMAT_DXT5, size, size);
+        size_t image_bytes = (size_t)size * size * 4;
+        TexBuffer rgba(image_bytes);
+        TexBuffer dxt5(level_bytes * count);
+        TexBuffer decoded(image_bytes * count);
+        if (!rgba.ok() || !dxt5.ok() || !decoded.ok()) {
+            printf("%dx%d: not enough memory, stopping\n", size, size);
+            break;
+        }
+        // Every image its own seed, so the batch does not decode one texture over and over
+        std::vector<TexDecodeJob> jobs(count);
+        for (int j = 0; j < count; j++) {
+            corpus_generate(options.dataset, options.seed + j, size, size, rgba.data());
+            compress_dxt5(rgba.data(), size, size, dxt5.data() + level_bytes * j);
+            jobs[j] = TexDecodeJob{TEX_FORMAT_DXT5, size, size, dxt5.data() + level_bytes * j, decoded.data() + image_bytes * j};
+        }
+        memset(decoded.data(), 0, decoded.size());
+
+        struct {
+            const char* name;
+            void (*run)(const std::vector<TexDecodeJob>& jobs);
+        } ops[] = {
+            {"decompress_each", [](const std::vector<TexDecodeJob>& jobs) {
+                 for (const TexDecodeJob& job : jobs) {
+                     decompress_dxt5(job.input, job.width, job.height, job.rgba);
+                 }
+             }},
+            {"decompress_batch", [](const std::vector<TexDecodeJob>& jobs) {
+                 decompress_batch(jobs.data(), (int)jobs.size(), 0, nullptr);
+             }},
+        };
+
+        double each_ms = 0;
+        for (auto& op : ops) {
+            if (!options.filter.empty() && strstr(op.name, options.filter.c_str()) == nullptr) {
+                continue;
+            }
+            for (int i = 0; i < options.warmup; i++) {
+                op.run(jobs);
+            }
+            std::vector<double> ms;
+            for (int r = 0; r < options.reps; r++) {
+                auto start = std::chrono::steady_clock::now();
+                op.run(jobs);
+                ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+            g_sink = decoded.data()[decoded.size() - 1];
+
+            Summary stats = summarize(ms);
+            if (op.run == ops[0].run) {
+                each_ms = stats.median;
+            }
+            double mps = (double)count * size * size / (stats.median * 1e3);
+            double cv = stats.mean > 0 ? 100.0 * stats.stddev / stats.mean : 0;
+            double speedup = each_ms > 0 ? each_ms / stats.median : 0;
+            char speedup_text[16] = "-";
+            if (speedup > 0 && op.run != ops[0].run) {
+                snprintf(speedup_text, sizeof(speedup_text), "%.3fx", speedup);
+            }
+            printf("%-16s %5dx%-5d %7d %7d %10.3f %9.1f %7.2f %8s\n", op.name, size, size, count, threads, stats.median, mps, cv,
+                   speedup_text);
+
+            BenchResult result;
+            result.bench = "batch";
+            result.kernel = op.name;
+            result.isa = "native";
+            result.dataset = corpus_kind_name(options.dataset);
+            result.width = size;
+            result.height = size;
+            result.threads = threads;
+            result.unit = "ms";
+            result.samples = ms;
+            result.metrics = {{"ms", stats.median}, {"mp_per_s", mps}, {"cv_percent", cv}, {"images", (double)count}};
+            if (op.run != ops[0].run && speedup > 0) {
+                result.metrics.push_back({"speedup_vs_each", speedup});
+            }
+            results.push_back(result);
+        }
+    }
+    set_threads(available_threads());
+    return 0;
+}
+
+// ============================================================================
+// Result output
+// ============================================================================
+
+static bool write_csv(const std::string& path, const std::vector<BenchResult>& results) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    // Metric columns differ per mode, so emit one row per metric
+    fprintf(f, "bench,kernel,isa,pages,dataset,width,height,threads,metric,value\n");
+    for (const BenchResult& r : results) {
+        for (const auto& metric : r.metrics) {
+            fprintf(f, "%s,%s,%s,%s,%s,%d,%d,%d,%s,%.6g\n", r.bench.c_str(), r.kernel.c_str(), r.isa.c_str(), r.pages.c_str(),
+                    r.dataset.c_str(), r.width, r.height, r.threads, metric.first.c_str(), metric.second);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+// CPU model as the processor reports it: the cpuid brand string on x86, otherwise the first
+// model line of /proc/cpuinfo; empty when neither is available
+static std::string cpu_model_name() {
+    std::string name;
+#ifdef BENCH_HAS_TSC
+    unsigned int regs[12] = {};
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] >= 0x80000004) {
+        for (int leaf = 0; leaf < 3; leaf++) {
+            __cpuid((int*)regs + leaf * 4, 0x80000002 + leaf);
+        }
+    }
+#else
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004) {
+        for (unsigned int leaf = 0; leaf < 3; leaf++) {
+            __get_cpuid(0x80000002 + leaf, &regs[leaf * 4], &regs[leaf * 4 + 1], &regs[leaf * 4 + 2], &regs[leaf * 4 + 3]);
+        }
+    }
+#endif
+    name.assign((const char*)regs, strnlen((const char*)regs, sizeof(regs)));
+#endif
+#ifdef __linux__
+    if (name.empty()) {
+        FILE* f = fopen("/proc/cpuinfo", "r");
+        if (f) {
+            char line[256];
+            while (fgets(line, sizeof(line), f)) {
+                const char* colon = strchr(line, ':');
+                if (colon && (strncmp(line, "model name", 10) == 0 || strncmp(line, "Model", 5) == 0 ||
+                              strncmp(line, "CPU part", 8) == 0)) {
+                    name = colon + 1;
+                    break;
+                }
+            }
+            fclose(f);
+        }
+    }
+#endif
+    return name;
+}
+
+// Results are only comparable between runs on the same kind of machine: the architecture, the
+// CPU model in lower case with trademark marks dropped and every other run of punctuation or
+// spaces turned into one dash, and the thread count, e.g. x86_64-intel-core-i7-9700k-cpu-3-60ghz-8t
+static std::string detect_machine_class() {
+#if defined(__x86_64__) || defined(_M_X64)
+    const char* arch = "x86_64";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    const char* arch = "arm64";
+#else
+    const char* arch = "unknown";
+#endif
+    std::string model = cpu_model_name();
+    for (const char* mark : {"(R)", "(r)", "(TM)", "(tm)"}) {
+        for (size_t at = model.find(mark); at != std::string::npos; at = model.find(mark)) {
+            model.erase(at, strlen(mark));
+        }
+    }
+    std::string slug;
+    for (char c : model) {
+        if (isalnum((unsigned char)c)) {
+            slug += (char)tolower((unsigned char)c);
+        } else if (!slug.empty() && slug.back() != '-') {
+            slug += '-';
+        }
+    }
+    while (!slug.empty() && slug.back() == '-') {
+        slug.pop_back();
+    }
+    std::string machine = arch;
+    if (!slug.empty()) {
+        machine += "-" + slug;
+    }
+    return machine + "-" + std::to_string(available_threads()) + "t";
+}
+
+static bool write_json(const std::string& path, const std::string& machine_class, const std::vector<BenchResult>& results) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "{\n  \"machine\": \"%s\",\n  \"results\": [\n", machine_class.c_str());
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        fprintf(f, "    {\"bench\": \"%s\", \"kernel\": \"%s\", \"isa\": \"%s\", \"pages\": \"%s\", \"dataset\": \"%s\", "
+                   "\"width\": %d, \"height\": %d, \"threads\": %d, \"unit\": \"%s\",\n",
+                r.bench.c_str(), r.kernel.c_str(), r.isa.c_str(), r.pages.c_str(), r.dataset.c_str(), r.width, r.height,
+                r.threads, r.unit.c_str());
+        fprintf(f, "     \"metrics\": {");
+        for (size_t m = 0; m < r.metrics.size(); m++) {
+            // Enough digits that byte counts survive exactly, the memory gate compares them
+            fprintf(f, "%s\"%s\": %.10g", m ? ", " : "", r.metrics[m].first.c_str(), r.metrics[m].second);
+        }
+        fprintf(f, "},\n     \"samples\": [");
+        for (size_t s = 0; s < r.samples.size(); s++) {
+            fprintf(f, "%s%.6g", s ? ", " : "", r.samples[s]);
+        }
+        fprintf(f, "]}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+// ============================================================================
+// Baseline comparison
+// ============================================================================
+
+// Minimal JSON reader, enough for the files write_json produces
+struct JsonValue {
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* get(const char* key) const {
+        for (const auto& member : members) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : p_(text.c_str()) {}
+
+    bool parse(JsonValue& value) {
+        return parse_value(value) && (skip_space(), *p_ == 0);
+    }
+
+private:
+    void skip_space() {
+        while (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t') {
+            p_++;
+        }
+    }
+
+    bool parse_string(std::string& out) {
+        if (*p_ != '"') {
+            return false;
+        }
+        p_++;
+        while (*p_ && *p_ != '"') {
+            if (*p_ == '\\' && p_[1]) {
+                p_++;
+            }
+            out += *p_++;
+        }
+        if (*p_ != '"') {
+            return false;
+        }
+        p_++;
+        return true;
+    }
+
+    bool parse_value(JsonValue& value) {
+        skip_space();
+        if (*p_ == '{') {
+            value.type = JsonValue::OBJECT;
+            p_++;
+            skip_space();
+            if (*p_ == '}') {
+                p_++;
+                return true;
+            }
+            for (;;) {
+                std::pair<std::string, JsonValue> member;
+                skip_space();
+                if (!parse_string(member.first)) {
+                    return false;
+                }
+                skip_space();
+                if (*p_++ != ':' || !parse_value(member.second)) {
+                    return false;
+                }
+                value.members.push_back(std::move(member));
+                skip_space();
+                if (*p_ == ',') {
+                    p_++;
+                } else if (*p_ == '}') {
+                    p_++;
+                    return true;
+                } else {
+                    return false;
+                }
+            }
+        }
+        if (*p_ == '[') {
+            value.type = JsonValue::ARRAY;
+            p_++;
+            skip_space();
+            if (*p_ == ']') {
+                p_++;
+                return true;
+            }
+            for (;;) {
+                JsonValue item;
+                if (!parse_value(item)) {
+                    return false;
+                }
+                value.items.push_back(std::move(item));
+                skip_space();
+                if (*p_ == ',') {
+                    p_++;
+                } else if (*p_ == ']') {
+                    p_++;
+                    return true;
+                } else {
+                    return false;
+                }
+            }
+        }
+        if (*p_ == '"') {
+            value.type = JsonValue::STRING;
+            return parse_string(value.text);
+        }
+        if (strncmp(p_, "true", 4) == 0 || strncmp(p_, "false", 5) == 0) {
+            value.type = JsonValue::BOOLEAN;
+            value.number = *p_ == 't';
+            p_ += *p_ == 't' ? 4 : 5;
+            return true;
+        }
+        if (strncmp(p_, "null", 4) == 0) {
+            p_ += 4;
+            return true;
+        }
+        char* end;
+        value.number = strtod(p_, &end);
+        if (end == p_) {
+            return false;
+        }
+        value.type = JsonValue::NUMBER;
+        p_ = end;
+        return true;
+    }
+
+    const char* p_;
+};
+
+static bool load_baseline(const std::string& path, std::string& machine_class, std::vector<BenchResult>& results) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        text.append(buffer, n);
+    }
+    fclose(f);
+
+    JsonValue root;
+    if (!JsonParser(text).parse(root) || root.type != JsonValue::OBJECT) {
+        return false;
+    }
+    const JsonValue* machine = root.get("machine");
+    machine_class = machine ? machine->text : "";
+    const JsonValue* list = root.get("results");
+    if (!list) {
+        return false;
+    }
+
+    for (const JsonValue& item : list->items) {
+        BenchResult r;
+        auto text_of = [&](const char* key) { const JsonValue* v = item.get(key); return v ? v->text : std::string(); };
+        auto int_of = [&](const char* key) { const JsonValue* v = item.get(key); return v ? (int)v->number : 0; };
+        r.bench = text_of("bench");
+        r.kernel = text_of("kernel");
+        r.isa = text_of("isa");
+        if (item.get("pages")) {
+            r.pages = text_of("pages");  // baselines recorded before page modes existed used regular pages
+        }
+        r.dataset = text_of("dataset");
+        r.unit = text_of("unit");
+        r.width = int_of("width");
+        r.height = int_of("height");
+        r.threads = int_of("threads");
+        if (const JsonValue* metrics = item.get("metrics")) {
+            for (const auto& metric : metrics->members) {
+                r.metrics.push_back({metric.first, metric.second.number});
+            }
+        }
+        if (const JsonValue* samples = item.get("samples")) {
+            for (const JsonValue& sample : samples->items) {
+                r.samples.push_back(sample.number);
+            }
+        }
+        results.push_back(r);
+    }
+    return true;
+}
+
+static const double* find_metric(const BenchResult& result, const char* name) {
+    for (const auto& metric : result.metrics) {
+        if (metric.first == name) {
+            return &metric.second;
+        }
+    }
+    return nullptr;
+}
+
+static bool same_configuration(const BenchResult& a, const BenchResult& b) {
+    return a.bench == b.bench && a.kernel == b.kernel && a.isa == b.isa && a.pages == b.pages && a.dataset == b.dataset &&
+           a.width == b.width && a.height == b.height && a.threads == b.threads && a.unit == b.unit;
+}
+
+// Two sided 95% Student t quantiles for 1..30 degrees of freedom
+static double t_quantile_95(int degrees) {
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degrees < 1) {
+        return 1e9;
+    }
+    return degrees <= 30 ? table[degrees - 1] : 1.96;
+}
+
+struct Interval {
+    double mean;
+    double low;
+    double high;
+};
+
+static Interval confidence_interval(const std::vector<double>& samples) {
+    Summary s = summarize(samples);
+    double half = t_quantile_95((int)samples.size() - 1) * s.stddev / std::sqrt((double)samples.size());
+    return {s.mean, s.mean - half, s.mean + half};
+}
+
+// All units are times, so higher means slower. A configuration regresses when it is slower
+// than the threshold and the two 95% confidence intervals do not overlap.
+static int compare_with_baseline(const BenchOptions& options, const std::vector<BenchResult>& results) {
+    std::string baseline_machine;
+    std::vector<BenchResult> baseline;
+    if (!load_baseline(options.baseline_path, baseline_machine, baseline)) {
+        fprintf(stderr, "ERROR: cannot read baseline %s\n", options.baseline_path.c_str());
+        return 1;
+    }
+
+    printf("\nBaseline: %s (machine %s)\n", options.baseline_path.c_str(), baseline_machine.c_str());
+    if (baseline_machine != options.machine_class) {
+        // Timings from another CPU or thread count say nothing about this build
+        printf("SKIPPED: this machine is %s, the baseline was recorded on %s; record one for this machine class\n",
+               options.machine_class.c_str(), baseline_machine.c_str());
+        return 0;
+    }
+    printf("%-22s %-11s %11s %7s %12s %12s %8s  %s\n", "kernel", "dataset", "size", "threads", "baseline", "current", "change", "status");
+
+    int regressions = 0;
+    int compared = 0;
+    for (const BenchResult& current : results) {
+        const BenchResult* base = nullptr;
+        for (const BenchResult& b : baseline) {
+            if (same_configuration(b, current)) {
+                base = &b;
+                break;
+            }
+        }
+        if (!base || base->samples.size() < 2 || current.samples.size() < 2) {
+            continue;
+        }
+
+        Interval before = confidence_interval(base->samples);
+        Interval after = confidence_interval(current.samples);
+        double change = 100.0 * (after.mean / before.mean - 1.0);
+        const char* status = "ok";
+        if (change > options.threshold && after.low > before.high) {
+            status = "REGRESSION";
+            regressions++;
+        } else if (change < -options.threshold && after.high < before.low) {
+            status = "faster";
+        }
+        compared++;
+
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", current.width, current.height);
+        printf("%-22s %-11s %11s %7d %12.4g %12.4g %+7.1f%%  %s\n", current.kernel.c_str(), current.dataset.c_str(), size,
+               current.threads, before.mean, after.mean, change, status);
+        if (strcmp(status, "REGRESSION") == 0) {
+            printf("    %s: baseline 95%% CI [%.4g, %.4g], current [%.4g, %.4g] %s\n", current.isa.c_str(),
+                   before.low, before.high, after.low, after.high, current.unit.c_str());
+        }
+
+        // Allocation peaks are deterministic, so any growth counts
+        const double* base_peak = find_metric(*base, "peak_alloc_bytes");
+        const double* peak = find_metric(current, "peak_alloc_bytes");
+        if (base_peak && peak && *peak > *base_peak) {
+            printf("    MEMORY REGRESSION: peak allocation %.0f bytes, baseline %.0f bytes\n", *peak, *base_peak);
+            regressions++;
+        }
+    }
+
+    printf("\nCompared %d configurations, %d regressions (threshold %.1f%%)\n", compared, regressions, options.threshold);
+    if (compared == 0) {
+        printf("WARNING: nothing in this run matches the baseline\n");
+    }
+    return regressions ? 3 : 0;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s kernels [--reps N] [--warmup N] [--filter text] [--counters] [--csv file] [--json file]\n", program);
+    printf("       %s images  [--reps N] [--warmup N] [--filter text] [--min-size N] [--max-size N]\n", program);
+    printf("                  [--max-threads N] [--dataset kind] [--seed N] [--pages list] [--csv file] [--json file]\n");
+    printf("       %s prefetch [--reps N] [--warmup N] [--filter text] [--max-size N] [--max-threads N]\n", program);
+    printf("                  [--distances 0,8,16] [--dataset kind] [--seed N] [--csv file] [--json file]\n");
+    printf("       %s memory  [--reps N] [--warmup N] [--filter text] [--min-size N] [--max-size N]\n", program);
+    printf("                  [--dataset kind] [--seed N] [--csv file] [--json file]\n");
+    printf("       %s batch   [--reps N] [--warmup N] [--filter text] [--min-size N] [--max-size N]\n", program);
+    printf("                  [--max-threads N] [--dataset kind] [--seed N] [--csv file] [--json file]\n");
+    printf("Common:  [--baseline file.json] [--threshold percent] [--machine-class name]\n");
+    printf("Pages:   comma separated regular, transparent, explicit (huge pages for the image buffers)\n");
+    printf("Datasets: gradient, noise, sprite, alpha_edge, normal_map, tileable (synthetic, see tex_corpus.h)\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::string mode = argv[1];
+    BenchOptions options;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            options.reps = std::max(2, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-size") == 0 && i + 1 < argc) {
+            options.min_size = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            options.max_size = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+            options.max_threads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--dataset") == 0 && i + 1 < argc) {
+            options.dataset = corpus_kind_from_name(argv[++i]);
+            if (options.dataset == CORPUS_KIND_COUNT) {
+                fprintf(stderr, "Unknown dataset: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            options.csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            options.json_path = argv[++i];
+        } else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+            options.page_modes.clear();
+            std::string list = argv[++i];
+            size_t start = 0;
+            while (start <= list.size()) {
+                size_t comma = list.find(',', start);
+                std::string name = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+                int mode = -1;
+                for (int m = 0; m < 3; m++) {
+                    if (name == PAGE_MODE_NAMES[m]) {
+                        mode = m;
+                    }
+                }
+                if (mode < 0) {
+                    fprintf(stderr, "Unknown page mode: %s\n", name.c_str());
+                    return 1;
+                }
+                options.page_modes.push_back(mode);
+                if (comma == std::string::npos) {
+                    break;
+                }
+                start = comma + 1;
+            }
+            std::sort(options.page_modes.begin(), options.page_modes.end());  // regular first, the others compare to it
+            options.counters = true;
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            options.baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            options.threshold = std::max(0.0, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--machine-class") == 0 && i + 1 < argc) {
+            options.machine_class = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.machine_class.empty()) {
+        options.machine_class = detect_machine_class();
+    }
+
+    std::vector<BenchResult> results;
+    int status;
+    if (mode == "kernels") {
+        status = run_kernels(options, results);
+    } else if (mode == "images") {
+        if (options.reps == BenchOptions().reps) {
+            options.reps = 5;  // whole images are slow, fewer repetitions by default
+        }
+        status = run_images(options, results);
+    } else if (mode == "prefetch") {
+        if (options.reps == BenchOptions().reps) {
+            options.reps = 5;
+        }
+        if (options.max_size == BenchOptions().max_size) {
+            options.max_size = 8192;
+        }
+        status = run_prefetch(options, results);
+    } else if (mode == "batch") {
+        if (options.reps == BenchOptions().reps) {
+            options.reps = 5;
+        }
+        if (options.min_size == BenchOptions().min_size) {
+            options.min_size = 16;
+        }
+        if (options.max_size == BenchOptions().max_size) {
+            options.max_size = 256;
+        }
+        status = run_batch(options, results);
+    } else if (mode == "memory") {
+        if (options.reps == BenchOptions().reps) {
+            options.reps = 5;
+        }
+        if (options.max_size == BenchOptions().max_size) {
+            options.max_size = 4096;
+        }
+        status = run_memory(options, results);
+    } else {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!options.csv_path.empty() && !write_csv(options.csv_path, results)) {
+        fprintf(stderr, "ERROR: cannot write %s\n", options.csv_path.c_str());
+        status = 1;
+    }
+    if (!options.json_path.empty() && !write_json(options.json_path, options.machine_class, results)) {
+        fprintf(stderr, "ERROR: cannot write %s\n", options.json_path.c_str());
+        status = 1;
+    }
+    if (status == 0 && !options.baseline_path.empty()) {
+        status = compare_with_baseline(options, results);
+    }
+    return status;
+}
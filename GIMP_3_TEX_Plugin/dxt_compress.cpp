@@ -1,142 +1,366 @@
 /*
 Fast DXT5 compression library for GIMP TEX plugin
-Compile with: g++ -shared -O3 -march=native -fopenmp -o dxt_compress.dll dxt_compress.cpp
+Compile with: g++ -shared -O3 -march=native -fopenmp -o dxt_compress.dll dxt_compress.cpp tex_file.cpp tex_mip.cpp tex_thumbnail_cache.cpp tex_trace.cpp tex_alloc.cpp tex_size_estimate.cpp
+Add -DTEX_TRACE to record a Chrome trace timeline (see tex_trace.h)
 */
 
 #include <cstdint>
 #include <algorithm>
 #include <cstring>
+#include <chrono>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <mutex>
+
+#include "dxt_compress.h"
+#include "tex_trace.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
-extern "C" {
+// Blocks per scheduling unit of the whole image drivers; each band is one trace event
+static const int BAND_BLOCKS = 64;
 
-// Convert RGB888 to RGB565
-inline uint16_t rgb_to_565(uint8_t r, uint8_t g, uint8_t b) {
-    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+// How many blocks ahead the drivers prefetch the 4 pixel rows a block reads or writes, 0 for
+// none. Rows are width * 4 bytes apart, so on wide images every block row touches 4 separate
+// streams, which hardware prefetchers do not always keep up with. Each call reads the distance
+// once and hands it to the drivers through DriverOptions; tex_autotune_prefetch replaces the
+// default with the fastest distance on the running machine.
+static const int DEFAULT_PREFETCH_BLOCKS = 8;
+static const int MAX_PREFETCH_BLOCKS = 256;
+static std::atomic<int> g_prefetch_blocks{DEFAULT_PREFETCH_BLOCKS};
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TEX_PREFETCH_READ(p) __builtin_prefetch((p), 0, 3)
+#define TEX_PREFETCH_WRITE(p) __builtin_prefetch((p), 1, 3)
+#else
+#define TEX_PREFETCH_READ(p) ((void)(p))
+#define TEX_PREFETCH_WRITE(p) ((void)(p))
+#endif
+
+// Touches the cache lines of the 4 pixel rows under block (bx, by) of an RGBA image. A block row
+// is 16 bytes, so it spans at most two lines.
+template <bool WRITE>
+static inline void prefetch_block_rows(const uint8_t* rgba, int bx, int by, int width, int height) {
+    const uint8_t* first = rgba + ((size_t)by * 4 * width + (size_t)bx * 4) * 4;
+    int rows = std::min(4, height - by * 4);
+    for (int row = 0; row < rows; row++) {
+        const uint8_t* p = first + (size_t)row * width * 4;
+        if (WRITE) {
+            TEX_PREFETCH_WRITE(p);
+            TEX_PREFETCH_WRITE(p + 15);
+        } else {
+            TEX_PREFETCH_READ(p);
+            TEX_PREFETCH_READ(p + 15);
+        }
+    }
 }
 
-// Compress a single 4x4 block to DXT5
-void compress_dxt5_block(const uint8_t* rgba, int x, int y, int width, int height, uint8_t* output) {
-    uint8_t block_rgba[16][4];
-    uint8_t alphas[16];
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Path a finished block took, judged from its encoded form: both color endpoints equal and,
+// for formats with an alpha block, both alpha endpoints equal
+static inline bool block_is_uniform(const uint8_t* block, const TexCodecDescriptor& codec) {
+    const uint8_t* color = block + codec.color_offset;
+    bool same_alpha = !codec.alpha_block || block[0] == block[1];
+    return same_alpha && color[0] == color[2] && color[1] == color[3];
+}
+
+// Shared whole image driver: runs block_fn(index, bx, by, clipped) over every block in parallel
+// bands; clipped is set for partial blocks on the right and bottom border, so interior blocks
+// can run a kernel without bounds checks. encoded is the block side of the conversion (output
+// when encoding, input when decoding) and is only read to sort blocks into the TexStats path
+// counters when stats is given. pixels is the uncompressed side; the rows of the block prefetch
+// blocks ahead are prefetched for reading (WRITE_PIXELS false, encoding) or writing.
+template <bool WRITE_PIXELS, typename BlockFn>
+static void for_each_block(int width, int height, const uint8_t* pixels, const uint8_t* encoded, const TexCodecDescriptor& codec,
+                           int prefetch, const char* band_name, TexStats* stats, BlockFn block_fn) {
+    auto start = std::chrono::steady_clock::now();
+    int block_width = (width + 3) / 4;
+    int block_height = (height + 3) / 4;
+    int total_blocks = block_width * block_height;
+    int bands = (total_blocks + BAND_BLOCKS - 1) / BAND_BLOCKS;
+    long long uniform = 0;
+    long long edge = 0;
+    int threads = 1;
     
-    // Extract 4x4 block
-    for (int py = 0; py < 4; py++) {
-        for (int px = 0; px < 4; px++) {
-            int idx = py * 4 + px;
-            int img_x = x + px;
-            int img_y = y + py;
-            
-            if (img_x < width && img_y < height) {
-                int pixel_idx = (img_y * width + img_x) * 4;
-                block_rgba[idx][0] = rgba[pixel_idx];
-                block_rgba[idx][1] = rgba[pixel_idx + 1];
-                block_rgba[idx][2] = rgba[pixel_idx + 2];
-                block_rgba[idx][3] = rgba[pixel_idx + 3];
-                alphas[idx] = rgba[pixel_idx + 3];
-            } else {
-                block_rgba[idx][0] = 0;
-                block_rgba[idx][1] = 0;
-                block_rgba[idx][2] = 0;
-                block_rgba[idx][3] = 0;
-                alphas[idx] = 0;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:uniform, edge) reduction(max:threads)
+    #endif
+    for (int band = 0; band < bands; band++) {
+        TEX_TRACE_SCOPE("codec", band_name);
+        int end = std::min(total_blocks, (band + 1) * BAND_BLOCKS);
+        for (int i = band * BAND_BLOCKS; i < end; i++) {
+            int by = i / block_width;
+            int bx = i % block_width;
+            if (prefetch && i + prefetch < total_blocks) {
+                int ahead = i + prefetch;
+                prefetch_block_rows<WRITE_PIXELS>(pixels, ahead % block_width, ahead / block_width, width, height);
+            }
+            bool clipped = bx * 4 + 4 > width || by * 4 + 4 > height;
+            block_fn(i, bx, by, clipped);
+            if (stats) {
+                if (clipped) {
+                    edge++;
+                } else if (block_is_uniform(encoded + (size_t)i * codec.block_bytes, codec)) {
+                    uniform++;
+                }
             }
         }
+        #ifdef _OPENMP
+        threads = std::max(threads, omp_get_num_threads());
+        #endif
     }
     
-    // Compress alpha
-    uint8_t alpha0 = alphas[0];
-    uint8_t alpha1 = alphas[0];
-    for (int i = 1; i < 16; i++) {
-        alpha0 = std::min(alpha0, alphas[i]);
-        alpha1 = std::max(alpha1, alphas[i]);
+    if (stats) {
+        stats->blocks_ms = ms_since(start);
+        stats->blocks_uniform = uniform;
+        stats->blocks_edge = edge;
+        stats->blocks_fast = total_blocks - uniform - edge;
+        stats->threads = threads;
     }
+}
+
+// Block rows per band of the seeded driver
+static const int SEEDED_BAND_ROWS = 4;
+
+// Driver for encoders that start from the final endpoints of a block's left and top
+// neighbours. Bands of SEEDED_BAND_ROWS block rows are encoded row by row on one thread, the
+// even bands first and then the odd ones, so the band above a band's first row is always
+// finished and the output does not depend on the thread count. block_fn(index, bx, by, clipped,
+// left, top) gets the neighbours' encoded blocks (NULL when there is none, and for the top of an
+// even band) and returns the refinement steps it took. Full blocks that are not uniform count
+// as refined. Prefetching stops at the end of each band.
+template <typename BlockFn>
+static void for_each_block_seeded(int width, int height, const uint8_t* pixels, uint8_t* encoded, const TexCodecDescriptor& codec,
+                                  int prefetch, TexStats* stats, BlockFn block_fn) {
+    auto start = std::chrono::steady_clock::now();
+    int block_width = (width + 3) / 4;
+    int block_height = (height + 3) / 4;
+    int bands = (block_height + SEEDED_BAND_ROWS - 1) / SEEDED_BAND_ROWS;
+    long long uniform = 0;
+    long long edge = 0;
+    long long steps = 0;
+    int threads = 1;
     
-    output[0] = alpha0;
-    output[1] = alpha1;
+    for (int phase = 0; phase < 2; phase++) {
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:uniform, edge, steps) reduction(max:threads)
+        #endif
+        for (int band = phase; band < bands; band += 2) {
+            TEX_TRACE_SCOPE("codec", "encode_seeded_band");
+            int first_row = band * SEEDED_BAND_ROWS;
+            int end_row = std::min(block_height, first_row + SEEDED_BAND_ROWS);
+            int band_end = end_row * block_width;
+            for (int by = first_row; by < end_row; by++) {
+                bool has_top = by > first_row || (by > 0 && phase == 1);
+                for (int bx = 0; bx < block_width; bx++) {
+                    int i = by * block_width + bx;
+                    if (prefetch && i + prefetch < band_end) {
+                        int ahead = i + prefetch;
+                        prefetch_block_rows<false>(pixels, ahead % block_width, ahead / block_width, width, height);
+                    }
+                    uint8_t* block = encoded + (size_t)i * codec.block_bytes;
+                    const uint8_t* left = bx > 0 ? block - codec.block_bytes : nullptr;
+                    const uint8_t* top = has_top ? block - (size_t)block_width * codec.block_bytes : nullptr;
+                    bool clipped = bx * 4 + 4 > width || by * 4 + 4 > height;
+                    steps += block_fn(i, bx, by, clipped, left, top);
+                    if (stats) {
+                        if (clipped) {
+                            edge++;
+                        } else if (block_is_uniform(block, codec)) {
+                            uniform++;
+                        }
+                    }
+                }
+            }
+            #ifdef _OPENMP
+            threads = std::max(threads, omp_get_num_threads());
+            #endif
+        }
+    }
     
-    // Calculate alpha palette
-    uint8_t alpha_palette[8];
-    alpha_palette[0] = alpha0;
-    alpha_palette[1] = alpha1;
-    if (alpha0 > alpha1) {
+    if (stats) {
+        stats->blocks_ms = ms_since(start);
+        stats->blocks_uniform = uniform;
+        stats->blocks_edge = edge;
+        stats->blocks_refined = (long long)block_width * block_height - uniform - edge;
+        stats->refine_steps = steps;
+        stats->threads = threads;
+    }
+}
+
+// ============================================================================
+// Block kernels
+// ============================================================================
+
+// Channel order of the uncompressed side of a conversion
+enum class PixelLayout { RGBA, BGRA };
+
+template <PixelLayout LAYOUT>
+struct ChannelOrder {
+    static constexpr int RED = LAYOUT == PixelLayout::RGBA ? 0 : 2;
+    static constexpr int GREEN = 1;
+    static constexpr int BLUE = LAYOUT == PixelLayout::RGBA ? 2 : 0;
+};
+
+// Instruction set tags. The kernel structs below are the portable code every ISA starts from;
+// an ISA specific build specializes a kernel struct for its tag and adds a DXT_KERNEL_VARIANTS
+// entry, and the generic drivers pick it up unchanged.
+struct IsaScalar {
+    static constexpr const char* NAME = "scalar";
+    static bool supported() { return true; }
+};
+
+// Convert RGB888 to RGB565
+static inline uint16_t rgb_to_565(uint8_t r, uint8_t g, uint8_t b) {
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+// ============================================================================
+// Palette arithmetic
+// ============================================================================
+
+// Exact n / D by multiply and shift for every n up to LIMIT, the largest weighted sum a palette
+// entry can produce; the static_asserts below check each value
+template <uint32_t D> struct Reciprocal;
+template <> struct Reciprocal<3> { static constexpr uint32_t MUL = 683, SHIFT = 11, LIMIT = 3 * 255; };
+template <> struct Reciprocal<5> { static constexpr uint32_t MUL = 3277, SHIFT = 14, LIMIT = 5 * 255; };
+template <> struct Reciprocal<7> { static constexpr uint32_t MUL = 2341, SHIFT = 14, LIMIT = 7 * 255; };
+
+template <uint32_t D>
+static constexpr uint32_t divide(uint32_t n) {
+    return (n * Reciprocal<D>::MUL) >> Reciprocal<D>::SHIFT;
+}
+
+template <uint32_t D>
+static constexpr bool reciprocal_is_exact() {
+    for (uint32_t n = 0; n <= Reciprocal<D>::LIMIT; n++) {
+        if (divide<D>(n) != n / D) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(reciprocal_is_exact<3>() && reciprocal_is_exact<5>() && reciprocal_is_exact<7>(), "palette reciprocal not exact");
+
+// 565 fields to 8 bits the way this codec has always expanded them: shifted up, without bit
+// replication. The replicate tables expand them the way GPUs and standard BC1/BC3 decoders
+// do; the refined encoder scores its candidates against those. The alpha tables hold the
+// weights of alpha0 and alpha1 for the interpolated entries 2..7 of the 8 value mode and 2..5
+// of the 6 value mode.
+struct DxtPaletteTables {
+    uint8_t expand5[32];
+    uint8_t expand6[64];
+    uint8_t replicate5[32];
+    uint8_t replicate6[64];
+    uint8_t alpha8_weights[6][2];
+    uint8_t alpha6_weights[4][2];
+    constexpr DxtPaletteTables() : expand5(), expand6(), replicate5(), replicate6(), alpha8_weights(), alpha6_weights() {
+        for (int v = 0; v < 32; v++) {
+            expand5[v] = (uint8_t)(v << 3);
+            replicate5[v] = (uint8_t)((v << 3) | (v >> 2));
+        }
+        for (int v = 0; v < 64; v++) {
+            expand6[v] = (uint8_t)(v << 2);
+            replicate6[v] = (uint8_t)((v << 2) | (v >> 4));
+        }
         for (int i = 1; i < 7; i++) {
-            alpha_palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+            alpha8_weights[i - 1][0] = (uint8_t)(7 - i);
+            alpha8_weights[i - 1][1] = (uint8_t)i;
         }
-    } else {
         for (int i = 1; i < 5; i++) {
-            alpha_palette[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+            alpha6_weights[i - 1][0] = (uint8_t)(5 - i);
+            alpha6_weights[i - 1][1] = (uint8_t)i;
         }
-        alpha_palette[6] = 0;
-        alpha_palette[7] = 255;
     }
-    
-    // Encode alpha indices
-    uint64_t alpha_bits = 0;
-    for (int i = 0; i < 16; i++) {
-        uint8_t alpha = alphas[i];
-        int best_idx = 0;
-        int best_diff = abs(alpha - alpha_palette[0]);
-        for (int j = 1; j < 8; j++) {
-            int diff = abs(alpha - alpha_palette[j]);
-            if (diff < best_diff) {
-                best_diff = diff;
-                best_idx = j;
-            }
+};
+static constexpr DxtPaletteTables DXT_PALETTE;
+
+template <bool REPLICATE>
+static inline void unpack_565(uint16_t color, uint8_t rgb[3]) {
+    const uint8_t* expand5 = REPLICATE ? DXT_PALETTE.replicate5 : DXT_PALETTE.expand5;
+    const uint8_t* expand6 = REPLICATE ? DXT_PALETTE.replicate6 : DXT_PALETTE.expand6;
+    rgb[0] = expand5[color >> 11];
+    rgb[1] = expand6[(color >> 5) & 0x3F];
+    rgb[2] = expand5[color & 0x1F];
+}
+
+// Color palette of a block. FOUR_COLOR is the interpolated 4 entry mode (DXT5 always, DXT1 when
+// color0 > color1); otherwise entry 2 is the midpoint and entry 3 transparent black. STRIDE is
+// 3 for RGB palettes and 4 for RGBA ones, whose alpha is filled as well. REPLICATE expands the
+// endpoints with bit replication instead of the codec's own shift.
+template <int STRIDE, bool REPLICATE = false>
+static inline void build_color_palette(uint16_t color0, uint16_t color1, bool four_color, uint8_t (*palette)[STRIDE]) {
+    unpack_565<REPLICATE>(color0, palette[0]);
+    unpack_565<REPLICATE>(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        uint32_t c0 = palette[0][c];
+        uint32_t c1 = palette[1][c];
+        if (four_color) {
+            palette[2][c] = (uint8_t)divide<3>(c0 * 2 + c1);
+            palette[3][c] = (uint8_t)divide<3>(c0 + c1 * 2);
+        } else {
+            palette[2][c] = (uint8_t)((c0 + c1) >> 1);
+            palette[3][c] = 0;
         }
-        alpha_bits |= ((uint64_t)best_idx << (i * 3));
     }
-    
-    for (int i = 0; i < 6; i++) {
-        output[2 + i] = (alpha_bits >> (i * 8)) & 0xFF;
+    if (STRIDE == 4) {
+        palette[0][STRIDE - 1] = 255;
+        palette[1][STRIDE - 1] = 255;
+        palette[2][STRIDE - 1] = 255;
+        palette[3][STRIDE - 1] = four_color ? 255 : 0;  // Transparent
     }
-    
-    // Compress color - find min/max by luminance
-    int min_lum = 999999;
-    int max_lum = 0;
-    uint8_t color0_rgb[3] = {0, 0, 0};
-    uint8_t color1_rgb[3] = {0, 0, 0};
-    
-    for (int i = 0; i < 16; i++) {
-        int lum = block_rgba[i][0] * 2 + block_rgba[i][1] * 4 + block_rgba[i][2];
-        if (lum < min_lum) {
-            min_lum = lum;
-            color0_rgb[0] = block_rgba[i][0];
-            color0_rgb[1] = block_rgba[i][1];
-            color0_rgb[2] = block_rgba[i][2];
+}
+
+// DXT5 alpha palette: 8 interpolated values when alpha0 > alpha1, else 6 plus 0 and 255
+static inline void build_alpha_palette(uint8_t alpha0, uint8_t alpha1, uint8_t palette[8]) {
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    if (alpha0 > alpha1) {
+        for (int i = 0; i < 6; i++) {
+            palette[i + 2] = (uint8_t)divide<7>(DXT_PALETTE.alpha8_weights[i][0] * alpha0 + DXT_PALETTE.alpha8_weights[i][1] * alpha1);
         }
-        if (lum > max_lum) {
-            max_lum = lum;
-            color1_rgb[0] = block_rgba[i][0];
-            color1_rgb[1] = block_rgba[i][1];
-            color1_rgb[2] = block_rgba[i][2];
+    } else {
+        for (int i = 0; i < 4; i++) {
+            palette[i + 2] = (uint8_t)divide<5>(DXT_PALETTE.alpha6_weights[i][0] * alpha0 + DXT_PALETTE.alpha6_weights[i][1] * alpha1);
         }
+        palette[6] = 0;
+        palette[7] = 255;
     }
-    
-    uint16_t color0 = rgb_to_565(color0_rgb[0], color0_rgb[1], color0_rgb[2]);
-    uint16_t color1 = rgb_to_565(color1_rgb[0], color1_rgb[1], color1_rgb[2]);
-    
-    // Reconstruct colors from 565
-    uint8_t r0 = ((color0 >> 11) & 0x1F) << 3;
-    uint8_t g0 = ((color0 >> 5) & 0x3F) << 2;
-    uint8_t b0 = (color0 & 0x1F) << 3;
-    uint8_t r1 = ((color1 >> 11) & 0x1F) << 3;
-    uint8_t g1 = ((color1 >> 5) & 0x3F) << 2;
-    uint8_t b1 = (color1 & 0x1F) << 3;
-    
-    // Color palette
-    uint8_t color_palette[4][3] = {
-        {r0, g0, b0},
-        {r1, g1, b1},
-        {(uint8_t)((r0 * 2 + r1) / 3), (uint8_t)((g0 * 2 + g1) / 3), (uint8_t)((b0 * 2 + b1) / 3)},
-        {(uint8_t)((r0 + r1 * 2) / 3), (uint8_t)((g0 + g1 * 2) / 3), (uint8_t)((b0 + b1 * 2) / 3)}
-    };
-    
-    // Encode color indices
+}
+
+// Most least squares steps per block; smooth blocks settle in one or two, noise in about four
+static const int REFINE_MAX_STEPS = 8;
+
+// Squared RGB error over a block below which a neighbour's endpoints are good enough to start
+// from (an RMS of 4 per pixel)
+static const int SEED_ACCEPT_ERROR = 16 * 16;
+
+// Error of a block's own start above which seeds are not tried at all (an RMS of 16): busy
+// blocks practically never accept one, and checking them cost noise 10-20% more time
+static const int SEED_TRY_ERROR = 16 * SEED_ACCEPT_ERROR;
+
+// Nearest 4 color palette entry for every pixel of a staged block, as DXT index bits; the
+// summed squared RGB error goes to *error. Gives up once a pixel row takes the error to limit
+// or beyond, for candidates that can no longer win; the bits are meaningless then. REPLICATE
+// measures against the bit replicated palette GPUs decode.
+template <bool REPLICATE = false>
+static inline uint32_t fit_color_indices(const uint8_t (*block_rgba)[4], uint16_t color0, uint16_t color1, int* error,
+                                         int limit = INT_MAX) {
+    uint8_t color_palette[4][3];
+    build_color_palette<3, REPLICATE>(color0, color1, true, color_palette);
+
     uint32_t color_bits = 0;
+    int total = 0;
     for (int i = 0; i < 16; i++) {
         int best_idx = 0;
         int best_diff = 999999;
@@ -151,207 +375,1182 @@ void compress_dxt5_block(const uint8_t* rgba, int x, int y, int width, int heigh
             }
         }
         color_bits |= (best_idx << (i * 2));
+        total += best_diff;
+        if ((i & 3) == 3 && total >= limit) {
+            break;
+        }
     }
-    
-    output[8] = color0 & 0xFF;
-    output[9] = (color0 >> 8) & 0xFF;
-    output[10] = color1 & 0xFF;
-    output[11] = (color1 >> 8) & 0xFF;
-    output[12] = color_bits & 0xFF;
-    output[13] = (color_bits >> 8) & 0xFF;
-    output[14] = (color_bits >> 16) & 0xFF;
-    output[15] = (color_bits >> 24) & 0xFF;
+    *error = total;
+    return color_bits;
 }
 
-// Main compression function with multi-threading
-__declspec(dllexport) void compress_dxt5(const uint8_t* rgba, int width, int height, uint8_t* output) {
-    int block_width = (width + 3) / 4;
-    int block_height = (height + 3) / 4;
-    int total_blocks = block_width * block_height;
-    
-    #ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic, 64)
-    #endif
-    for (int i = 0; i < total_blocks; i++) {
-        int by = i / block_width;
-        int bx = i % block_width;
-        int block_idx = i * 16;
-        compress_dxt5_block(rgba, bx * 4, by * 4, width, height, output + block_idx);
+// Rounds a least squares endpoint to the 565 value whose bit replicated expansion is nearest
+static inline uint16_t quantize_565(const double rgb[3]) {
+    int r = std::min(31, std::max(0, (int)(rgb[0] * 31 / 255 + 0.5)));
+    int g = std::min(63, std::max(0, (int)(rgb[1] * 63 / 255 + 0.5)));
+    int b = std::min(31, std::max(0, (int)(rgb[2] * 31 / 255 + 0.5)));
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// Alternately solves for the endpoints that minimize the squared error of the current indices
+// and picks new indices, for as long as the quantized result improves. Starts from the
+// endpoints, bits and error passed in and updates them; errors are against the bit replicated
+// palette. Each solve is one step; returns the step count.
+static int refine_endpoints(const uint8_t (*block_rgba)[4], uint16_t* color0, uint16_t* color1, uint32_t* color_bits, int best_error) {
+    // Weight of color0 in thirds for palette entries 0..3; color1 gets 3 minus it
+    static const int WEIGHT0[4] = {3, 0, 2, 1};
+
+    int steps = 0;
+    while (best_error > 0 && steps < REFINE_MAX_STEPS) {
+        steps++;
+        // Normal equations of the two endpoints, everything in thirds
+        int aa = 0, bb = 0, ab = 0;
+        int ax[3] = {0, 0, 0};
+        int bx[3] = {0, 0, 0};
+        for (int i = 0; i < 16; i++) {
+            int a = WEIGHT0[(*color_bits >> (i * 2)) & 3];
+            int b = 3 - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (int c = 0; c < 3; c++) {
+                ax[c] += a * block_rgba[i][c];
+                bx[c] += b * block_rgba[i][c];
+            }
+        }
+        int det = aa * bb - ab * ab;
+        double end0[3], end1[3];
+        for (int c = 0; c < 3; c++) {
+            if (det == 0) {
+                // Every pixel on one index: the best fit is a single color, the block's mean
+                end0[c] = end1[c] = (ax[c] + bx[c]) / 48.0;
+            } else {
+                end0[c] = 3.0 * (bb * ax[c] - ab * bx[c]) / det;
+                end1[c] = 3.0 * (aa * bx[c] - ab * ax[c]) / det;
+            }
+        }
+        uint16_t next0 = quantize_565(end0);
+        uint16_t next1 = quantize_565(end1);
+        if (next0 == *color0 && next1 == *color1) {
+            break;
+        }
+        int error;
+        uint32_t bits = fit_color_indices<true>(block_rgba, next0, next1, &error, best_error);
+        if (error >= best_error) {
+            break;
+        }
+        best_error = error;
+        *color0 = next0;
+        *color1 = next1;
+        *color_bits = bits;
     }
+    return steps;
 }
 
-// Fast DXT1 decompression
-void decompress_dxt1_block(const uint8_t* input, int x, int y, int width, int height, uint8_t* rgba) {
-    // Read color values
-    uint16_t color0 = input[0] | (input[1] << 8);
-    uint16_t color1 = input[2] | (input[3] << 8);
-    uint32_t color_bits = input[4] | (input[5] << 8) | (input[6] << 16) | (input[7] << 24);
-    
-    // Convert 565 to RGB888
-    uint8_t r0 = ((color0 >> 11) & 0x1F) << 3;
-    uint8_t g0 = ((color0 >> 5) & 0x3F) << 2;
-    uint8_t b0 = (color0 & 0x1F) << 3;
-    uint8_t r1 = ((color1 >> 11) & 0x1F) << 3;
-    uint8_t g1 = ((color1 >> 5) & 0x3F) << 2;
-    uint8_t b1 = (color1 & 0x1F) << 3;
-    
-    // Build color palette
-    uint8_t color_palette[4][4];  // RGBA
-    color_palette[0][0] = r0; color_palette[0][1] = g0; color_palette[0][2] = b0; color_palette[0][3] = 255;
-    color_palette[1][0] = r1; color_palette[1][1] = g1; color_palette[1][2] = b1; color_palette[1][3] = 255;
-    
-    if (color0 > color1) {
-        color_palette[2][0] = (r0 * 2 + r1) / 3;
-        color_palette[2][1] = (g0 * 2 + g1) / 3;
-        color_palette[2][2] = (b0 * 2 + b1) / 3;
-        color_palette[2][3] = 255;
-        color_palette[3][0] = (r0 + r1 * 2) / 3;
-        color_palette[3][1] = (g0 + g1 * 2) / 3;
-        color_palette[3][2] = (b0 + b1 * 2) / 3;
-        color_palette[3][3] = 255;
-    } else {
-        color_palette[2][0] = (r0 + r1) / 2;
-        color_palette[2][1] = (g0 + g1) / 2;
-        color_palette[2][2] = (b0 + b1) / 2;
-        color_palette[2][3] = 255;
-        color_palette[3][0] = 0;
-        color_palette[3][1] = 0;
-        color_palette[3][2] = 0;
-        color_palette[3][3] = 0;  // Transparent
+// ============================================================================
+// Blocks with few colors
+// ============================================================================
+
+// Distinct RGB colors of a staged block (alpha is encoded separately and ignored) with the
+// number of pixels using each, found by comparing all 16 pixels against one color at a time.
+// Stops once a fifth color turns up; returns the count, 5 meaning more than 4. VECTOR compares
+// 4 pixels per SSE2 instruction when the build has SSE2; the scalar loop is always compiled so
+// dxt_fuzz can hold the two to the same answers (tex_block_distinct_colors).
+template <bool VECTOR>
+static inline int block_distinct_colors(const uint8_t (*block_rgba)[4], uint32_t colors[4], int counts[4]) {
+    uint32_t pixels[16];
+    memcpy(pixels, block_rgba, sizeof(pixels));
+    for (uint32_t& pixel : pixels) {
+        pixel &= 0x00FFFFFF;  // little endian: byte 3 is alpha
     }
-    
-    // Decode pixels
-    for (int py = 0; py < 4; py++) {
-        for (int px = 0; px < 4; px++) {
-            int img_x = x + px;
-            int img_y = y + py;
-            
-            if (img_x < width && img_y < height) {
+#ifdef __SSE2__
+    __m128i rows[4];
+    if (VECTOR) {
+        for (int r = 0; r < 4; r++) {
+            rows[r] = _mm_loadu_si128((const __m128i*)(pixels + r * 4));
+        }
+    }
+#endif
+    uint32_t remaining = 0xFFFF;
+    int count = 0;
+    while (remaining) {
+        if (count == 4) {
+            return 5;
+        }
+        uint32_t color = pixels[__builtin_ctz(remaining)];
+        uint32_t same = 0;
+#ifdef __SSE2__
+        if (VECTOR) {
+            __m128i key = _mm_set1_epi32((int)color);
+            for (int r = 0; r < 4; r++) {
+                same |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(rows[r], key))) << (r * 4);
+            }
+        } else
+#endif
+        {
+            for (int i = 0; i < 16; i++) {
+                same |= (uint32_t)(pixels[i] == color) << i;
+            }
+        }
+        colors[count] = color;
+        counts[count] = __builtin_popcount(same);
+        remaining &= ~same;
+        count++;
+    }
+    return count;
+}
+
+int tex_block_distinct_colors(const uint8_t* block_rgba, uint32_t colors[4], int counts[4], bool vector) {
+    const uint8_t (*block)[4] = (const uint8_t (*)[4])block_rgba;
+    return vector ? block_distinct_colors<true>(block, colors, counts) : block_distinct_colors<false>(block, colors, counts);
+}
+
+// Placements of two colors on the 4 palette positions (thirds from color0 to color1): besides
+// the endpoints themselves, pairs of interpolated entries often land closer after 565 rounding
+static const uint8_t TWO_COLOR_PLACEMENTS[6][2] = {{0, 3}, {0, 1}, {0, 2}, {1, 2}, {1, 3}, {2, 3}};
+
+// Best endpoint fields for a single 8 bit value, on palette entry 0 (the endpoint itself) and
+// on entry 2 (two thirds color0, one third color1), for 5 and 6 bit fields expanded with bit
+// replication as GPUs decode them
+struct SingleColorFit {
+    uint8_t q0, q1, error;
+};
+struct SingleColorTables {
+    SingleColorFit fit5[2][256];
+    SingleColorFit fit6[2][256];
+    constexpr SingleColorTables() : fit5(), fit6() {
+        fill(fit5, 31, DXT_PALETTE.replicate5);
+        fill(fit6, 63, DXT_PALETTE.replicate6);
+    }
+    constexpr void fill(SingleColorFit (*fit)[256], int max, const uint8_t* expand) {
+        for (int v = 0; v < 256; v++) {
+            fit[0][v] = SingleColorFit{0, 0, 255};
+            fit[1][v] = SingleColorFit{0, 0, 255};
+            for (int q0 = 0; q0 <= max; q0++) {
+                int e0 = expand[q0];
+                int d0 = e0 > v ? e0 - v : v - e0;
+                if (d0 < fit[0][v].error) {
+                    fit[0][v] = SingleColorFit{(uint8_t)q0, (uint8_t)q0, (uint8_t)d0};
+                }
+                // Entry 2 is (2 * e0 + e1) / 3 rounded down: only the q1 whose expansion is next
+                // to 3v - 2 * e0 can be best
+                int target = std::min(255, std::max(0, 3 * v - 2 * e0));
+                int base = target * max / 255;
+                for (int q1 = std::max(0, base - 1); q1 <= std::min(max, base + 1); q1++) {
+                    int entry = (2 * e0 + expand[q1]) / 3;
+                    int d = entry > v ? entry - v : v - entry;
+                    if (d < fit[1][v].error) {
+                        fit[1][v] = SingleColorFit{(uint8_t)q0, (uint8_t)q1, (uint8_t)d};
+                    }
+                }
+            }
+        }
+    }
+};
+static constexpr SingleColorTables SINGLE_COLOR;
+
+// Endpoints for a block whose pixels use only the given colors; returns the squared RGB error
+// they leave under the bit replicated palette. One color takes the better of the exact endpoint
+// and the interpolated entry tables. More colors are sorted along the line through the two
+// farthest apart and placed on the palette; each placement gets per channel least squares
+// endpoints, tried with the 565 fields on both sides. With the indices fixed the channels are
+// independent, so the best pair of every channel together is the placement's best.
+static int solve_few_colors(const uint32_t colors[4], const int counts[4], int count, uint16_t* color0, uint16_t* color1) {
+    static const int FIELD_MAX[3] = {31, 63, 31};
+    static const uint8_t* const EXPAND[3] = {DXT_PALETTE.replicate5, DXT_PALETTE.replicate6, DXT_PALETTE.replicate5};
+    static const int FIELD_POS[3] = {11, 5, 0};
+    int rgb[4][3];
+    for (int k = 0; k < count; k++) {
+        for (int c = 0; c < 3; c++) {
+            rgb[k][c] = (colors[k] >> (8 * c)) & 0xFF;
+        }
+    }
+
+    if (count == 1) {
+        int best_error = INT_MAX;
+        for (int entry = 0; entry < 2; entry++) {
+            int error = 0;
+            uint16_t end0 = 0, end1 = 0;
+            for (int c = 0; c < 3; c++) {
+                const SingleColorFit& fit = (c == 1 ? SINGLE_COLOR.fit6 : SINGLE_COLOR.fit5)[entry][rgb[0][c]];
+                error += fit.error * fit.error;
+                end0 |= (uint16_t)(fit.q0 << FIELD_POS[c]);
+                end1 |= (uint16_t)(fit.q1 << FIELD_POS[c]);
+            }
+            if (error < best_error) {
+                best_error = error;
+                *color0 = end0;
+                *color1 = end1;
+            }
+        }
+        return best_error * counts[0];
+    }
+
+    // Order the colors by their projection on the farthest apart pair
+    int from = 0, to = 1, widest = -1;
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            int d = 0;
+            for (int c = 0; c < 3; c++) {
+                d += (rgb[j][c] - rgb[i][c]) * (rgb[j][c] - rgb[i][c]);
+            }
+            if (d > widest) {
+                widest = d;
+                from = i;
+                to = j;
+            }
+        }
+    }
+    int order[4];
+    int projection[4];
+    for (int k = 0; k < count; k++) {
+        projection[k] = 0;
+        for (int c = 0; c < 3; c++) {
+            projection[k] += (rgb[k][c] - rgb[from][c]) * (rgb[to][c] - rgb[from][c]);
+        }
+        int at = k;
+        while (at > 0 && projection[order[at - 1]] > projection[k]) {
+            order[at] = order[at - 1];
+            at--;
+        }
+        order[at] = k;
+    }
+
+    // Three or four colors sit on the positions nearest their projections, the outer ones on
+    // the endpoints; two colors try every placement
+    uint8_t line_positions[4];
+    for (int k = 0; k < count; k++) {
+        int t = projection[order[k]];
+        line_positions[k] = (uint8_t)(k == 0 ? 0 : k == count - 1 ? 3 : std::min(3, std::max(0, (6 * t + widest) / (2 * widest))));
+    }
+    int placements = count == 2 ? 6 : 1;
+
+    // Weight of color0 in thirds for palette positions 0..3 (entries 0, 2, 3, 1)
+    static const int WEIGHT0[4] = {3, 2, 1, 0};
+    int best_error = INT_MAX;
+    for (int p = 0; p < placements && best_error > 0; p++) {
+        const uint8_t* positions = count == 2 ? TWO_COLOR_PLACEMENTS[p] : line_positions;
+        int aa = 0, bb = 0, ab = 0;
+        for (int k = 0; k < count; k++) {
+            int a = WEIGHT0[positions[k]];
+            int w = counts[order[k]];
+            aa += w * a * a;
+            bb += w * (3 - a) * (3 - a);
+            ab += w * a * (3 - a);
+        }
+        double det = (double)aa * bb - (double)ab * ab;
+
+        int error = 0;
+        uint16_t end0 = 0, end1 = 0;
+        for (int c = 0; c < 3 && error < best_error; c++) {
+            int ax = 0, bx = 0;
+            for (int k = 0; k < count; k++) {
+                int a = WEIGHT0[positions[k]];
+                int w = counts[order[k]];
+                ax += w * a * rgb[order[k]][c];
+                bx += w * (3 - a) * rgb[order[k]][c];
+            }
+            // Fields at or just below the least squares values; a field's expansion grows by
+            // 255 / FIELD_MAX per step, so the best one is this or the next
+            double value0 = 3.0 * (bb * ax - ab * bx) / det;
+            double value1 = 3.0 * (aa * bx - ab * ax) / det;
+            int base0 = (int)std::floor(value0 * FIELD_MAX[c] / 255);
+            int base1 = (int)std::floor(value1 * FIELD_MAX[c] / 255);
+            int channel_error = INT_MAX;
+            int field0 = 0, field1 = 0;
+            for (int q0 = base0; q0 <= base0 + 1; q0++) {
+                for (int q1 = base1; q1 <= base1 + 1; q1++) {
+                    int f0 = std::min(FIELD_MAX[c], std::max(0, q0));
+                    int f1 = std::min(FIELD_MAX[c], std::max(0, q1));
+                    int e0 = EXPAND[c][f0];
+                    int e1 = EXPAND[c][f1];
+                    int sum = 0;
+                    for (int k = 0; k < count; k++) {
+                        int a = WEIGHT0[positions[k]];
+                        int d = rgb[order[k]][c] - (int)divide<3>(a * e0 + (3 - a) * e1);
+                        sum += counts[order[k]] * d * d;
+                    }
+                    if (sum < channel_error) {
+                        channel_error = sum;
+                        field0 = f0;
+                        field1 = f1;
+                    }
+                }
+            }
+            error += channel_error;
+            end0 |= (uint16_t)(field0 << FIELD_POS[c]);
+            end1 |= (uint16_t)(field1 << FIELD_POS[c]);
+        }
+        if (error < best_error) {
+            best_error = error;
+            *color0 = end0;
+            *color1 = end1;
+        }
+    }
+    return best_error;
+}
+
+template <typename Isa>
+struct Dxt5Kernels {
+    static constexpr int FORMAT = TEX_FORMAT_DXT5;
+
+    // Compress a single 4x4 block to DXT5. PREMULTIPLY premultiplies the color by alpha while the
+    // block is staged, so callers never need a separate pass over the image. CLIPPED checks
+    // every pixel against the image bounds; interior blocks skip that.
+    template <bool PREMULTIPLY, PixelLayout LAYOUT, bool CLIPPED>
+    static void encode(const uint8_t* pixels, int x, int y, int width, int height, uint8_t* output) {
+        uint8_t block_rgba[16][4];
+        uint8_t alphas[16];
+        load_block<PREMULTIPLY, LAYOUT, CLIPPED>(pixels, x, y, width, height, block_rgba, alphas);
+        encode_alpha(alphas, output);
+
+        uint16_t color0, color1;
+        luminance_endpoints(block_rgba, &color0, &color1);
+        int error;
+        write_color(color0, color1, fit_color_indices(block_rgba, color0, color1, &error), output);
+    }
+
+    // Same block with least squares endpoint refinement. seeds are encoded blocks whose
+    // endpoints are likely close to this block's (its parent in the next smaller mip, its left
+    // and top neighbours), NULL where there is none; one that fits better than the block's own
+    // start replaces it. Returns the refinement steps taken.
+    template <bool PREMULTIPLY, PixelLayout LAYOUT, bool CLIPPED>
+    static int encode_refined(const uint8_t* pixels, int x, int y, int width, int height, const uint8_t* const* seeds, int seed_count,
+                              uint8_t* output) {
+        uint8_t block_rgba[16][4];
+        uint8_t alphas[16];
+        load_block<PREMULTIPLY, LAYOUT, CLIPPED>(pixels, x, y, width, height, block_rgba, alphas);
+        encode_alpha(alphas, output);
+
+        // Flat art, UI and indexed images: up to 4 colors are solved directly, no search needed
+        uint16_t color0 = 0, color1 = 0;
+        uint32_t color_bits = 0;
+        int error = INT_MAX;
+        uint32_t colors[4];
+        int counts[4];
+        int distinct = block_distinct_colors<true>(block_rgba, colors, counts);
+        if (distinct <= 4) {
+            solve_few_colors(colors, counts, distinct, &color0, &color1);
+            write_color(color0, color1, fit_color_indices<true>(block_rgba, color0, color1, &error), output);
+            return 0;
+        }
+
+        // Seeds do not make refinement faster, checking them costs more than the steps they
+        // spare. On smooth content they lead it to better endpoints than the luminance start
+        // reaches, so blocks whose own start already fits fairly well try them. Poor fits give
+        // up after a row or two; seeding only below SEED_ACCEPT_ERROR keeps noisy areas from
+        // inheriting flattened palettes.
+        luminance_endpoints(block_rgba, &color0, &color1);
+        color_bits = fit_color_indices<true>(block_rgba, color0, color1, &error);
+        for (int s = 0; s < seed_count && error < SEED_TRY_ERROR; s++) {
+            if (const uint8_t* seed = seeds[s]) {
+                uint16_t seed0 = (uint16_t)(seed[8] | (seed[9] << 8));
+                uint16_t seed1 = (uint16_t)(seed[10] | (seed[11] << 8));
+                int limit = std::min(error, SEED_ACCEPT_ERROR);
+                int seed_error;
+                uint32_t seed_bits = fit_color_indices<true>(block_rgba, seed0, seed1, &seed_error, limit);
+                if (seed_error < limit) {
+                    color0 = seed0;
+                    color1 = seed1;
+                    color_bits = seed_bits;
+                    error = seed_error;
+                }
+            }
+        }
+
+        int steps = refine_endpoints(block_rgba, &color0, &color1, &color_bits, error);
+        write_color(color0, color1, color_bits, output);
+        return steps;
+    }
+
+    // Stages the 4x4 block at (x, y) as RGBA, premultiplied when asked, and its alphas; pixels
+    // outside the image are transparent black
+    template <bool PREMULTIPLY, PixelLayout LAYOUT, bool CLIPPED>
+    static inline void load_block(const uint8_t* pixels, int x, int y, int width, int height, uint8_t block_rgba[16][4],
+                                  uint8_t alphas[16]) {
+        typedef ChannelOrder<LAYOUT> Order;
+        for (int py = 0; py < 4; py++) {
+            for (int px = 0; px < 4; px++) {
                 int idx = py * 4 + px;
-                int pixel_idx = (img_y * width + img_x) * 4;
+                int img_x = x + px;
+                int img_y = y + py;
                 
-                // Get color index
-                int color_idx = (color_bits >> (idx * 2)) & 3;
-                rgba[pixel_idx] = color_palette[color_idx][0];
-                rgba[pixel_idx + 1] = color_palette[color_idx][1];
-                rgba[pixel_idx + 2] = color_palette[color_idx][2];
-                rgba[pixel_idx + 3] = color_palette[color_idx][3];
+                if (!CLIPPED || (img_x < width && img_y < height)) {
+                    int pixel_idx = (img_y * width + img_x) * 4;
+                    uint8_t alpha = pixels[pixel_idx + 3];
+                    if (PREMULTIPLY) {
+                        block_rgba[idx][0] = tex_premultiply_channel(pixels[pixel_idx + Order::RED], alpha);
+                        block_rgba[idx][1] = tex_premultiply_channel(pixels[pixel_idx + Order::GREEN], alpha);
+                        block_rgba[idx][2] = tex_premultiply_channel(pixels[pixel_idx + Order::BLUE], alpha);
+                    } else {
+                        block_rgba[idx][0] = pixels[pixel_idx + Order::RED];
+                        block_rgba[idx][1] = pixels[pixel_idx + Order::GREEN];
+                        block_rgba[idx][2] = pixels[pixel_idx + Order::BLUE];
+                    }
+                    block_rgba[idx][3] = alpha;
+                    alphas[idx] = alpha;
+                } else {
+                    block_rgba[idx][0] = 0;
+                    block_rgba[idx][1] = 0;
+                    block_rgba[idx][2] = 0;
+                    block_rgba[idx][3] = 0;
+                    alphas[idx] = 0;
+                }
             }
         }
     }
-}
 
-// Fast DXT5 decompression
-void decompress_dxt5_block(const uint8_t* input, int x, int y, int width, int height, uint8_t* rgba) {
-    // Read alpha values
-    uint8_t alpha0 = input[0];
-    uint8_t alpha1 = input[1];
+    // Alpha endpoints (min and max, so always the 6 value mode) and indices, bytes 0..7
+    static inline void encode_alpha(const uint8_t alphas[16], uint8_t* output) {
+        uint8_t alpha0 = alphas[0];
+        uint8_t alpha1 = alphas[0];
+        for (int i = 1; i < 16; i++) {
+            alpha0 = std::min(alpha0, alphas[i]);
+            alpha1 = std::max(alpha1, alphas[i]);
+        }
     
-    // Read alpha bits
-    uint64_t alpha_bits = 0;
-    for (int i = 0; i < 6; i++) {
-        alpha_bits |= ((uint64_t)input[2 + i] << (i * 8));
-    }
+        output[0] = alpha0;
+        output[1] = alpha1;
     
-    // Build alpha palette
-    uint8_t alpha_palette[8];
-    alpha_palette[0] = alpha0;
-    alpha_palette[1] = alpha1;
-    if (alpha0 > alpha1) {
-        for (int i = 1; i < 7; i++) {
-            alpha_palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+        // Calculate alpha palette
+        uint8_t alpha_palette[8];
+        build_alpha_palette(alpha0, alpha1, alpha_palette);
+    
+        // Encode alpha indices
+        uint64_t alpha_bits = 0;
+        for (int i = 0; i < 16; i++) {
+            uint8_t alpha = alphas[i];
+            int best_idx = 0;
+            int best_diff = abs(alpha - alpha_palette[0]);
+            for (int j = 1; j < 8; j++) {
+                int diff = abs(alpha - alpha_palette[j]);
+                if (diff < best_diff) {
+                    best_diff = diff;
+                    best_idx = j;
+                }
+            }
+            alpha_bits |= ((uint64_t)best_idx << (i * 3));
         }
-    } else {
-        for (int i = 1; i < 5; i++) {
-            alpha_palette[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+    
+        for (int i = 0; i < 6; i++) {
+            output[2 + i] = (alpha_bits >> (i * 8)) & 0xFF;
         }
-        alpha_palette[6] = 0;
-        alpha_palette[7] = 255;
     }
+
+    // Darkest and brightest pixel by luminance as 565 endpoints
+    static inline void luminance_endpoints(const uint8_t (*block_rgba)[4], uint16_t* color0, uint16_t* color1) {
+        int min_lum = 999999;
+        int max_lum = 0;
+        uint8_t color0_rgb[3] = {0, 0, 0};
+        uint8_t color1_rgb[3] = {0, 0, 0};
     
-    // Read color values
-    uint16_t color0 = input[8] | (input[9] << 8);
-    uint16_t color1 = input[10] | (input[11] << 8);
-    uint32_t color_bits = input[12] | (input[13] << 8) | (input[14] << 16) | (input[15] << 24);
+        for (int i = 0; i < 16; i++) {
+            int lum = block_rgba[i][0] * 2 + block_rgba[i][1] * 4 + block_rgba[i][2];
+            if (lum < min_lum) {
+                min_lum = lum;
+                color0_rgb[0] = block_rgba[i][0];
+                color0_rgb[1] = block_rgba[i][1];
+                color0_rgb[2] = block_rgba[i][2];
+            }
+            if (lum > max_lum) {
+                max_lum = lum;
+                color1_rgb[0] = block_rgba[i][0];
+                color1_rgb[1] = block_rgba[i][1];
+                color1_rgb[2] = block_rgba[i][2];
+            }
+        }
+    
+        *color0 = rgb_to_565(color0_rgb[0], color0_rgb[1], color0_rgb[2]);
+        *color1 = rgb_to_565(color1_rgb[0], color1_rgb[1], color1_rgb[2]);
+    }
+
+    // Color endpoints and indices, bytes 8..15
+    static inline void write_color(uint16_t color0, uint16_t color1, uint32_t color_bits, uint8_t* output) {
+        output[8] = color0 & 0xFF;
+        output[9] = (color0 >> 8) & 0xFF;
+        output[10] = color1 & 0xFF;
+        output[11] = (color1 >> 8) & 0xFF;
+        output[12] = color_bits & 0xFF;
+        output[13] = (color_bits >> 8) & 0xFF;
+        output[14] = (color_bits >> 16) & 0xFF;
+        output[15] = (color_bits >> 24) & 0xFF;
+    }
+
+    // Fast DXT5 decompression. UNPREMULTIPLY divides the color by alpha as pixels are written.
+    template <bool UNPREMULTIPLY, PixelLayout LAYOUT, bool CLIPPED>
+    static void decode(const uint8_t* input, int x, int y, int width, int height, uint8_t* pixels) {
+        typedef ChannelOrder<LAYOUT> Order;
+        // Read alpha values
+        uint8_t alpha0 = input[0];
+        uint8_t alpha1 = input[1];
     
-    // Convert 565 to RGB888
-    uint8_t r0 = ((color0 >> 11) & 0x1F) << 3;
-    uint8_t g0 = ((color0 >> 5) & 0x3F) << 2;
-    uint8_t b0 = (color0 & 0x1F) << 3;
-    uint8_t r1 = ((color1 >> 11) & 0x1F) << 3;
-    uint8_t g1 = ((color1 >> 5) & 0x3F) << 2;
-    uint8_t b1 = (color1 & 0x1F) << 3;
+        // Read alpha bits
+        uint64_t alpha_bits = 0;
+        for (int i = 0; i < 6; i++) {
+            alpha_bits |= ((uint64_t)input[2 + i] << (i * 8));
+        }
     
-    // Build color palette
-    uint8_t color_palette[4][3] = {
-        {r0, g0, b0},
-        {r1, g1, b1},
-        {(uint8_t)((r0 * 2 + r1) / 3), (uint8_t)((g0 * 2 + g1) / 3), (uint8_t)((b0 * 2 + b1) / 3)},
-        {(uint8_t)((r0 + r1 * 2) / 3), (uint8_t)((g0 + g1 * 2) / 3), (uint8_t)((b0 + b1 * 2) / 3)}
-    };
+        // Build alpha palette
+        uint8_t alpha_palette[8];
+        build_alpha_palette(alpha0, alpha1, alpha_palette);
     
-    // Decode pixels
-    for (int py = 0; py < 4; py++) {
-        for (int px = 0; px < 4; px++) {
-            int img_x = x + px;
-            int img_y = y + py;
+        // Read color values
+        uint16_t color0 = input[8] | (input[9] << 8);
+        uint16_t color1 = input[10] | (input[11] << 8);
+        uint32_t color_bits = input[12] | (input[13] << 8) | (input[14] << 16) | (input[15] << 24);
+    
+        // Build color palette (DXT5 always uses the 4 color mode)
+        uint8_t color_palette[4][3];
+        build_color_palette(color0, color1, true, color_palette);
+    
+        // Decode pixels
+        for (int py = 0; py < 4; py++) {
+            for (int px = 0; px < 4; px++) {
+                int img_x = x + px;
+                int img_y = y + py;
             
-            if (img_x < width && img_y < height) {
-                int idx = py * 4 + px;
-                int pixel_idx = (img_y * width + img_x) * 4;
+                if (!CLIPPED || (img_x < width && img_y < height)) {
+                    int idx = py * 4 + px;
+                    int pixel_idx = (img_y * width + img_x) * 4;
                 
-                // Get color index
-                int color_idx = (color_bits >> (idx * 2)) & 3;
-                rgba[pixel_idx] = color_palette[color_idx][0];
-                rgba[pixel_idx + 1] = color_palette[color_idx][1];
-                rgba[pixel_idx + 2] = color_palette[color_idx][2];
+                    // Get color and alpha index
+                    int color_idx = (color_bits >> (idx * 2)) & 3;
+                    int alpha_idx = (alpha_bits >> (idx * 3)) & 7;
+                    uint8_t alpha = alpha_palette[alpha_idx];
+                    if (UNPREMULTIPLY) {
+                        pixels[pixel_idx + Order::RED] = tex_unpremultiply_channel(color_palette[color_idx][0], alpha);
+                        pixels[pixel_idx + Order::GREEN] = tex_unpremultiply_channel(color_palette[color_idx][1], alpha);
+                        pixels[pixel_idx + Order::BLUE] = tex_unpremultiply_channel(color_palette[color_idx][2], alpha);
+                    } else {
+                        pixels[pixel_idx + Order::RED] = color_palette[color_idx][0];
+                        pixels[pixel_idx + Order::GREEN] = color_palette[color_idx][1];
+                        pixels[pixel_idx + Order::BLUE] = color_palette[color_idx][2];
+                    }
+                    pixels[pixel_idx + 3] = alpha;
+                }
+            }
+        }
+    }
+};
+
+template <typename Isa>
+struct Dxt1Kernels {
+    static constexpr int FORMAT = TEX_FORMAT_DXT1;
+
+    // Fast DXT1 decompression. UNPREMULTIPLY divides the color by alpha as pixels are written.
+    template <bool UNPREMULTIPLY, PixelLayout LAYOUT, bool CLIPPED>
+    static void decode(const uint8_t* input, int x, int y, int width, int height, uint8_t* pixels) {
+        typedef ChannelOrder<LAYOUT> Order;
+        // Read color values
+        uint16_t color0 = input[0] | (input[1] << 8);
+        uint16_t color1 = input[2] | (input[3] << 8);
+        uint32_t color_bits = input[4] | (input[5] << 8) | (input[6] << 16) | (input[7] << 24);
+    
+        // Build color palette (RGBA; 3 colors and transparent black unless color0 > color1)
+        uint8_t color_palette[4][4];
+        build_color_palette(color0, color1, color0 > color1, color_palette);
+    
+        // Decode pixels
+        for (int py = 0; py < 4; py++) {
+            for (int px = 0; px < 4; px++) {
+                int img_x = x + px;
+                int img_y = y + py;
+            
+                if (!CLIPPED || (img_x < width && img_y < height)) {
+                    int idx = py * 4 + px;
+                    int pixel_idx = (img_y * width + img_x) * 4;
                 
-                // Get alpha index
-                int alpha_idx = (alpha_bits >> (idx * 3)) & 7;
-                rgba[pixel_idx + 3] = alpha_palette[alpha_idx];
+                    // Get color index
+                    int color_idx = (color_bits >> (idx * 2)) & 3;
+                    uint8_t alpha = color_palette[color_idx][3];
+                    if (UNPREMULTIPLY) {
+                        pixels[pixel_idx + Order::RED] = tex_unpremultiply_channel(color_palette[color_idx][0], alpha);
+                        pixels[pixel_idx + Order::GREEN] = tex_unpremultiply_channel(color_palette[color_idx][1], alpha);
+                        pixels[pixel_idx + Order::BLUE] = tex_unpremultiply_channel(color_palette[color_idx][2], alpha);
+                    } else {
+                        pixels[pixel_idx + Order::RED] = color_palette[color_idx][0];
+                        pixels[pixel_idx + Order::GREEN] = color_palette[color_idx][1];
+                        pixels[pixel_idx + Order::BLUE] = color_palette[color_idx][2];
+                    }
+                    pixels[pixel_idx + 3] = alpha;
+                }
             }
         }
     }
+};
+
+// ============================================================================
+// Generic whole image drivers
+// ============================================================================
+
+// Per call options of the whole image drivers
+struct DriverOptions {
+    int flags;               // TEX_FLAG_*
+    const uint8_t* parent;   // encoded next smaller mip level to seed refined blocks from, or NULL
+    int prefetch;            // blocks ahead to prefetch, 0 for none
+};
+
+// One driver per format x ISA x pixel layout x alpha handling; the edge mode is picked per
+// block inside for_each_block.
+template <typename Kernels, bool PREMULTIPLY, PixelLayout LAYOUT>
+static void encode_image(const uint8_t* pixels, int width, int height, uint8_t* output, const DriverOptions& options,
+                         TexStats* stats) {
+    constexpr const TexCodecDescriptor& codec = *tex_find_codec(Kernels::FORMAT);
+    for_each_block<false>(width, height, pixels, output, codec, options.prefetch, "encode_band", stats, [=](int i, int bx, int by, bool clipped) {
+        uint8_t* block = output + (size_t)i * codec.block_bytes;
+        if (clipped) {
+            Kernels::template encode<PREMULTIPLY, LAYOUT, true>(pixels, bx * 4, by * 4, width, height, block);
+        } else {
+            Kernels::template encode<PREMULTIPLY, LAYOUT, false>(pixels, bx * 4, by * 4, width, height, block);
+        }
+    });
+}
+
+// Refined encode. Blocks are seeded from their parent block in options.parent, which covers
+// the same area at half the resolution, and from their left and top neighbours when
+// TEX_FLAG_NEIGHBOUR_SEEDED is set.
+template <typename Kernels, bool PREMULTIPLY, PixelLayout LAYOUT>
+static void encode_image_refined(const uint8_t* pixels, int width, int height, uint8_t* output, const DriverOptions& options,
+                                 TexStats* stats) {
+    constexpr const TexCodecDescriptor& codec = *tex_find_codec(Kernels::FORMAT);
+    bool warm = (options.flags & TEX_FLAG_NEIGHBOUR_SEEDED) != 0;
+    const uint8_t* parent = options.parent;
+    int parent_block_width = (std::max(width >> 1, 1) + 3) / 4;
+    for_each_block_seeded(width, height, pixels, output, codec, options.prefetch, stats,
+                          [=](int i, int bx, int by, bool clipped, const uint8_t* left, const uint8_t* top) {
+        uint8_t* block = output + (size_t)i * codec.block_bytes;
+        const uint8_t* seeds[3] = {
+            parent ? parent + ((size_t)(by / 2) * parent_block_width + bx / 2) * codec.block_bytes : nullptr,
+            warm ? left : nullptr,
+            warm ? top : nullptr,
+        };
+        if (clipped) {
+            return Kernels::template encode_refined<PREMULTIPLY, LAYOUT, true>(pixels, bx * 4, by * 4, width, height, seeds, 3, block);
+        }
+        return Kernels::template encode_refined<PREMULTIPLY, LAYOUT, false>(pixels, bx * 4, by * 4, width, height, seeds, 3, block);
+    });
+}
+
+template <typename Kernels, bool UNPREMULTIPLY, PixelLayout LAYOUT>
+static void decode_image(const uint8_t* input, int width, int height, uint8_t* pixels, const DriverOptions& options,
+                         TexStats* stats) {
+    constexpr const TexCodecDescriptor& codec = *tex_find_codec(Kernels::FORMAT);
+    for_each_block<true>(width, height, pixels, input, codec, options.prefetch, "decode_band", stats, [=](int i, int bx, int by, bool clipped) {
+        const uint8_t* block = input + (size_t)i * codec.block_bytes;
+        if (clipped) {
+            Kernels::template decode<UNPREMULTIPLY, LAYOUT, true>(block, bx * 4, by * 4, width, height, pixels);
+        } else {
+            Kernels::template decode<UNPREMULTIPLY, LAYOUT, false>(block, bx * 4, by * 4, width, height, pixels);
+        }
+    });
+}
+
+typedef void (*ImageCodecFn)(const uint8_t* input, int width, int height, uint8_t* output, const DriverOptions& options,
+                             TexStats* stats);
+
+// Index into the per flag driver tables below
+static inline int flag_variant(int flags) {
+    return ((flags & TEX_FLAG_PREMULTIPLIED) ? 1 : 0) | ((flags & TEX_FLAG_BGRA_PIXELS) ? 2 : 0);
+}
+
+// TEX_FLAG_ALPHA_BLEED asks for a bled copy of the pixels. Premultiplied encodes turn transparent
+// pixels black anyway, so they skip it.
+static inline bool wants_alpha_bleed(int flags) {
+    return (flags & TEX_FLAG_ALPHA_BLEED) && !(flags & TEX_FLAG_PREMULTIPLIED);
+}
+
+// Bled copy of a 4 channel image; an empty buffer when memory runs out
+static TexBuffer alpha_bled_copy(const uint8_t* pixels, int width, int height) {
+    TexBuffer copy((size_t)width * height * 4);
+    if (copy.ok()) {
+        memcpy(copy.data(), pixels, copy.size());
+        if (tex_alpha_bleed(copy.data(), width, height, 0) != TEX_OK) {
+            copy = TexBuffer();
+        }
+    }
+    return copy;
 }
 
-// Main DXT1 decompression function with multi-threading
-__declspec(dllexport) void decompress_dxt1(const uint8_t* input, int width, int height, uint8_t* rgba) {
-    int block_width = (width + 3) / 4;
-    int block_height = (height + 3) / 4;
-    int total_blocks = block_width * block_height;
+// Whole image encode with the shared timing and TexStats bookkeeping; parent is the encoded
+// next smaller mip level when the image is part of a chain. Without the memory for an alpha bled
+// copy the pixels are encoded as they are.
+template <typename Kernels>
+static void encode_entry(const uint8_t* pixels, int width, int height, uint8_t* output, int flags, TexStats* stats,
+                         const uint8_t* parent = nullptr) {
+    static constexpr ImageCodecFn DRIVERS[4] = {
+        encode_image<Kernels, false, PixelLayout::RGBA>, encode_image<Kernels, true, PixelLayout::RGBA>,
+        encode_image<Kernels, false, PixelLayout::BGRA>, encode_image<Kernels, true, PixelLayout::BGRA>,
+    };
+    static constexpr ImageCodecFn REFINED_DRIVERS[4] = {
+        encode_image_refined<Kernels, false, PixelLayout::RGBA>, encode_image_refined<Kernels, true, PixelLayout::RGBA>,
+        encode_image_refined<Kernels, false, PixelLayout::BGRA>, encode_image_refined<Kernels, true, PixelLayout::BGRA>,
+    };
+    constexpr const TexCodecDescriptor& codec = *tex_find_codec(Kernels::FORMAT);
+    auto start = std::chrono::steady_clock::now();
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    TexBuffer bled;
+    if (wants_alpha_bleed(flags)) {
+        bled = alpha_bled_copy(pixels, width, height);
+        if (bled.ok()) {
+            pixels = bled.data();
+        }
+        if (stats) {
+            stats->setup_ms = ms_since(start);
+            stats->peak_scratch_bytes = (long long)bled.size();
+        }
+    }
     
-    // Initialize output to black/transparent
-    memset(rgba, 0, width * height * 4);
+    const ImageCodecFn* drivers = (flags & TEX_FLAG_REFINE) ? REFINED_DRIVERS : DRIVERS;
+    DriverOptions options = {flags, parent, g_prefetch_blocks.load(std::memory_order_relaxed)};
+    drivers[flag_variant(flags)](pixels, width, height, output, options, stats);
     
-    #ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic, 64)
-    #endif
-    for (int i = 0; i < total_blocks; i++) {
-        int by = i / block_width;
-        int bx = i % block_width;
-        int block_idx = i * 8;  // DXT1 is 8 bytes per block
-        decompress_dxt1_block(input + block_idx, bx * 4, by * 4, width, height, rgba);
+    if (stats) {
+        stats->bytes_read = (long long)width * height * 4;
+        stats->bytes_written = (long long)((width + 3) / 4) * ((height + 3) / 4) * codec.block_bytes;
+        stats->total_ms = ms_since(start);
     }
 }
 
-// Main DXT5 decompression function with multi-threading
-__declspec(dllexport) void decompress_dxt5(const uint8_t* input, int width, int height, uint8_t* rgba) {
-    int block_width = (width + 3) / 4;
-    int block_height = (height + 3) / 4;
-    int total_blocks = block_width * block_height;
+// Whole image decode; pixels outside the image's blocks are cleared to transparent black first
+template <typename Kernels>
+static void decode_entry(const uint8_t* input, int width, int height, uint8_t* pixels, int flags, TexStats* stats) {
+    static constexpr ImageCodecFn DRIVERS[4] = {
+        decode_image<Kernels, false, PixelLayout::RGBA>, decode_image<Kernels, true, PixelLayout::RGBA>,
+        decode_image<Kernels, false, PixelLayout::BGRA>, decode_image<Kernels, true, PixelLayout::BGRA>,
+    };
+    constexpr const TexCodecDescriptor& codec = *tex_find_codec(Kernels::FORMAT);
+    auto start = std::chrono::steady_clock::now();
     
     // Initialize output to black/transparent
-    memset(rgba, 0, width * height * 4);
+    memset(pixels, 0, (size_t)width * height * 4);
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        stats->setup_ms = ms_since(start);
+    }
+    
+    DriverOptions options = {flags, nullptr, g_prefetch_blocks.load(std::memory_order_relaxed)};
+    DRIVERS[flag_variant(flags)](input, width, height, pixels, options, stats);
     
+    if (stats) {
+        stats->bytes_read = (long long)((width + 3) / 4) * ((height + 3) / 4) * codec.block_bytes;
+        stats->bytes_written = (long long)width * height * 4;
+        stats->total_ms = ms_since(start);
+    }
+}
+
+// Most levels a TEX mip chain can have: 16 bit sides halve at most 15 times
+static const int MAX_MIP_LEVELS = 16;
+
+// Whole mip chain encode: generates every smaller level from pixels, then encodes the levels
+// smallest first into the layout of a mipmapped TEX data section. With TEX_FLAG_MIP_SEEDED each
+// level is seeded from the one encoded before it; with TEX_FLAG_ALPHA_BLEED level 0 is bled
+// before the smaller levels are made from it.
+template <typename Kernels>
+static int encode_chain(const uint8_t* pixels, int width, int height, uint8_t* output, int flags, TexStats* stats) {
+    auto start = std::chrono::steady_clock::now();
+    TexBuffer bled;
+    if (wants_alpha_bleed(flags)) {
+        bled = alpha_bled_copy(pixels, width, height);
+        if (!bled.ok()) {
+            return TEX_ERR_NOMEM;
+        }
+        pixels = bled.data();
+        flags &= ~TEX_FLAG_ALPHA_BLEED;
+    }
+    TexHeader header = {width, height, Kernels::FORMAT, true};
+    int levels = tex_mipmap_count(width, height);
+    int level_width[MAX_MIP_LEVELS];
+    int level_height[MAX_MIP_LEVELS];
+    size_t mip_bytes = 0;
+    for (int level = 0; level < levels; level++) {
+        level_width[level] = std::max(width >> level, 1);
+        level_height[level] = std::max(height >> level, 1);
+        if (level > 0) {
+            mip_bytes += (size_t)level_width[level] * level_height[level] * 4;
+        }
+    }
+    TexBuffer mips(std::max(mip_bytes, (size_t)4));
+    if (!mips.ok()) {
+        return TEX_ERR_NOMEM;
+    }
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    const uint8_t* level_pixels[MAX_MIP_LEVELS];
+    level_pixels[0] = pixels;
+    uint8_t* next = mips.data();
+    for (int level = 1; level < levels; level++) {
+        tex_downsample_mip(level_pixels[level - 1], level_width[level - 1], level_height[level - 1], next);
+        level_pixels[level] = next;
+        next += (size_t)level_width[level] * level_height[level] * 4;
+    }
+    double setup_ms = ms_since(start);
+
+    for (int level = levels - 1; level >= 0; level--) {
+        const uint8_t* parent = nullptr;
+        if ((flags & TEX_FLAG_MIP_SEEDED) && level + 1 < levels) {
+            parent = output + tex_level_offset(header, level + 1);
+        }
+        TexStats call;
+        encode_entry<Kernels>(level_pixels[level], level_width[level], level_height[level], output + tex_level_offset(header, level),
+                              flags, stats ? &call : nullptr, parent);
+        if (stats) {
+            tex_stats_accumulate(*stats, call);
+        }
+    }
+
+    if (stats) {
+        stats->setup_ms = setup_ms;
+        stats->bytes_read = (long long)width * height * 4;
+        stats->peak_scratch_bytes = (long long)(mips.size() + bled.size());
+        stats->total_ms = ms_since(start);
+    }
+    return TEX_OK;
+}
+
+typedef Dxt5Kernels<IsaScalar> Dxt5Scalar;
+typedef Dxt1Kernels<IsaScalar> Dxt1Scalar;
+
+// ============================================================================
+// Batch decode
+// ============================================================================
+
+// Pixels per scheduling unit of BGRA8 jobs, as many as a band of blocks covers
+static const int BATCH_PIXEL_UNIT = BAND_BLOCKS * 16;
+
+// Blocks (pixels for BGRA8) of a job and how many scheduling units they make
+static inline long long batch_job_items(const TexDecodeJob& job) {
+    if (job.format == TEX_FORMAT_BGRA8) {
+        return (long long)job.width * job.height;
+    }
+    return (long long)((job.width + 3) / 4) * ((job.height + 3) / 4);
+}
+
+static inline long long batch_job_units(const TexDecodeJob& job) {
+    int unit = job.format == TEX_FORMAT_BGRA8 ? BATCH_PIXEL_UNIT : BAND_BLOCKS;
+    return (batch_job_items(job) + unit - 1) / unit;
+}
+
+template <typename Kernels, bool UNPREMULTIPLY, PixelLayout LAYOUT>
+static inline void decode_batch_blocks(const TexDecodeJob& job, long long begin, long long end) {
+    constexpr const TexCodecDescriptor& codec = *tex_find_codec(Kernels::FORMAT);
+    int block_width = (job.width + 3) / 4;
+    for (long long i = begin; i < end; i++) {
+        int by = (int)(i / block_width);
+        int bx = (int)(i % block_width);
+        const uint8_t* block = job.input + i * codec.block_bytes;
+        if (bx * 4 + 4 > job.width || by * 4 + 4 > job.height) {
+            Kernels::template decode<UNPREMULTIPLY, LAYOUT, true>(block, bx * 4, by * 4, job.width, job.height, job.rgba);
+        } else {
+            Kernels::template decode<UNPREMULTIPLY, LAYOUT, false>(block, bx * 4, by * 4, job.width, job.height, job.rgba);
+        }
+    }
+}
+
+// Items [begin, end) of one job. BGRA8 always comes out RGBA, as in tex_decode_level_ex.
+template <bool UNPREMULTIPLY, PixelLayout LAYOUT>
+static void decode_batch_unit(const TexDecodeJob& job, long long begin, long long end) {
+    switch (job.format) {
+        case TEX_FORMAT_DXT1: decode_batch_blocks<Dxt1Scalar, UNPREMULTIPLY, LAYOUT>(job, begin, end); break;
+        case TEX_FORMAT_DXT5: decode_batch_blocks<Dxt5Scalar, UNPREMULTIPLY, LAYOUT>(job, begin, end); break;
+        default: tex_bgra8_to_rgba_span(job.input, job.rgba, begin, end, UNPREMULTIPLY); break;
+    }
+}
+
+typedef void (*BatchUnitFn)(const TexDecodeJob& job, long long begin, long long end);
+
+extern "C" {
+
+// Block kernels on straight alpha RGBA data
+void compress_dxt5_block(const uint8_t* rgba, int x, int y, int width, int height, uint8_t* output) {
+    Dxt5Scalar::encode<false, PixelLayout::RGBA, true>(rgba, x, y, width, height, output);
+}
+
+void decompress_dxt1_block(const uint8_t* input, int x, int y, int width, int height, uint8_t* rgba) {
+    Dxt1Scalar::decode<false, PixelLayout::RGBA, true>(input, x, y, width, height, rgba);
+}
+
+void decompress_dxt5_block(const uint8_t* input, int x, int y, int width, int height, uint8_t* rgba) {
+    Dxt5Scalar::decode<false, PixelLayout::RGBA, true>(input, x, y, width, height, rgba);
+}
+
+// Main compression function with multi-threading
+__declspec(dllexport) void compress_dxt5_ex(const uint8_t* rgba, int width, int height, uint8_t* output, int flags, TexStats* stats) {
+    TEX_TRACE_SCOPE("codec", "compress_dxt5");
+    encode_entry<Dxt5Scalar>(rgba, width, height, output, flags, stats);
+}
+
+__declspec(dllexport) void compress_dxt5(const uint8_t* rgba, int width, int height, uint8_t* output) {
+    compress_dxt5_ex(rgba, width, height, output, 0, nullptr);
+}
+
+// Full mip chain, smallest level first; output holds tex_level_offset(header, 0) plus the
+// level 0 size
+__declspec(dllexport) int compress_dxt5_mips_ex(const uint8_t* rgba, int width, int height, uint8_t* output, int flags, TexStats* stats) {
+    TEX_TRACE_SCOPE("codec", "compress_dxt5_mips");
+    if (!rgba || !output || width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF) {
+        return TEX_ERR_ARGS;
+    }
+    return encode_chain<Dxt5Scalar>(rgba, width, height, output, flags, stats);
+}
+
+// Main DXT1 decompression function with multi-threading
+__declspec(dllexport) void decompress_dxt1_ex(const uint8_t* input, int width, int height, uint8_t* rgba, int flags, TexStats* stats) {
+    TEX_TRACE_SCOPE("codec", "decompress_dxt1");
+    decode_entry<Dxt1Scalar>(input, width, height, rgba, flags, stats);
+}
+
+__declspec(dllexport) void decompress_dxt1(const uint8_t* input, int width, int height, uint8_t* rgba) {
+    decompress_dxt1_ex(input, width, height, rgba, 0, nullptr);
+}
+
+// Main DXT5 decompression function with multi-threading
+__declspec(dllexport) void decompress_dxt5_ex(const uint8_t* input, int width, int height, uint8_t* rgba, int flags, TexStats* stats) {
+    TEX_TRACE_SCOPE("codec", "decompress_dxt5");
+    decode_entry<Dxt5Scalar>(input, width, height, rgba, flags, stats);
+}
+
+__declspec(dllexport) void decompress_dxt5(const uint8_t* input, int width, int height, uint8_t* rgba) {
+    decompress_dxt5_ex(input, width, height, rgba, 0, nullptr);
+}
+
+// Every job's units numbered one after the other, so a single dynamic loop spreads the blocks
+// of all images over the pool; a unit never spans two jobs
+__declspec(dllexport) int decompress_batch(const TexDecodeJob* jobs, int count, int flags, TexStats* stats) {
+    TEX_TRACE_SCOPE("codec", "decompress_batch");
+    static constexpr BatchUnitFn UNIT_DRIVERS[4] = {
+        decode_batch_unit<false, PixelLayout::RGBA>, decode_batch_unit<true, PixelLayout::RGBA>,
+        decode_batch_unit<false, PixelLayout::BGRA>, decode_batch_unit<true, PixelLayout::BGRA>,
+    };
+    auto start = std::chrono::steady_clock::now();
+    if (count < 0 || (count > 0 && !jobs)) {
+        return TEX_ERR_ARGS;
+    }
+    for (int j = 0; j < count; j++) {
+        const TexDecodeJob& job = jobs[j];
+        if (!job.input || !job.rgba || job.width <= 0 || job.height <= 0 || job.width > 0xFFFF || job.height > 0xFFFF) {
+            return TEX_ERR_ARGS;
+        }
+        if (job.format != TEX_FORMAT_DXT1 && job.format != TEX_FORMAT_DXT5 && job.format != TEX_FORMAT_BGRA8) {
+            return TEX_ERR_FORMAT;
+        }
+    }
+
+    // first_unit[j] is the number of units before job j
+    TexBuffer unit_table(((size_t)count + 1) * sizeof(long long));
+    if (!unit_table.ok()) {
+        return TEX_ERR_NOMEM;
+    }
+    long long* first_unit = (long long*)unit_table.data();
+    first_unit[0] = 0;
+    for (int j = 0; j < count; j++) {
+        first_unit[j + 1] = first_unit[j] + batch_job_units(jobs[j]);
+    }
+    long long total_units = first_unit[count];
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        stats->setup_ms = ms_since(start);
+    }
+
+    BatchUnitFn decode_unit = UNIT_DRIVERS[flag_variant(flags)];
+    long long uniform = 0;
+    long long edge = 0;
+    long long blocks = 0;
+    int threads = 1;
     #ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic, 64)
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:uniform, edge, blocks) reduction(max:threads) if (total_units > 1)
     #endif
-    for (int i = 0; i < total_blocks; i++) {
-        int by = i / block_width;
-        int bx = i % block_width;
-        int block_idx = i * 16;  // DXT5 is 16 bytes per block
-        decompress_dxt5_block(input + block_idx, bx * 4, by * 4, width, height, rgba);
+    for (long long u = 0; u < total_units; u++) {
+        TEX_TRACE_SCOPE("codec", "batch_band");
+        int j = (int)(std::upper_bound(first_unit, first_unit + count + 1, u) - first_unit) - 1;
+        const TexDecodeJob& job = jobs[j];
+        int unit = job.format == TEX_FORMAT_BGRA8 ? BATCH_PIXEL_UNIT : BAND_BLOCKS;
+        long long begin = (u - first_unit[j]) * unit;
+        long long end = std::min(batch_job_items(job), begin + unit);
+        decode_unit(job, begin, end);
+        if (stats && job.format != TEX_FORMAT_BGRA8) {
+            const TexCodecDescriptor& codec = *tex_find_codec(job.format);
+            int block_width = (job.width + 3) / 4;
+            for (long long i = begin; i < end; i++) {
+                int bx = (int)(i % block_width);
+                int by = (int)(i / block_width);
+                if (bx * 4 + 4 > job.width || by * 4 + 4 > job.height) {
+                    edge++;
+                } else if (block_is_uniform(job.input + i * codec.block_bytes, codec)) {
+                    uniform++;
+                }
+            }
+            blocks += end - begin;
+        }
+        #ifdef _OPENMP
+        threads = std::max(threads, omp_get_num_threads());
+        #endif
+    }
+
+    if (stats) {
+        stats->blocks_ms = ms_since(start) - stats->setup_ms;
+        stats->blocks_uniform = uniform;
+        stats->blocks_edge = edge;
+        stats->blocks_fast = blocks - uniform - edge;
+        stats->threads = threads;
+        for (int j = 0; j < count; j++) {
+            stats->bytes_read += tex_level_size(jobs[j].format, jobs[j].width, jobs[j].height);
+            stats->bytes_written += (long long)jobs[j].width * jobs[j].height * 4;
+        }
+        stats->peak_scratch_bytes = (long long)unit_table.size();
+        stats->total_ms = ms_since(start);
+    }
+    return TEX_OK;
+}
+
+// Prefetch distance in blocks for every later codec call, 0 turns prefetching off
+__declspec(dllexport) int tex_set_prefetch_distance(int blocks) {
+    if (blocks < 0 || blocks > MAX_PREFETCH_BLOCKS) {
+        return TEX_ERR_ARGS;
     }
+    g_prefetch_blocks.store(blocks, std::memory_order_relaxed);
+    return TEX_OK;
+}
+
+__declspec(dllexport) int tex_get_prefetch_distance(void) {
+    return g_prefetch_blocks.load(std::memory_order_relaxed);
+}
+
+#ifdef __SSE2__
+// Writes every cache line of buffer back to memory and drops it from all cache levels
+static void evict_buffer(const uint8_t* buffer, size_t size) {
+    for (size_t i = 0; i < size; i += 64) {
+        _mm_clflush(buffer + i);
+    }
+    _mm_clflush(buffer + size - 1);
+    _mm_mfence();
+}
+#else
+// Larger than the last level cache of current desktop CPUs
+static const size_t AUTOTUNE_EVICT_BYTES = (size_t)64 << 20;
+static volatile uint8_t g_evict_sink;
+
+// Reads and rewrites one byte per cache line of buffer, which pushes everything else, including
+// dirty lines, out of the caches
+static void evict_caches(uint8_t* buffer, size_t size) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i += 64) {
+        buffer[i] += 1;
+        sum += buffer[i];
+    }
+    g_evict_sink = sum;
+}
+#endif
+
+// Distance the first successful tex_autotune_prefetch published, -1 before that. The lock keeps
+// concurrent calls from measuring at the same time.
+static std::mutex g_autotune_lock;
+static int g_autotuned_blocks = -1;
+
+// Times a DXT5 encode and decode of a wide synthetic image at each candidate distance, which is
+// passed straight to the drivers, and returns the fastest; other codec calls keep using
+// g_prefetch_blocks meanwhile. The image, blocks and output are flushed from the caches before
+// each run, so every run starts from memory the way 8K textures do. Needs about 9 MB (73 MB
+// without SSE2, which evicts by walking a larger buffer); returns TEX_ERR_NOMEM without it.
+static int measure_prefetch_distance() {
+    static const int CANDIDATES[] = {0, 2, 4, 8, 16, 32, 64};
+    static const int CANDIDATE_COUNT = sizeof(CANDIDATES) / sizeof(CANDIDATES[0]);
+    static const int ROUNDS = 5;
+    const int width = 8192;
+    const int height = 128;
+    const size_t image_bytes = (size_t)width * height * 4;
+
+    TexBuffer source(image_bytes);
+    TexBuffer decoded(image_bytes);
+    TexBuffer blocks((size_t)(width / 4) * (height / 4) * 16);
+    if (!source.ok() || !decoded.ok() || !blocks.ok()) {
+        return TEX_ERR_NOMEM;
+    }
+#ifndef __SSE2__
+    TexBuffer evict(AUTOTUNE_EVICT_BYTES);
+    if (!evict.ok()) {
+        return TEX_ERR_NOMEM;
+    }
+#endif
+    // Smooth gradients with noise, so blocks take the regular endpoint path rather than the
+    // single color shortcut
+    uint32_t state = 12345;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            state = state * 1664525u + 1013904223u;
+            uint8_t* p = source.data() + ((size_t)y * width + x) * 4;
+            p[0] = (uint8_t)(x + (state >> 29));
+            p[1] = (uint8_t)(y + (state >> 26 & 7));
+            p[2] = (uint8_t)((x ^ y) + (state >> 23 & 7));
+            p[3] = (uint8_t)(255 - (state >> 24 & 31));
+        }
+    }
+
+    double best_ms[CANDIDATE_COUNT];
+    for (int c = 0; c < CANDIDATE_COUNT; c++) {
+        best_ms[c] = 1e30;
+    }
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int c = 0; c < CANDIDATE_COUNT; c++) {
+            DriverOptions options = {0, nullptr, CANDIDATES[c]};
+#ifdef __SSE2__
+            evict_buffer(source.data(), source.size());
+            evict_buffer(blocks.data(), blocks.size());
+            evict_buffer(decoded.data(), decoded.size());
+#else
+            evict_caches(evict.data(), evict.size());
+#endif
+            auto start = std::chrono::steady_clock::now();
+            encode_image<Dxt5Scalar, false, PixelLayout::RGBA>(source.data(), width, height, blocks.data(), options, nullptr);
+            decode_image<Dxt5Scalar, false, PixelLayout::RGBA>(blocks.data(), width, height, decoded.data(), options, nullptr);
+            best_ms[c] = std::min(best_ms[c], ms_since(start));
+        }
+    }
+
+    // The shortest distance within 1% of the fastest; the rest is timing noise
+    double fastest = *std::min_element(best_ms, best_ms + CANDIDATE_COUNT);
+    for (int c = 0; c < CANDIDATE_COUNT; c++) {
+        if (best_ms[c] <= fastest * 1.01) {
+            return CANDIDATES[c];
+        }
+    }
+    return DEFAULT_PREFETCH_BLOCKS;
+}
+
+// Measures once per process and publishes the chosen distance; later calls return it without
+// measuring or setting it again. Takes a few hundred ms on a multicore machine.
+__declspec(dllexport) int tex_autotune_prefetch(void) {
+    TEX_TRACE_SCOPE("codec", "autotune_prefetch");
+    std::lock_guard<std::mutex> lock(g_autotune_lock);
+    if (g_autotuned_blocks >= 0) {
+        return g_autotuned_blocks;
+    }
+    int chosen = measure_prefetch_distance();
+    if (chosen >= 0) {
+        g_prefetch_blocks.store(chosen, std::memory_order_relaxed);
+        g_autotuned_blocks = chosen;
+    }
+    return chosen;
 }
 
 } // extern "C"
+
+// Every ISA's kernels as plain block functions: straight alpha RGBA with bounds checks
+template <typename Isa>
+static constexpr DxtKernelVariant kernel_variant() {
+    return {Isa::NAME, Isa::supported,
+            Dxt5Kernels<Isa>::template encode<false, PixelLayout::RGBA, true>,
+            Dxt1Kernels<Isa>::template decode<false, PixelLayout::RGBA, true>,
+            Dxt5Kernels<Isa>::template decode<false, PixelLayout::RGBA, true>};
+}
+
+const DxtKernelVariant DXT_KERNEL_VARIANTS[] = {
+    kernel_variant<IsaScalar>(),
+};
+
+const int DXT_KERNEL_VARIANT_COUNT = sizeof(DXT_KERNEL_VARIANTS) / sizeof(DXT_KERNEL_VARIANTS[0]);
+
+constexpr TexUnpremultiplyTable TEX_UNPREMULTIPLY;
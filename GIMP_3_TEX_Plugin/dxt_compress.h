@@ -0,0 +1,317 @@
+/*
+Fast DXT compression library for GIMP TEX plugin - shared declarations
+Used by the library sources and the command line tools built next to it
+*/
+
+#ifndef DXT_COMPRESS_H
+#define DXT_COMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Status codes returned by the library entry points that can fail
+#define TEX_OK            0
+#define TEX_ERR_IO       -1
+#define TEX_ERR_FORMAT   -2
+#define TEX_ERR_ARGS     -3
+#define TEX_ERR_NOMEM    -4
+
+// TEX pixel formats (same values as TEXFormat in the plugins)
+#define TEX_FORMAT_DXT1   10
+#define TEX_FORMAT_DXT5   12
+#define TEX_FORMAT_BGRA8  20
+
+// Flags for the *_ex codec entry points
+#define TEX_FLAG_PREMULTIPLIED  1   // TEX data holds premultiplied color: encode premultiplies, decode unpremultiplies
+#define TEX_FLAG_BGRA_PIXELS    2   // the uncompressed side is BGRA instead of RGBA
+#define TEX_FLAG_REFINE         4   // encode: least squares endpoint refinement scored on the bit replicated palette GPUs decode, slower and closer to the source; blocks of up to 4 colors are solved directly. The gain shows on GPUs and standard BC1/BC3 decoders; this library's decoders (and so the plugins' previews) expand 565 by shifting, through which it is only about 0.3 dB
+#define TEX_FLAG_NEIGHBOUR_SEEDED 8   // with TEX_FLAG_REFINE: also seed blocks from their left and top neighbours' endpoints; 5 - 10 % slower, up to 2 dB better on smooth gradients and about 0.2 dB on average
+#define TEX_FLAG_MIP_SEEDED    16   // mip chain encode with TEX_FLAG_REFINE: seed blocks from their parent in the next smaller level
+#define TEX_FLAG_ALPHA_BLEED   32   // encode: give fully transparent pixels the nearest visible color first (tex_alpha_bleed)
+
+// Optional per call statistics, filled by the *_ex entry points when given a non NULL pointer.
+// Plain C layout so the plugins can mirror it with ctypes.
+typedef struct TexStats {
+    double total_ms;             // whole call
+    double setup_ms;             // clearing / preparing the output before the block loop
+    double blocks_ms;            // parallel block loop
+    long long blocks_uniform;    // single color blocks (equal color and alpha endpoints)
+    long long blocks_fast;       // full blocks through the regular endpoint path
+    long long blocks_refined;    // full blocks through an endpoint refinement path
+    long long blocks_edge;       // partial blocks on the right / bottom border
+    int threads;                 // worker threads that ran blocks
+    long long bytes_read;
+    long long bytes_written;
+    long long peak_scratch_bytes;  // heap scratch held by the call at its peak
+    long long refine_steps;      // least squares steps taken by refined blocks
+} TexStats;
+
+// Pluggable allocator for every heap buffer the library allocates. allocate must return memory
+// aligned to at least 64 bytes (or NULL); release gets the size that was requested.
+typedef struct TexAllocator {
+    void* (*allocate)(void* user, size_t size);
+    void (*release)(void* user, void* ptr, size_t size);
+    void* user;
+} TexAllocator;
+
+// Counters kept for whichever allocator is installed
+typedef struct TexAllocStats {
+    long long bytes_current;
+    long long bytes_peak;
+    long long bytes_total;     // sum of all allocation sizes
+    long long alloc_count;
+    long long free_count;
+    long long huge_page_allocs;  // allocations backed (or advised to be backed) by huge pages
+} TexAllocStats;
+
+// Page modes for large buffers from the default allocator (tex_set_huge_pages)
+#define TEX_PAGES_REGULAR      0
+#define TEX_PAGES_TRANSPARENT  1   // 2 MB aligned and madvise(MADV_HUGEPAGE); regular pages on Windows
+#define TEX_PAGES_EXPLICIT     2   // MAP_HUGETLB / MEM_LARGE_PAGES, else as TEX_PAGES_TRANSPARENT
+
+// Predicted zstd size of a TEX file and the statistics behind it (tex_size_estimate.cpp)
+typedef struct TexSizeEstimate {
+    long long predicted_bytes;
+    long long raw_bytes;              // whole file including the header
+    long long literal_bytes;          // data not covered by a match
+    double literal_entropy_bits;      // order 0 entropy of the literals, per 128 KB block
+    long long matched_bytes;
+    long long sequences;              // matches found by the greedy parse
+    long long repeat_sequences;       // of which reuse the previous match distance
+} TexSizeEstimate;
+
+// One image of a decompress_batch call
+typedef struct TexDecodeJob {
+    int format;            // TEX_FORMAT_DXT1, TEX_FORMAT_DXT5 or TEX_FORMAT_BGRA8
+    int width;
+    int height;
+    const uint8_t* input;  // tex_level_size(format, width, height) bytes
+    uint8_t* rgba;         // width * height * 4 bytes, one buffer per job
+} TexDecodeJob;
+
+extern "C" {
+
+// Block kernels (dxt_compress.cpp)
+void compress_dxt5_block(const uint8_t* rgba, int x, int y, int width, int height, uint8_t* output);
+void decompress_dxt1_block(const uint8_t* input, int x, int y, int width, int height, uint8_t* rgba);
+void decompress_dxt5_block(const uint8_t* input, int x, int y, int width, int height, uint8_t* rgba);
+
+// Whole image entry points (dxt_compress.cpp)
+__declspec(dllexport) void compress_dxt5(const uint8_t* rgba, int width, int height, uint8_t* output);
+__declspec(dllexport) void decompress_dxt1(const uint8_t* input, int width, int height, uint8_t* rgba);
+__declspec(dllexport) void decompress_dxt5(const uint8_t* input, int width, int height, uint8_t* rgba);
+
+// Same as above with TEX_FLAG_* flags, also filling *stats when it is not NULL
+__declspec(dllexport) void compress_dxt5_ex(const uint8_t* rgba, int width, int height, uint8_t* output, int flags, TexStats* stats);
+__declspec(dllexport) void decompress_dxt1_ex(const uint8_t* input, int width, int height, uint8_t* rgba, int flags, TexStats* stats);
+__declspec(dllexport) void decompress_dxt5_ex(const uint8_t* input, int width, int height, uint8_t* rgba, int flags, TexStats* stats);
+
+// Decodes count images in one parallel loop over the blocks of all of them, for many small
+// textures where a call per image costs more than the decoding. Every output matches
+// tex_decode_level_ex with the same flags. Returns TEX_OK, TEX_ERR_ARGS, TEX_ERR_FORMAT (no
+// job is decoded then) or TEX_ERR_NOMEM.
+__declspec(dllexport) int decompress_batch(const TexDecodeJob* jobs, int count, int flags, TexStats* stats);
+
+// Encodes rgba and every smaller mip level as the data section of a mipmapped DXT5 TEX file
+// (levels smallest first, sized tex_level_offset(header, 0) + tex_level_size of level 0).
+// Returns TEX_OK, TEX_ERR_ARGS or TEX_ERR_NOMEM.
+__declspec(dllexport) int compress_dxt5_mips_ex(const uint8_t* rgba, int width, int height, uint8_t* output, int flags, TexStats* stats);
+
+// Software prefetch distance of the whole image drivers in blocks (0 = off, at most 256).
+// Set returns TEX_OK or TEX_ERR_ARGS. Autotune measures this machine once per process, sets
+// the distance it picked and returns it (later calls return it without measuring), or returns
+// TEX_ERR_NOMEM.
+__declspec(dllexport) int tex_set_prefetch_distance(int blocks);
+__declspec(dllexport) int tex_get_prefetch_distance(void);
+__declspec(dllexport) int tex_autotune_prefetch(void);
+
+// TEX file layout helpers (tex_file.cpp)
+__declspec(dllexport) int tex_mipmap_count(int width, int height);
+__declspec(dllexport) long long tex_level_size(int format, int width, int height);
+__declspec(dllexport) int tex_decode_level(int format, const uint8_t* data, int width, int height, uint8_t* rgba);
+__declspec(dllexport) int tex_decode_level_ex(int format, const uint8_t* data, int width, int height, uint8_t* rgba, int flags, TexStats* stats);
+__declspec(dllexport) void tex_swizzle_bgra(const uint8_t* src, uint8_t* dst, long long pixel_count);
+
+// Mip levels (tex_mip.cpp). dst receives the max(width / 2, 1) x max(height / 2, 1) level below
+// src, 4 channels in either order.
+__declspec(dllexport) void tex_downsample_mip(const uint8_t* src, int width, int height, uint8_t* dst);
+
+// In place: every pixel with alpha 0 takes the RGB of the nearest pixel with alpha within radius
+// pixels (0 picks 16, at most 1024), or the mean visible color when none is that close. Alpha is
+// left alone. Returns TEX_OK, TEX_ERR_ARGS or TEX_ERR_NOMEM.
+__declspec(dllexport) int tex_alpha_bleed(uint8_t* rgba, int width, int height, int radius);
+
+// Predicts the zstd (level 3) compressed size of a whole TEX file (header included) without
+// compressing it; tex_size_check measures the accuracy. Returns TEX_OK, TEX_ERR_FORMAT for a bad or truncated file, TEX_ERR_ARGS or TEX_ERR_NOMEM.
+__declspec(dllexport) int tex_estimate_compressed_size(const uint8_t* tex, long long size, TexSizeEstimate* estimate);
+
+// Allocation tracking (tex_alloc.cpp). Only switch allocators while the library holds no buffers;
+// NULL restores the default aligned malloc. Reset sets the peak to the current usage and
+// clears the totals and counts.
+__declspec(dllexport) void tex_set_allocator(const TexAllocator* allocator);
+__declspec(dllexport) void tex_get_alloc_stats(TexAllocStats* stats);
+__declspec(dllexport) void tex_reset_alloc_stats(void);
+
+// Back default allocator buffers of at least min_bytes (never less than 2 MB) with huge pages.
+// Falls back to regular pages when the system has none to give. Returns TEX_OK or TEX_ERR_ARGS.
+__declspec(dllexport) int tex_set_huge_pages(int mode, long long min_bytes);
+
+// Thumbnail cache (tex_thumbnail_cache.cpp)
+__declspec(dllexport) void* tex_thumbcache_open(const char* cache_path, int slot_count, long long data_capacity, int writable);
+__declspec(dllexport) void tex_thumbcache_close(void* cache);
+__declspec(dllexport) int tex_thumbnail(void* cache, const char* tex_path, int max_dim, uint8_t* rgba, int* out_width, int* out_height);
+
+} // extern "C"
+
+// TEX file header as stored on disk (12 bytes)
+struct TexHeader {
+    int width;
+    int height;
+    int format;
+    bool mipmaps;
+};
+
+// Parse the 12 byte header, returns TEX_OK or TEX_ERR_FORMAT
+int tex_parse_header(const uint8_t* bytes, TexHeader* header);
+
+// BGRA8 pixels [begin, end) to RGBA, unpremultiplied when asked (tex_file.cpp)
+void tex_bgra8_to_rgba_span(const uint8_t* src, uint8_t* dst, long long begin, long long end, bool unpremultiply);
+
+// tex_alpha_bleed with the vector (AVX2) flood pass on or off; both must give the same bytes
+// (tex_mip.cpp)
+int tex_alpha_bleed_variant(uint8_t* rgba, int width, int height, int radius, bool vector);
+
+// Distinct RGB colors of a 16 pixel RGBA block and their pixel counts, as the few color encoder
+// finds them: returns up to 4, or 5 for more. vector picks the SSE2 comparisons over the
+// scalar loop; both must give the same answer (dxt_compress.cpp)
+int tex_block_distinct_colors(const uint8_t* block_rgba, uint32_t colors[4], int counts[4], bool vector);
+
+// Byte offset of mip level `level` (0 = full size) inside the data section.
+// Levels are stored smallest first, so the full size image is last.
+long long tex_level_offset(const TexHeader& header, int level);
+
+// Compile time description of every TEX pixel format. The codec drivers, level sizes and
+// stats are generic over these fields, so a new format is a registry entry plus its kernels.
+struct TexCodecDescriptor {
+    int format;          // TEX_FORMAT_* code stored in the header
+    const char* name;
+    int block_dim;       // pixels per block side, 1 for uncompressed formats
+    int block_bytes;
+    int channels;        // stored channels (DXT1 keeps a 1 bit alpha)
+    int color_offset;    // byte offset of the 565 color endpoints inside a block, -1 if none
+    bool alpha_block;    // blocks start with an interpolated alpha block
+    bool can_encode;     // the library has an encoder for it
+};
+
+constexpr TexCodecDescriptor TEX_CODECS[] = {
+    {TEX_FORMAT_DXT1, "DXT1", 4, 8, 4, 0, false, false},
+    {TEX_FORMAT_DXT5, "DXT5", 4, 16, 4, 8, true, true},
+    {TEX_FORMAT_BGRA8, "BGRA8", 1, 4, 4, -1, false, false},
+};
+
+// Registry entry for a TEX_FORMAT_* code, NULL for unknown formats
+constexpr const TexCodecDescriptor* tex_find_codec(int format) {
+    for (const TexCodecDescriptor& codec : TEX_CODECS) {
+        if (codec.format == format) {
+            return &codec;
+        }
+    }
+    return nullptr;
+}
+
+typedef void (*DxtEncodeBlockFn)(const uint8_t* rgba, int x, int y, int width, int height, uint8_t* output);
+typedef void (*DxtDecodeBlockFn)(const uint8_t* input, int x, int y, int width, int height, uint8_t* rgba);
+
+// One entry per ISA specific build of the block kernels (dxt_compress.cpp). Entry 0 is the
+// scalar reference every other variant must match byte for byte; add new variants there.
+struct DxtKernelVariant {
+    const char* isa;
+    bool (*supported)();
+    DxtEncodeBlockFn compress_dxt5_block;
+    DxtDecodeBlockFn decompress_dxt1_block;
+    DxtDecodeBlockFn decompress_dxt5_block;
+};
+
+extern const DxtKernelVariant DXT_KERNEL_VARIANTS[];
+extern const int DXT_KERNEL_VARIANT_COUNT;
+
+// Exact round(c * a / 255) for 8 bit c and a
+inline uint8_t tex_premultiply_channel(int c, int a) {
+    int t = c * a + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+// 2^24 / a rounded up: (n * reciprocal[a]) >> 24 == n / a for every n up to 255 * 255 + 127,
+// so unpremultiplying needs no division in the pixel loops (dxt_compress.cpp)
+struct TexUnpremultiplyTable {
+    uint64_t reciprocal[256];
+    constexpr TexUnpremultiplyTable() : reciprocal() {
+        for (int a = 1; a < 256; a++) {
+            reciprocal[a] = ((1u << 24) + a - 1) / a;
+        }
+    }
+};
+extern const TexUnpremultiplyTable TEX_UNPREMULTIPLY;
+
+// Exact round(c * 255 / a), clamped for colors the codec left above their alpha; 0 when a is 0.
+// tex_premultiply_channel(tex_unpremultiply_channel(c, a), a) == c whenever c <= a, so
+// premultiplied data survives any number of decode / encode round trips unchanged.
+inline uint8_t tex_unpremultiply_channel(int c, int a) {
+    uint64_t q = ((uint64_t)(c * 255 + (a >> 1)) * TEX_UNPREMULTIPLY.reciprocal[a]) >> 24;
+    return (uint8_t)(q < 255 ? q : 255);
+}
+
+// Library internal allocation through the installed allocator (tex_alloc.cpp).
+// Zero sized requests still return a unique pointer.
+void* tex_alloc(size_t size);
+void tex_free(void* ptr, size_t size);
+
+// Owning buffer from tex_alloc, the library's replacement for std::vector<uint8_t> scratch
+class TexBuffer {
+public:
+    TexBuffer() = default;
+    explicit TexBuffer(size_t size) : data_((uint8_t*)tex_alloc(size)), size_(data_ ? size : 0) {}
+    ~TexBuffer() { tex_free(data_, size_); }
+    TexBuffer(const TexBuffer&) = delete;
+    TexBuffer& operator=(const TexBuffer&) = delete;
+    TexBuffer(TexBuffer&& other) noexcept : data_(other.data_), size_(other.size_) { other.data_ = nullptr; other.size_ = 0; }
+    TexBuffer& operator=(TexBuffer&& other) noexcept {
+        if (this != &other) {
+            tex_free(data_, size_);
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    // False when the allocation failed
+    bool ok() const { return data_ != nullptr; }
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Adds one call's statistics to a running total (sums, except threads and peak scratch
+// which keep the maximum)
+inline void tex_stats_accumulate(TexStats& total, const TexStats& call) {
+    total.total_ms += call.total_ms;
+    total.setup_ms += call.setup_ms;
+    total.blocks_ms += call.blocks_ms;
+    total.blocks_uniform += call.blocks_uniform;
+    total.blocks_fast += call.blocks_fast;
+    total.blocks_refined += call.blocks_refined;
+    total.blocks_edge += call.blocks_edge;
+    total.threads = total.threads > call.threads ? total.threads : call.threads;
+    total.bytes_read += call.bytes_read;
+    total.bytes_written += call.bytes_written;
+    total.peak_scratch_bytes = total.peak_scratch_bytes > call.peak_scratch_bytes ? total.peak_scratch_bytes : call.peak_scratch_bytes;
+    total.refine_steps += call.refine_steps;
+}
+
+#endif // DXT_COMPRESS_H
@@ -0,0 +1,780 @@
+/*
+Differential fuzzer for the DXT kernels and codec entry points
+
+The whole image entry points are checked against the scalar block kernels (variant 0) on the
+same input, and every flag path against the plain path on an input prepared the same way:
+  TEX_FLAG_BGRA_PIXELS     same output as RGBA on the swizzled image (and swizzled back on decode)
+  TEX_FLAG_PREMULTIPLIED   same as encoding the premultiplied image / unpremultiplying the decode
+  TEX_FLAG_ALPHA_BLEED     same as encoding the tex_alpha_bleed copy
+  TEX_FLAG_REFINE          (also NEIGHBOUR_SEEDED and MIP_SEEDED) alpha identical to the fast path,
+                           every color index the nearest entry of the bit replicated palette,
+                           and the same output on 1 thread as on all of them
+  compress_dxt5_mips_ex    every level the same as encoding the tex_downsample_mip level alone
+  decompress_batch         every job the same as tex_decode_level_ex on it
+Any byte that differs aborts with a description of the failing case.
+
+The library's compile time SIMD paths are held to scalar code in the same binary:
+  tex_alpha_bleed          byte identical with the AVX2 flood pass on and off, at several radii
+                           and on a tiled enlargement that crosses bleed tiles
+  few color counting       the same colors and counts from the SSE2 and scalar loops on every
+                           block, and on blocks remapped to 1 - 5 colors
+  tex_swizzle_bgra         the same as a byte swap loop, in place and out of place
+Built without AVX2 or SSE2 both sides run the scalar code, so those checks pass trivially;
+the startup line says which vector paths the build has. DXT_KERNEL_VARIANTS entries past the
+scalar entry 0 are compared against it block by block.
+
+An input is: u8 width selector, u8 height selector, then payload bytes. Width and height
+are 1..64, so partial edge blocks are common. The payload is repeated to fill the RGBA
+image for encoding and, from different offsets, the DXT1 and DXT5 block streams for decoding.
+
+Offline (default build): checks that solid blocks through the refined encoder decode at the
+smallest error a standard BC1 palette allows, then runs every file of the given corpus folders
+and random inputs.
+  Compile with: g++ -O2 -march=native -fopenmp -o dxt_fuzz.exe dxt_fuzz.cpp dxt_compress.cpp tex_file.cpp tex_mip.cpp tex_trace.cpp tex_alloc.cpp
+  Usage: dxt_fuzz [corpus_dir_or_file ...] [--runs N] [--seed N] [--max-len N] [--write-seeds dir]
+libFuzzer: clang++ -g -O1 -fsanitize=fuzzer,address -DDXT_FUZZ_LIBFUZZER dxt_fuzz.cpp <library sources>
+  then run: ./dxt_fuzz fuzz_corpus
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "dxt_compress.h"
+
+namespace fs = std::filesystem;
+
+static const int MAX_DIM = 64;
+
+struct FuzzCase {
+    int width;
+    int height;
+    std::vector<uint8_t> rgba;
+    std::vector<uint8_t> dxt1;
+    std::vector<uint8_t> dxt5;
+};
+
+static void fill_repeating(const uint8_t* payload, size_t payload_size, size_t offset, std::vector<uint8_t>& out) {
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = payload_size ? payload[(offset + i) % payload_size] : 0;
+    }
+}
+
+static FuzzCase make_case(const uint8_t* data, size_t size) {
+    FuzzCase c;
+    c.width = 1 + (size > 0 ? data[0] : 0) % MAX_DIM;
+    c.height = 1 + (size > 1 ? data[1] : 0) % MAX_DIM;
+    const uint8_t* payload = data + std::min<size_t>(size, 2);
+    size_t payload_size = size > 2 ? size - 2 : 0;
+
+    size_t blocks = (size_t)((c.width + 3) / 4) * ((c.height + 3) / 4);
+    c.rgba.resize((size_t)c.width * c.height * 4);
+    c.dxt1.resize(blocks * 8);
+    c.dxt5.resize(blocks * 16);
+    fill_repeating(payload, payload_size, 0, c.rgba);
+    fill_repeating(payload, payload_size, 1, c.dxt1);
+    fill_repeating(payload, payload_size, 3, c.dxt5);
+    return c;
+}
+
+static void encode_blocks(DxtEncodeBlockFn fn, const FuzzCase& c, std::vector<uint8_t>& out) {
+    int block_width = (c.width + 3) / 4;
+    int block_height = (c.height + 3) / 4;
+    out.assign((size_t)block_width * block_height * 16, 0xCD);
+    for (int by = 0; by < block_height; by++) {
+        for (int bx = 0; bx < block_width; bx++) {
+            fn(c.rgba.data(), bx * 4, by * 4, c.width, c.height, &out[((size_t)by * block_width + bx) * 16]);
+        }
+    }
+}
+
+// The drivers clear their output first, so the block loops start from zero as well
+static void decode_blocks(DxtDecodeBlockFn fn, const std::vector<uint8_t>& blocks, int block_bytes, const FuzzCase& c,
+                          std::vector<uint8_t>& out) {
+    int block_width = (c.width + 3) / 4;
+    int block_height = (c.height + 3) / 4;
+    out.assign((size_t)c.width * c.height * 4, 0);
+    for (int by = 0; by < block_height; by++) {
+        for (int bx = 0; bx < block_width; bx++) {
+            fn(&blocks[((size_t)by * block_width + bx) * block_bytes], bx * 4, by * 4, c.width, c.height, out.data());
+        }
+    }
+}
+
+static void check_same(const char* what, const char* isa, const FuzzCase& c, const std::vector<uint8_t>& expected,
+                       const std::vector<uint8_t>& actual, bool blocks_output) {
+    if (expected == actual) {
+        return;
+    }
+    size_t i = 0;
+    while (i < expected.size() && i < actual.size() && expected[i] == actual[i]) {
+        i++;
+    }
+    int block_width = (c.width + 3) / 4;
+    int bx, by;
+    if (blocks_output) {
+        bx = (int)(i / 16) % block_width;
+        by = (int)(i / 16) / block_width;
+    } else {
+        bx = (int)(i / 4) % c.width / 4;
+        by = (int)(i / 4) / c.width / 4;
+    }
+    fprintf(stderr, "MISMATCH %s [%s] %dx%d: byte %zu (block %d,%d) expected %d got %d\n", what, isa, c.width, c.height, i,
+            bx, by, i < expected.size() ? expected[i] : -1, i < actual.size() ? actual[i] : -1);
+    abort();
+}
+
+// ============================================================================
+// Flag paths
+// ============================================================================
+
+// 565 field to 8 bits with bit replication, as GPUs and standard BC1/BC3 decoders expand it
+static int replicate_field(int field, int bits) {
+    return (field << (8 - bits)) | (field >> (2 * bits - 8));
+}
+
+static std::vector<uint8_t> swizzled(const std::vector<uint8_t>& pixels) {
+    std::vector<uint8_t> out(pixels);
+    for (size_t i = 0; i + 3 < out.size(); i += 4) {
+        std::swap(out[i], out[i + 2]);
+    }
+    return out;
+}
+
+static std::vector<uint8_t> premultiplied(const std::vector<uint8_t>& rgba) {
+    std::vector<uint8_t> out(rgba);
+    for (size_t i = 0; i + 3 < out.size(); i += 4) {
+        for (int c = 0; c < 3; c++) {
+            out[i + c] = tex_premultiply_channel(out[i + c], out[i + 3]);
+        }
+    }
+    return out;
+}
+
+static std::vector<uint8_t> unpremultiplied(const std::vector<uint8_t>& rgba) {
+    std::vector<uint8_t> out(rgba);
+    for (size_t i = 0; i + 3 < out.size(); i += 4) {
+        for (int c = 0; c < 3; c++) {
+            out[i + c] = tex_unpremultiply_channel(out[i + c], out[i + 3]);
+        }
+    }
+    return out;
+}
+
+// ============================================================================
+// Vector paths against their scalar code
+// ============================================================================
+
+static void check_alpha_bleed_paths(const FuzzCase& c) {
+    char what[96];
+    // Random payloads rarely hold alpha 0, so also cut the alpha to 0 / 255 at 128
+    std::vector<uint8_t> cut(c.rgba);
+    for (size_t i = 3; i < cut.size(); i += 4) {
+        cut[i] = cut[i] < 128 ? 0 : 255;
+    }
+    // 4 x 3 copies of the cut image: up to 256 x 192, so several bleed tiles
+    int big_width = c.width * 4;
+    int big_height = c.height * 3;
+    std::vector<uint8_t> big((size_t)big_width * big_height * 4);
+    for (int y = 0; y < big_height; y++) {
+        for (int x = 0; x < big_width; x++) {
+            memcpy(&big[((size_t)y * big_width + x) * 4], &cut[((size_t)(y % c.height) * c.width + x % c.width) * 4], 4);
+        }
+    }
+
+    struct Image {
+        const std::vector<uint8_t>* pixels;
+        int width, height;
+    };
+    const Image images[] = {{&c.rgba, c.width, c.height}, {&cut, c.width, c.height}, {&big, big_width, big_height}};
+    static const int RADII[] = {0, 1, 3, 40};
+    for (const Image& image : images) {
+        for (int radius : RADII) {
+            std::vector<uint8_t> vector(*image.pixels), scalar(*image.pixels);
+            int vector_status = tex_alpha_bleed_variant(vector.data(), image.width, image.height, radius, true);
+            int scalar_status = tex_alpha_bleed_variant(scalar.data(), image.width, image.height, radius, false);
+            snprintf(what, sizeof(what), "tex_alpha_bleed %dx%d radius %d", image.width, image.height, radius);
+            if (vector_status != TEX_OK || scalar_status != TEX_OK) {
+                fprintf(stderr, "FAILED %s: status %d / %d\n", what, vector_status, scalar_status);
+                abort();
+            }
+            check_same(what, "vector", c, scalar, vector, false);
+        }
+    }
+}
+
+static void check_block_colors(const char* what, const FuzzCase& c, const uint8_t* block) {
+    uint32_t vector_colors[4] = {}, scalar_colors[4] = {};
+    int vector_counts[4] = {}, scalar_counts[4] = {};
+    int vector_count = tex_block_distinct_colors(block, vector_colors, vector_counts, true);
+    int scalar_count = tex_block_distinct_colors(block, scalar_colors, scalar_counts, false);
+    if (vector_count != scalar_count || memcmp(vector_colors, scalar_colors, sizeof(vector_colors)) != 0 ||
+        memcmp(vector_counts, scalar_counts, sizeof(vector_counts)) != 0) {
+        fprintf(stderr, "MISMATCH %s %dx%d: %d colors (vector) against %d (scalar)\n", what, c.width, c.height, vector_count,
+                scalar_count);
+        abort();
+    }
+}
+
+static void check_block_color_paths(const FuzzCase& c) {
+    int block_width = (c.width + 3) / 4;
+    int block_height = (c.height + 3) / 4;
+    uint8_t block[64], few[64];
+    for (int by = 0; by < block_height; by++) {
+        for (int bx = 0; bx < block_width; bx++) {
+            for (int i = 0; i < 16; i++) {
+                int x = std::min(bx * 4 + (i & 3), c.width - 1);
+                int y = std::min(by * 4 + (i >> 2), c.height - 1);
+                memcpy(block + i * 4, &c.rgba[((size_t)y * c.width + x) * 4], 4);
+            }
+            check_block_colors("block_distinct_colors", c, block);
+            // The same block on 1 - 5 of its own colors, picked by its bytes; alpha varies freely
+            int palette_size = 1 + (block[0] + bx + by) % 5;
+            for (int i = 0; i < 16; i++) {
+                int entry = block[i * 4 + 1] % palette_size;
+                memcpy(few + i * 4, block + entry * 4, 3);
+                few[i * 4 + 3] = block[i * 4 + 3];
+            }
+            check_block_colors("block_distinct_colors few", c, few);
+        }
+    }
+}
+
+static void check_swizzle_paths(const FuzzCase& c) {
+    long long pixels = (long long)c.width * c.height;
+    std::vector<uint8_t> expected = swizzled(c.rgba);
+    std::vector<uint8_t> got(c.rgba.size(), 0xCD);
+    tex_swizzle_bgra(c.rgba.data(), got.data(), pixels);
+    check_same("tex_swizzle_bgra", "vector", c, expected, got, false);
+    got = c.rgba;
+    tex_swizzle_bgra(got.data(), got.data(), pixels);
+    check_same("tex_swizzle_bgra in place", "vector", c, expected, got, false);
+}
+
+// The straight alpha RGBA image an encode with these flags works from: bled unless the data is
+// premultiplied, which skips bleeding
+static std::vector<uint8_t> encode_source(const std::vector<uint8_t>& rgba, int width, int height, int flags) {
+    std::vector<uint8_t> out(rgba);
+    if ((flags & TEX_FLAG_ALPHA_BLEED) && !(flags & TEX_FLAG_PREMULTIPLIED)) {
+        tex_alpha_bleed(out.data(), width, height, 0);
+    }
+    return out;
+}
+
+static std::vector<uint8_t> encode(const std::vector<uint8_t>& pixels, int width, int height, int flags) {
+    std::vector<uint8_t> out((size_t)tex_level_size(TEX_FORMAT_DXT5, width, height), 0xCD);
+    compress_dxt5_ex(pixels.data(), width, height, out.data(), flags, nullptr);
+    return out;
+}
+
+// Every pixel of a refined block, staged as the encoder saw it (colors, transparent black
+// outside the image), must sit on an entry of the bit replicated palette nearest to it
+static void check_nearest_indices(const char* what, const FuzzCase& c, const std::vector<uint8_t>& staged, int width, int height,
+                                  const uint8_t* blocks) {
+    int block_width = (width + 3) / 4;
+    int block_height = (height + 3) / 4;
+    for (int by = 0; by < block_height; by++) {
+        for (int bx = 0; bx < block_width; bx++) {
+            const uint8_t* block = blocks + ((size_t)by * block_width + bx) * 16;
+            int palette[4][3];
+            for (int e = 0; e < 2; e++) {
+                uint16_t color = (uint16_t)(block[8 + e * 2] | (block[9 + e * 2] << 8));
+                palette[e][0] = replicate_field(color >> 11, 5);
+                palette[e][1] = replicate_field((color >> 5) & 0x3F, 6);
+                palette[e][2] = replicate_field(color & 0x1F, 5);
+            }
+            for (int ch = 0; ch < 3; ch++) {
+                palette[2][ch] = (2 * palette[0][ch] + palette[1][ch]) / 3;
+                palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch]) / 3;
+            }
+            for (int i = 0; i < 16; i++) {
+                int x = bx * 4 + (i & 3);
+                int y = by * 4 + (i >> 2);
+                int pixel[3] = {0, 0, 0};
+                if (x < width && y < height) {
+                    for (int ch = 0; ch < 3; ch++) {
+                        pixel[ch] = staged[((size_t)y * width + x) * 4 + ch];
+                    }
+                }
+                int errors[4];
+                for (int e = 0; e < 4; e++) {
+                    errors[e] = 0;
+                    for (int ch = 0; ch < 3; ch++) {
+                        errors[e] += (pixel[ch] - palette[e][ch]) * (pixel[ch] - palette[e][ch]);
+                    }
+                }
+                int index = (block[12 + i / 4] >> ((i % 4) * 2)) & 3;
+                if (errors[index] != *std::min_element(errors, errors + 4)) {
+                    fprintf(stderr, "MISMATCH %s %dx%d (level %dx%d): block %d,%d pixel %d uses entry %d at error %d, nearest is %d\n", what,
+                            c.width, c.height, width, height, bx, by, i, index, errors[index], *std::min_element(errors, errors + 4));
+                    abort();
+                }
+            }
+        }
+    }
+}
+
+// Alpha halves of every block must match: the refined paths only change the color half
+static void check_same_alpha(const char* what, const FuzzCase& c, const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual) {
+    std::vector<uint8_t> a(expected), b(actual);
+    for (size_t i = 0; i + 16 <= a.size() && i + 16 <= b.size(); i += 16) {
+        memset(&a[i + 8], 0, 8);
+        memset(&b[i + 8], 0, 8);
+    }
+    check_same(what, "alpha", c, a, b, true);
+}
+
+static void set_threads(int threads) {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#else
+    (void)threads;
+#endif
+}
+
+static int max_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Refined output is checked on the staged colors of the image it was encoded from
+static void check_refined(const char* what, const FuzzCase& c, const std::vector<uint8_t>& source, int width, int height, int flags,
+                          const uint8_t* blocks) {
+    std::vector<uint8_t> staged = (flags & TEX_FLAG_PREMULTIPLIED) ? premultiplied(source) : source;
+    check_nearest_indices(what, c, staged, width, height, blocks);
+}
+
+static const int ENCODE_MODES[] = {0, TEX_FLAG_REFINE, TEX_FLAG_REFINE | TEX_FLAG_NEIGHBOUR_SEEDED};
+
+static void check_encode_flags(const FuzzCase& c) {
+    char what[96];
+    int threads = max_threads();
+    for (int mode : ENCODE_MODES) {
+        for (int extra = 0; extra < 8; extra++) {
+            int flags = mode | ((extra & 1) ? TEX_FLAG_PREMULTIPLIED : 0) | ((extra & 2) ? TEX_FLAG_BGRA_PIXELS : 0) |
+                        ((extra & 4) ? TEX_FLAG_ALPHA_BLEED : 0);
+            snprintf(what, sizeof(what), "compress_dxt5_ex flags %d", flags);
+
+            // Reference: the plain mode on the image prepared by hand
+            std::vector<uint8_t> source = encode_source(c.rgba, c.width, c.height, flags);
+            std::vector<uint8_t> prepared = (flags & TEX_FLAG_PREMULTIPLIED) ? premultiplied(source) : source;
+            std::vector<uint8_t> expected = encode(prepared, c.width, c.height, mode);
+
+            const std::vector<uint8_t>& input = (flags & TEX_FLAG_BGRA_PIXELS) ? swizzled(c.rgba) : c.rgba;
+            std::vector<uint8_t> got = encode(input, c.width, c.height, flags);
+            check_same(what, "flags", c, expected, got, true);
+
+            if (mode & TEX_FLAG_REFINE) {
+                check_refined(what, c, source, c.width, c.height, flags, got.data());
+                check_same_alpha(what, c, encode(prepared, c.width, c.height, 0), got);
+                set_threads(1);
+                std::vector<uint8_t> single = encode(input, c.width, c.height, flags);
+                set_threads(threads);
+                check_same(what, "1 thread", c, got, single, true);
+            }
+        }
+    }
+}
+
+static void check_decode_flags(const FuzzCase& c, const std::vector<uint8_t>& ref_rgba1, const std::vector<uint8_t>& ref_rgba5) {
+    char what[96];
+    std::vector<uint8_t> got(ref_rgba1.size());
+    for (int flags = 1; flags < 4; flags++) {
+        std::vector<uint8_t> expected1 = (flags & TEX_FLAG_PREMULTIPLIED) ? unpremultiplied(ref_rgba1) : ref_rgba1;
+        std::vector<uint8_t> expected5 = (flags & TEX_FLAG_PREMULTIPLIED) ? unpremultiplied(ref_rgba5) : ref_rgba5;
+        if (flags & TEX_FLAG_BGRA_PIXELS) {
+            expected1 = swizzled(expected1);
+            expected5 = swizzled(expected5);
+        }
+        snprintf(what, sizeof(what), "decompress_dxt1_ex flags %d", flags);
+        decompress_dxt1_ex(c.dxt1.data(), c.width, c.height, got.data(), flags, nullptr);
+        check_same(what, "flags", c, expected1, got, false);
+        snprintf(what, sizeof(what), "decompress_dxt5_ex flags %d", flags);
+        decompress_dxt5_ex(c.dxt5.data(), c.width, c.height, got.data(), flags, nullptr);
+        check_same(what, "flags", c, expected5, got, false);
+    }
+}
+
+// Whole chains against their levels encoded one by one; seeded refinement has no plain
+// counterpart and is held to the refined invariants instead
+static void check_mip_chain(const FuzzCase& c) {
+    char what[96];
+    int threads = max_threads();
+    int levels = tex_mipmap_count(c.width, c.height);
+    TexHeader header = {c.width, c.height, TEX_FORMAT_DXT5, true};
+    size_t chain_bytes = (size_t)(tex_level_offset(header, 0) + tex_level_size(TEX_FORMAT_DXT5, c.width, c.height));
+    static const int CHAIN_MODES[] = {0, TEX_FLAG_REFINE, TEX_FLAG_REFINE | TEX_FLAG_MIP_SEEDED};
+
+    for (int mode : CHAIN_MODES) {
+        for (int extra = 0; extra < 8; extra++) {
+            int flags = mode | ((extra & 1) ? TEX_FLAG_PREMULTIPLIED : 0) | ((extra & 2) ? TEX_FLAG_BGRA_PIXELS : 0) |
+                        ((extra & 4) ? TEX_FLAG_ALPHA_BLEED : 0);
+            snprintf(what, sizeof(what), "compress_dxt5_mips_ex flags %d", flags);
+
+            const std::vector<uint8_t>& input = (flags & TEX_FLAG_BGRA_PIXELS) ? swizzled(c.rgba) : c.rgba;
+            std::vector<uint8_t> got(chain_bytes, 0xCD);
+            if (compress_dxt5_mips_ex(input.data(), c.width, c.height, got.data(), flags, nullptr) != TEX_OK) {
+                fprintf(stderr, "FAILED %s %dx%d\n", what, c.width, c.height);
+                abort();
+            }
+
+            std::vector<uint8_t> level_source = encode_source(c.rgba, c.width, c.height, flags);
+            int level_flags = flags & (TEX_FLAG_PREMULTIPLIED | TEX_FLAG_REFINE);
+            for (int level = 0; level < levels; level++) {
+                int width = std::max(c.width >> level, 1);
+                int height = std::max(c.height >> level, 1);
+                if (level > 0) {
+                    std::vector<uint8_t> smaller((size_t)width * height * 4);
+                    tex_downsample_mip(level_source.data(), std::max(c.width >> (level - 1), 1), std::max(c.height >> (level - 1), 1),
+                                       smaller.data());
+                    level_source.swap(smaller);
+                }
+                size_t offset = (size_t)tex_level_offset(header, level);
+                std::vector<uint8_t> level_got(got.begin() + offset, got.begin() + offset + tex_level_size(TEX_FORMAT_DXT5, width, height));
+                if (flags & TEX_FLAG_MIP_SEEDED) {
+                    check_refined(what, c, level_source, width, height, flags, level_got.data());
+                } else {
+                    check_same(what, "level", c, encode(level_source, width, height, level_flags), level_got, true);
+                }
+            }
+
+            if (flags & TEX_FLAG_MIP_SEEDED) {
+                std::vector<uint8_t> single(chain_bytes, 0xCD);
+                set_threads(1);
+                compress_dxt5_mips_ex(input.data(), c.width, c.height, single.data(), flags, nullptr);
+                set_threads(threads);
+                check_same(what, "1 thread", c, got, single, true);
+            }
+        }
+    }
+}
+
+// One batch of every stream of the case, twice over with the sides swapped, against a
+// tex_decode_level_ex call per job
+static void check_batch(const FuzzCase& c) {
+    char what[96];
+    const std::vector<uint8_t>* streams[3] = {&c.dxt1, &c.dxt5, &c.rgba};
+    const int formats[3] = {TEX_FORMAT_DXT1, TEX_FORMAT_DXT5, TEX_FORMAT_BGRA8};
+    std::vector<std::vector<uint8_t>> outputs(6);
+    std::vector<TexDecodeJob> jobs(6);
+    for (int j = 0; j < 6; j++) {
+        // Swapping width and height keeps the level size, so the same stream fits both
+        int width = j < 3 ? c.width : c.height;
+        int height = j < 3 ? c.height : c.width;
+        outputs[j].assign((size_t)width * height * 4, 0xCD);
+        jobs[j] = TexDecodeJob{formats[j % 3], width, height, streams[j % 3]->data(), outputs[j].data()};
+    }
+    for (int flags = 0; flags < 4; flags++) {
+        snprintf(what, sizeof(what), "decompress_batch flags %d", flags);
+        if (decompress_batch(jobs.data(), (int)jobs.size(), flags, nullptr) != TEX_OK) {
+            fprintf(stderr, "FAILED %s %dx%d\n", what, c.width, c.height);
+            abort();
+        }
+        for (int j = 0; j < 6; j++) {
+            std::vector<uint8_t> expected(outputs[j].size(), 0xCD);
+            tex_decode_level_ex(jobs[j].format, jobs[j].input, jobs[j].width, jobs[j].height, expected.data(), flags, nullptr);
+            check_same(what, "batch", c, expected, outputs[j], false);
+        }
+    }
+}
+
+static void run_case(const uint8_t* data, size_t size) {
+    FuzzCase c = make_case(data, size);
+    const DxtKernelVariant& reference = DXT_KERNEL_VARIANTS[0];
+
+    std::vector<uint8_t> ref_dxt5, ref_rgba1, ref_rgba5, got;
+    encode_blocks(reference.compress_dxt5_block, c, ref_dxt5);
+    decode_blocks(reference.decompress_dxt1_block, c.dxt1, 8, c, ref_rgba1);
+    decode_blocks(reference.decompress_dxt5_block, c.dxt5, 16, c, ref_rgba5);
+
+    for (int v = 1; v < DXT_KERNEL_VARIANT_COUNT; v++) {
+        const DxtKernelVariant& variant = DXT_KERNEL_VARIANTS[v];
+        if (!variant.supported()) {
+            continue;
+        }
+        encode_blocks(variant.compress_dxt5_block, c, got);
+        check_same("compress_dxt5_block", variant.isa, c, ref_dxt5, got, true);
+        decode_blocks(variant.decompress_dxt1_block, c.dxt1, 8, c, got);
+        check_same("decompress_dxt1_block", variant.isa, c, ref_rgba1, got, false);
+        decode_blocks(variant.decompress_dxt5_block, c.dxt5, 16, c, got);
+        check_same("decompress_dxt5_block", variant.isa, c, ref_rgba5, got, false);
+    }
+
+    // Whole image entry points, whichever variant they dispatch to
+    got.assign(ref_dxt5.size(), 0xCD);
+    compress_dxt5(c.rgba.data(), c.width, c.height, got.data());
+    check_same("compress_dxt5", "driver", c, ref_dxt5, got, true);
+    got.assign(ref_rgba1.size(), 0xCD);
+    decompress_dxt1(c.dxt1.data(), c.width, c.height, got.data());
+    check_same("decompress_dxt1", "driver", c, ref_rgba1, got, false);
+    got.assign(ref_rgba5.size(), 0xCD);
+    decompress_dxt5(c.dxt5.data(), c.width, c.height, got.data());
+    check_same("decompress_dxt5", "driver", c, ref_rgba5, got, false);
+
+    check_alpha_bleed_paths(c);
+    check_block_color_paths(c);
+    check_swizzle_paths(c);
+    check_encode_flags(c);
+    check_decode_flags(c, ref_rgba1, ref_rgba5);
+    check_mip_chain(c);
+    check_batch(c);
+}
+
+// ============================================================================
+// Single color blocks on a standard decoder
+// ============================================================================
+
+// Smallest |entry - value| a channel of the given width can reach on palette entry 0 (the
+// endpoint itself) or entry 2 ((2 * e0 + e1) / 3 rounded down), over every field pair
+static int best_single_channel_error(int value, int bits, int entry) {
+    int best = 255;
+    for (int q0 = 0; q0 < (1 << bits); q0++) {
+        for (int q1 = 0; q1 < (1 << bits); q1++) {
+            int e0 = replicate_field(q0, bits);
+            int e1 = replicate_field(q1, bits);
+            int decoded = entry == 0 ? e0 : (2 * e0 + e1) / 3;
+            best = std::min(best, std::abs(decoded - value));
+        }
+    }
+    return best;
+}
+
+// Solid 4x4 blocks through the refined encoder, decoded with a standard BC1 palette. Every
+// block must come out at the smallest error the format allows; for the colors a palette entry
+// can hit exactly that is zero. Covers every value of every channel.
+static int check_single_color_blocks() {
+    static const int BITS[3] = {5, 6, 5};
+    std::vector<int> best[2][3];
+    for (int entry = 0; entry < 2; entry++) {
+        for (int c = 0; c < 3; c++) {
+            best[entry][c].resize(256);
+            for (int v = 0; v < 256; v++) {
+                best[entry][c][v] = best_single_channel_error(v, BITS[c], entry);
+            }
+        }
+    }
+
+    int exact = 0;
+    int colors = 0;
+    for (int v = 0; v < 256; v++) {
+        const uint8_t cases[3][3] = {
+            {(uint8_t)v, (uint8_t)v, (uint8_t)v},
+            {(uint8_t)v, (uint8_t)(v * 7 + 3), (uint8_t)(v * 13 + 5)},
+            {(uint8_t)(v * 29 + 17), (uint8_t)(255 - v), (uint8_t)v},
+        };
+        for (const uint8_t* rgb : cases) {
+            uint8_t rgba[16 * 4];
+            for (int i = 0; i < 16; i++) {
+                memcpy(rgba + i * 4, rgb, 3);
+                rgba[i * 4 + 3] = 255;
+            }
+            uint8_t block[16];
+            compress_dxt5_ex(rgba, 4, 4, block, TEX_FLAG_REFINE, nullptr);
+
+            uint16_t color0 = (uint16_t)(block[8] | (block[9] << 8));
+            uint16_t color1 = (uint16_t)(block[10] | (block[11] << 8));
+            int fields[2][3] = {{color0 >> 11, (color0 >> 5) & 0x3F, color0 & 0x1F}, {color1 >> 11, (color1 >> 5) & 0x3F, color1 & 0x1F}};
+            int error = 0;
+            for (int i = 0; i < 16; i++) {
+                int index = (block[12 + i / 4] >> ((i % 4) * 2)) & 3;
+                for (int c = 0; c < 3; c++) {
+                    int e0 = replicate_field(fields[0][c], BITS[c]);
+                    int e1 = replicate_field(fields[1][c], BITS[c]);
+                    int palette[4] = {e0, e1, (2 * e0 + e1) / 3, (e0 + 2 * e1) / 3};
+                    int d = palette[index] - rgb[c];
+                    error += d * d;
+                }
+            }
+
+            int optimum = INT32_MAX;
+            for (int entry = 0; entry < 2; entry++) {
+                int sum = 0;
+                for (int c = 0; c < 3; c++) {
+                    sum += best[entry][c][rgb[c]] * best[entry][c][rgb[c]];
+                }
+                optimum = std::min(optimum, 16 * sum);
+            }
+            if (error != optimum) {
+                fprintf(stderr, "MISMATCH single color (%d, %d, %d): squared error %d on a standard decoder, best possible %d\n", rgb[0],
+                        rgb[1], rgb[2], error, optimum);
+                abort();
+            }
+            exact += error == 0;
+            colors++;
+        }
+    }
+    return exact;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    run_case(data, size);
+    return 0;
+}
+
+#ifndef DXT_FUZZ_LIBFUZZER
+
+static uint64_t next_random(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static bool read_file(const fs::path& path, std::vector<uint8_t>& bytes) {
+    FILE* f = fopen(path.string().c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    std::error_code ec;
+    uintmax_t size = fs::file_size(path, ec);
+    bytes.resize(ec ? 0 : (size_t)size);
+    bool ok = !ec && fread(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    fclose(f);
+    return ok;
+}
+
+// Hand picked starting points: solid and two color blocks, both DXT1 palette modes, both
+// DXT5 alpha modes, and sizes that leave partial blocks on either edge
+static int write_seeds(const fs::path& dir) {
+    struct Seed {
+        const char* name;
+        int width;
+        int height;
+        std::vector<uint8_t> payload;
+    };
+    std::vector<Seed> seeds = {
+        {"solid_4x4", 4, 4, {200, 100, 50, 255}},
+        {"transparent_8x8", 8, 8, {0, 0, 0, 0}},
+        {"two_colors_8x4", 8, 4, {255, 0, 0, 255, 0, 0, 255, 255}},
+        {"edge_1x1", 1, 1, {10, 20, 30, 40}},
+        {"edge_3x5", 3, 5, {1, 2, 3, 4, 250, 251, 252, 253, 7}},
+        {"edge_13x7", 13, 7, {}},
+        {"dxt1_three_color_mode", 8, 8, {}},
+        {"dxt5_six_alpha_mode", 8, 8, {}},
+        {"gradient_33x17", 33, 17, {}},
+    };
+    for (int i = 0; i < 256; i++) {
+        seeds[5].payload.push_back((uint8_t)(i * 37 + 11));
+        seeds[8].payload.push_back((uint8_t)i);
+    }
+    // Payload offset 1 is the DXT1 stream: color0 <= color1 selects the 3 color + transparent palette
+    seeds[6].payload = {0, 0x10, 0x00, 0xF8, 0xFF, 0xE4, 0x1B, 0xB1};
+    // Payload offset 3 is the DXT5 stream: alpha0 <= alpha1 selects 4 interpolants plus 0 and 255
+    seeds[7].payload = {0, 0, 0, 20, 220, 0x88, 0xC6, 0xFA, 0x05, 0x39, 0x77, 0x1F, 0x00, 0xF8, 0x07, 0x4E, 0x93, 0xD8};
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    for (const Seed& seed : seeds) {
+        std::vector<uint8_t> bytes = {(uint8_t)(seed.width - 1), (uint8_t)(seed.height - 1)};
+        bytes.insert(bytes.end(), seed.payload.begin(), seed.payload.end());
+        FILE* f = fopen((dir / seed.name).string().c_str(), "wb");
+        if (!f || fwrite(bytes.data(), 1, bytes.size(), f) != bytes.size()) {
+            fprintf(stderr, "ERROR: cannot write %s\n", (dir / seed.name).string().c_str());
+            if (f) {
+                fclose(f);
+            }
+            return 1;
+        }
+        fclose(f);
+    }
+    printf("Wrote %zu seeds to %s\n", seeds.size(), dir.string().c_str());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::vector<fs::path> corpus;
+    long long runs = 10000;
+    uint64_t seed = 1;
+    size_t max_len = 2 + MAX_DIM * MAX_DIM * 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = std::max(0LL, atoll(argv[++i]));
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--max-len") == 0 && i + 1 < argc) {
+            max_len = (size_t)std::max(2, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--write-seeds") == 0 && i + 1 < argc) {
+            return write_seeds(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [corpus_dir_or_file ...] [--runs N] [--seed N] [--max-len N] [--write-seeds dir]\n", argv[0]);
+            return 1;
+        } else {
+            corpus.push_back(argv[i]);
+        }
+    }
+
+    printf("Variants:");
+    for (int v = 0; v < DXT_KERNEL_VARIANT_COUNT; v++) {
+        printf(" %s%s", DXT_KERNEL_VARIANTS[v].isa, DXT_KERNEL_VARIANTS[v].supported() ? "" : " (unsupported)");
+    }
+    printf("\n");
+    // The library is built with the same flags as this file, so these say which paths it has
+    printf("Vector paths checked against scalar: alpha bleed flood %s, few color counting %s, swizzle %s\n",
+#ifdef __AVX2__
+           "AVX2", "SSE2", "AVX2");
+#elif defined(__SSSE3__)
+           "none", "SSE2", "SSSE3");
+#elif defined(__SSE2__)
+           "none", "SSE2", "none");
+#else
+           "none", "none", "none");
+#endif
+
+    int exact = check_single_color_blocks();
+    printf("Single color blocks: all at the best error a standard decoder allows, %d of 768 exact\n", exact);
+
+    int files = 0;
+    std::vector<uint8_t> bytes;
+    for (const fs::path& path : corpus) {
+        std::vector<fs::path> paths;
+        std::error_code ec;
+        if (fs::is_directory(path, ec)) {
+            for (const auto& entry : fs::directory_iterator(path, ec)) {
+                if (entry.is_regular_file()) {
+                    paths.push_back(entry.path());
+                }
+            }
+            std::sort(paths.begin(), paths.end());
+        } else {
+            paths.push_back(path);
+        }
+        for (const fs::path& file : paths) {
+            if (!read_file(file, bytes)) {
+                fprintf(stderr, "ERROR: cannot read %s\n", file.string().c_str());
+                return 1;
+            }
+            run_case(bytes.data(), bytes.size());
+            files++;
+        }
+    }
+
+    // Random inputs: mostly short payloads, which repeat into structured blocks
+    uint64_t state = seed;
+    for (long long r = 0; r < runs; r++) {
+        uint64_t length_pick = next_random(state);
+        size_t length = (length_pick & 3) ? 2 + (size_t)(length_pick >> 8) % 64 : (size_t)(length_pick >> 8) % (max_len + 1);
+        bytes.resize(length);
+        for (size_t i = 0; i < length; i++) {
+            bytes[i] = (uint8_t)next_random(state);
+        }
+        run_case(bytes.data(), bytes.size());
+    }
+
+    printf("OK: %d corpus files and %lld random inputs passed every check\n", files, runs);
+    return 0;
+}
+
+#endif // DXT_FUZZ_LIBFUZZER
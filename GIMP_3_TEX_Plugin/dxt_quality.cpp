@@ -0,0 +1,230 @@
+/*
+Quality versus speed report for the DXT5 encoder modes
+
+Runs every encoder mode over the synthetic corpus, decodes the result and compares it with
+the source (RGB PSNR, alpha PSNR, luma SSIM). Scores come from a standard BC3 decode with bit
+replicated endpoints, as on a GPU; the RGB PSNR of the plugin's own decoder, which GIMP shows
+on load, is reported next to it. Prints one summary row per mode and thread count with its
+position on the speed/quality Pareto front, and writes per image rows with --csv for charts.
+
+Built with -DDXT_REFERENCE_ENCODERS (and reference_encoders.cpp) the stb_dxt style reference
+encoder runs alongside our modes as a yardstick. The cluster fit reference is a hundred times
+slower (around 100 us per block, a third of a second for one 256x256 image on one core) and
+only runs with --cluster.
+
+Compile with: g++ -O3 -march=native -fopenmp -DDXT_REFERENCE_ENCODERS -o dxt_quality.exe dxt_quality.cpp reference_encoders.cpp tex_metrics.cpp tex_corpus.cpp dxt_compress.cpp tex_file.cpp tex_mip.cpp tex_trace.cpp tex_alloc.cpp
+Usage: dxt_quality [--sizes 256,1024] [--seeds N] [--reps N] [--threads 1,8] [--cluster] [--csv file]
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "dxt_compress.h"
+#include "tex_corpus.h"
+#include "tex_metrics.h"
+
+#ifdef DXT_REFERENCE_ENCODERS
+#include "reference_encoders.h"
+#endif
+
+typedef void (*EncodeImageFn)(const uint8_t* rgba, int width, int height, uint8_t* output);
+
+// Every DXT5 encoder mode the library offers; new modes are added here. Reference
+// encoders are not ours and are marked so the summary keeps them apart; slow ones only run
+// when asked for
+struct EncoderMode {
+    const char* name;
+    EncodeImageFn encode;
+    bool reference;
+    bool slow;
+};
+
+// Refinement started from each block's own endpoints, and also seeded from the neighbours'
+static void compress_dxt5_refined(const uint8_t* rgba, int width, int height, uint8_t* output) {
+    compress_dxt5_ex(rgba, width, height, output, TEX_FLAG_REFINE, nullptr);
+}
+
+static void compress_dxt5_refined_seeded(const uint8_t* rgba, int width, int height, uint8_t* output) {
+    compress_dxt5_ex(rgba, width, height, output, TEX_FLAG_REFINE | TEX_FLAG_NEIGHBOUR_SEEDED, nullptr);
+}
+
+static const EncoderMode ENCODER_MODES[] = {
+    {"fast", compress_dxt5, false, false},
+    {"refine", compress_dxt5_refined, false, false},
+    {"refine-seeded", compress_dxt5_refined_seeded, false, false},
+#ifdef DXT_REFERENCE_ENCODERS
+    {"ref-stb", ref_stb_compress_dxt5, true, false},
+    {"ref-cluster", ref_cluster_compress_dxt5, true, true},
+#endif
+};
+
+struct ModeTotals {
+    double seconds = 0;
+    double pixels = 0;
+    double psnr_rgb = 0;
+    double psnr_rgb_plugin = 0;
+    double psnr_alpha = 0;
+    double ssim = 0;
+    int images = 0;
+};
+
+static std::vector<int> parse_list(const char* text) {
+    std::vector<int> values;
+    for (const char* p = text; *p;) {
+        values.push_back(atoi(p));
+        const char* comma = strchr(p, ',');
+        if (!comma) {
+            break;
+        }
+        p = comma + 1;
+    }
+    return values;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {256, 1024};
+    int seeds = 2;
+    int reps = 3;
+    bool run_slow = false;
+    const char* csv_path = nullptr;
+#ifdef _OPENMP
+    std::vector<int> thread_counts = {omp_get_max_threads()};
+#else
+    std::vector<int> thread_counts = {1};
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizes = parse_list(argv[++i]);
+        } else if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) {
+            seeds = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_counts = parse_list(argv[++i]);
+        } else if (strcmp(argv[i], "--cluster") == 0) {
+            run_slow = true;
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--sizes 256,1024] [--seeds N] [--reps N] [--threads 1,8] [--cluster] [--csv file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    FILE* csv = nullptr;
+    if (csv_path) {
+        csv = fopen(csv_path, "w");
+        if (!csv) {
+            fprintf(stderr, "ERROR: cannot write %s\n", csv_path);
+            return 1;
+        }
+        fprintf(csv, "mode,threads,kind,width,height,seed,ms,mp_per_s,psnr_rgb,psnr_rgb_plugin,psnr_alpha,ssim\n");
+    }
+
+    const int mode_count = sizeof(ENCODER_MODES) / sizeof(ENCODER_MODES[0]);
+    const int thread_count_count = (int)thread_counts.size();
+    std::vector<ModeTotals> totals(mode_count * thread_count_count);
+    std::vector<uint8_t> rgba, blocks, decoded, decoded_plugin;
+
+    for (int size : sizes) {
+        size_t pixels = (size_t)size * size;
+        rgba.resize(pixels * 4);
+        decoded.resize(pixels * 4);
+        decoded_plugin.resize(pixels * 4);
+        blocks.resize((size_t)tex_level_size(TEX_FORMAT_DXT5, size, size));
+
+        for (int kind = 0; kind < CORPUS_KIND_COUNT; kind++) {
+            for (int seed = 1; seed <= seeds; seed++) {
+                corpus_generate((CorpusKind)kind, (uint64_t)seed, size, size, rgba.data());
+
+                for (int m = 0; m < mode_count; m++) {
+                    const EncoderMode& mode = ENCODER_MODES[m];
+                    if (mode.slow && !run_slow) {
+                        continue;
+                    }
+                    // Quality does not depend on the thread count, so it is measured once
+                    double psnr_rgb = 0, psnr_rgb_plugin = 0, psnr_alpha = 0, ssim = 0;
+                    for (int tc = 0; tc < thread_count_count; tc++) {
+#ifdef _OPENMP
+                        omp_set_num_threads(thread_counts[tc]);
+#endif
+                        double best_ms = 1e300;
+                        for (int r = 0; r < reps; r++) {
+                            auto start = std::chrono::steady_clock::now();
+                            mode.encode(rgba.data(), size, size, blocks.data());
+                            best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                        }
+                        if (tc == 0) {
+                            tex_decode_dxt5_standard(blocks.data(), size, size, decoded.data());
+                            decompress_dxt5(blocks.data(), size, size, decoded_plugin.data());
+                            psnr_rgb = tex_psnr_rgb(rgba.data(), decoded.data(), size, size);
+                            psnr_rgb_plugin = tex_psnr_rgb(rgba.data(), decoded_plugin.data(), size, size);
+                            psnr_alpha = tex_psnr_alpha(rgba.data(), decoded.data(), size, size);
+                            ssim = tex_ssim(rgba.data(), decoded.data(), size, size);
+                        }
+
+                        ModeTotals& t = totals[tc * mode_count + m];
+                        t.seconds += best_ms / 1000.0;
+                        t.pixels += (double)pixels;
+                        t.psnr_rgb += psnr_rgb;
+                        t.psnr_rgb_plugin += psnr_rgb_plugin;
+                        t.psnr_alpha += psnr_alpha;
+                        t.ssim += ssim;
+                        t.images++;
+
+                        if (csv) {
+                            fprintf(csv, "%s,%d,%s,%d,%d,%d,%.4f,%.2f,%.3f,%.3f,%.3f,%.5f\n", mode.name, thread_counts[tc],
+                                    corpus_kind_name((CorpusKind)kind), size, size, seed, best_ms, pixels / (best_ms * 1e3),
+                                    psnr_rgb, psnr_rgb_plugin, psnr_alpha, ssim);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (csv) {
+        fclose(csv);
+    }
+
+    // A mode is on the Pareto front unless another mode at the same thread count is at least
+    // as fast and at least as good; reference encoders take part so we can see where we stand
+    printf("%-12s %7s %10s %10s %11s %11s %8s %7s\n", "mode", "threads", "MP/s", "PSNR rgb", "PSNR plugin", "PSNR alpha", "SSIM",
+           "pareto");
+    for (int tc = 0; tc < thread_count_count; tc++) {
+        for (int m = 0; m < mode_count; m++) {
+            const ModeTotals& t = totals[tc * mode_count + m];
+            if (t.images == 0) {
+                continue;
+            }
+            double speed = t.pixels / (t.seconds * 1e6);
+            double quality = t.psnr_rgb / t.images;
+
+            bool dominated = false;
+            for (int o = 0; o < mode_count; o++) {
+                const ModeTotals& other = totals[tc * mode_count + o];
+                if (other.images == 0) {
+                    continue;
+                }
+                double other_speed = other.pixels / (other.seconds * 1e6);
+                double other_quality = other.psnr_rgb / other.images;
+                if (o != m && other_speed >= speed && other_quality >= quality && (other_speed > speed || other_quality > quality)) {
+                    dominated = true;
+                }
+            }
+            printf("%-12s %7d %10.1f %10.2f %11.2f %11.2f %8.4f %7s%s\n", ENCODER_MODES[m].name, thread_counts[tc], speed, quality,
+                   t.psnr_rgb_plugin / t.images, t.psnr_alpha / t.images, t.ssim / t.images, dominated ? "" : "yes", ENCODER_MODES[m].reference ? "  (reference)" : "");
+        }
+    }
+    return 0;
+}
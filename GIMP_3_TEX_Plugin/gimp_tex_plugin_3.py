@@ -127,10 +127,18 @@ threading.Thread(target=start_error_closer, daemon=True).start()
 
 _dxt_dll = None
 _has_fast_compression = False
+_has_trace = False
+_has_stats = False
+_TexStats = None
+_has_bgra8_decode = False
+trace_file = os.path.join(os.path.expanduser('~'), 'gimp_tex_plugin_3_trace.json')
+# For UI textures stored with premultiplied alpha (the procedures' premultiplied-alpha option):
+# load unpremultiplies and DXT export premultiplies inside the DLL's block loops
+TEX_FLAG_PREMULTIPLIED = 1
 
 def init_fast_compression():
     """Initialize fast DXT compression library"""
-    global _dxt_dll, _has_fast_compression
+    global _dxt_dll, _has_fast_compression, _has_trace, _has_stats, _TexStats, _has_bgra8_decode
     
     if _has_fast_compression:
         return True
@@ -170,6 +178,57 @@ def init_fast_compression():
             ]
             _dxt_dll.decompress_dxt5.restype = None
             
+            # Per call statistics (TexStats in dxt_compress.h), logged after every call
+            if hasattr(_dxt_dll, 'compress_dxt5_ex'):
+                class TexStats(ctypes.Structure):
+                    _fields_ = [
+                        ('total_ms', ctypes.c_double),
+                        ('setup_ms', ctypes.c_double),
+                        ('blocks_ms', ctypes.c_double),
+                        ('blocks_uniform', ctypes.c_longlong),
+                        ('blocks_fast', ctypes.c_longlong),
+                        ('blocks_refined', ctypes.c_longlong),
+                        ('blocks_edge', ctypes.c_longlong),
+                        ('threads', ctypes.c_int),
+                        ('bytes_read', ctypes.c_longlong),
+                        ('bytes_written', ctypes.c_longlong),
+                        ('peak_scratch_bytes', ctypes.c_longlong),
+                        ('refine_steps', ctypes.c_longlong),
+                    ]
+                for name in ('compress_dxt5_ex', 'decompress_dxt1_ex', 'decompress_dxt5_ex'):
+                    func = getattr(_dxt_dll, name)
+                    func.argtypes = [
+                        ctypes.POINTER(ctypes.c_ubyte),
+                        ctypes.c_int,
+                        ctypes.c_int,
+                        ctypes.POINTER(ctypes.c_ubyte),
+                        ctypes.c_int,
+                        ctypes.POINTER(TexStats)
+                    ]
+                    func.restype = None
+                _TexStats = TexStats
+                _has_stats = True
+            
+            # Native BGRA8 decode, which came with tex_swizzle_bgra; older DLLs lack it
+            if hasattr(_dxt_dll, 'tex_swizzle_bgra'):
+                _dxt_dll.tex_decode_level_ex.argtypes = [
+                    ctypes.c_int,
+                    ctypes.POINTER(ctypes.c_ubyte),
+                    ctypes.c_int,
+                    ctypes.c_int,
+                    ctypes.POINTER(ctypes.c_ubyte),
+                    ctypes.c_int,
+                    ctypes.c_void_p
+                ]
+                _dxt_dll.tex_decode_level_ex.restype = ctypes.c_int
+                _has_bgra8_decode = True
+            
+            # Only present when the DLL was built with -DTEX_TRACE
+            if hasattr(_dxt_dll, 'tex_trace_dump'):
+                _dxt_dll.tex_trace_dump.argtypes = [ctypes.c_char_p]
+                _dxt_dll.tex_trace_dump.restype = ctypes.c_int
+                _has_trace = True
+            
             _has_fast_compression = True
             print("Fast DXT compression DLL loaded!")
             sys.stdout.flush()
@@ -181,7 +240,7 @@ def init_fast_compression():
     return False
 
 
-def fast_compress_dxt5(rgba_data, width, height):
+def fast_compress_dxt5(rgba_data, width, height, premultiplied=False):
     """Fast DXT5 compression using compiled DLL (10-100x faster)"""
     if not _has_fast_compression:
         if not init_fast_compression():
@@ -193,23 +252,20 @@ def fast_compress_dxt5(rgba_data, width, height):
         block_height = (height + 3) // 4
         output_size = block_width * block_height * 16
         
-        # OPTIMIZED: Use ctypes.create_string_buffer for zero-copy conversion
-        input_buffer = ctypes.create_string_buffer(bytes(rgba_data), len(rgba_data))
+        # The input is read in place; the result is copied out of the ctypes buffer once
+        input_data, input_ptr = dll_input(rgba_data)
         output_buffer = (ctypes.c_ubyte * output_size)()
         
-        _dxt_dll.compress_dxt5(
-            ctypes.cast(input_buffer, ctypes.POINTER(ctypes.c_ubyte)),
-            width, height, output_buffer
-        )
+        call_with_stats('compress_dxt5', "DXT5 compress", input_ptr, width, height, output_buffer, premultiplied)
         
-        return bytes(bytearray(output_buffer))
+        return ctypes.string_at(output_buffer, output_size)
     except Exception as e:
         print(f"Fast compression failed: {e}")
         sys.stdout.flush()
         return None
 
 
-def fast_decompress_dxt1(compressed_data, width, height):
+def fast_decompress_dxt1(compressed_data, width, height, premultiplied=False):
     """Fast DXT1 decompression using compiled DLL"""
     if not _has_fast_compression:
         if not init_fast_compression():
@@ -217,24 +273,21 @@ def fast_decompress_dxt1(compressed_data, width, height):
     
     try:
         import ctypes
-        # OPTIMIZED: Use ctypes.create_string_buffer for zero-copy conversion
-        input_buffer = ctypes.create_string_buffer(bytes(compressed_data), len(compressed_data))
+        # The input is read in place; the result is copied out of the ctypes buffer once
+        input_data, input_ptr = dll_input(compressed_data)
         output_size = width * height * 4
         output_buffer = (ctypes.c_ubyte * output_size)()
         
-        _dxt_dll.decompress_dxt1(
-            ctypes.cast(input_buffer, ctypes.POINTER(ctypes.c_ubyte)),
-            width, height, output_buffer
-        )
+        call_with_stats('decompress_dxt1', "DXT1 decompress", input_ptr, width, height, output_buffer, premultiplied)
         
-        return bytes(bytearray(output_buffer))
+        return ctypes.string_at(output_buffer, output_size)
     except Exception as e:
         print(f"Fast DXT1 decompression failed: {e}")
         sys.stdout.flush()
         return None
 
 
-def fast_decompress_dxt5(compressed_data, width, height):
+def fast_decompress_dxt5(compressed_data, width, height, premultiplied=False):
     """Fast DXT5 decompression using compiled DLL"""
     if not _has_fast_compression:
         if not init_fast_compression():
@@ -242,23 +295,88 @@ def fast_decompress_dxt5(compressed_data, width, height):
     
     try:
         import ctypes
-        # OPTIMIZED: Use ctypes.create_string_buffer for zero-copy conversion
-        input_buffer = ctypes.create_string_buffer(bytes(compressed_data), len(compressed_data))
+        # The input is read in place; the result is copied out of the ctypes buffer once
+        input_data, input_ptr = dll_input(compressed_data)
         output_size = width * height * 4
         output_buffer = (ctypes.c_ubyte * output_size)()
         
-        _dxt_dll.decompress_dxt5(
-            ctypes.cast(input_buffer, ctypes.POINTER(ctypes.c_ubyte)),
-            width, height, output_buffer
-        )
+        call_with_stats('decompress_dxt5', "DXT5 decompress", input_ptr, width, height, output_buffer, premultiplied)
         
-        return bytes(bytearray(output_buffer))
+        return ctypes.string_at(output_buffer, output_size)
     except Exception as e:
         print(f"Fast DXT5 decompression failed: {e}")
         sys.stdout.flush()
         return None
 
 
+def fast_decode_bgra8(data, width, height, premultiplied=False):
+    """BGRA8 to RGBA using the DLL, or None when it is not available"""
+    if not _has_fast_compression:
+        if not init_fast_compression():
+            return None
+    if not _has_bgra8_decode:
+        return None
+    
+    try:
+        import ctypes
+        input_data, input_ptr = dll_input(data)
+        output_size = width * height * 4
+        if len(input_data) < output_size:
+            return None
+        output_buffer = (ctypes.c_ubyte * output_size)()
+        
+        flags = TEX_FLAG_PREMULTIPLIED if premultiplied else 0
+        if _dxt_dll.tex_decode_level_ex(TEXFormat.BGRA8, input_ptr, width, height, output_buffer, flags, None) != 0:
+            return None
+        return ctypes.string_at(output_buffer, output_size)
+    except Exception as e:
+        print(f"Fast BGRA8 decode failed: {e}")
+        sys.stdout.flush()
+        return None
+
+
+def dll_input(data):
+    """Read-only ctypes pointer to data for the DLL. bytes are passed without a copy; the
+    returned object must stay referenced until the call returns."""
+    import ctypes
+    if not isinstance(data, bytes):
+        data = bytes(data)
+    return data, ctypes.cast(ctypes.c_char_p(data), ctypes.POINTER(ctypes.c_ubyte))
+
+
+def call_with_stats(name, label, input_ptr, width, height, output_ptr, premultiplied=False):
+    """Run a DLL codec entry point, logging its TexStats when the DLL provides them"""
+    if not _has_stats:
+        if premultiplied:
+            print(f"{label}: this DLL has no *_ex entry points, premultiplied alpha is ignored")
+            sys.stdout.flush()
+        getattr(_dxt_dll, name)(input_ptr, width, height, output_ptr)
+        return
+    
+    import ctypes
+    stats = _TexStats()
+    flags = TEX_FLAG_PREMULTIPLIED if premultiplied else 0
+    getattr(_dxt_dll, name + '_ex')(input_ptr, width, height, output_ptr, flags, ctypes.byref(stats))
+    print(f"{label} {width}x{height}: {stats.total_ms:.1f} ms "
+          f"(setup {stats.setup_ms:.1f}, blocks {stats.blocks_ms:.1f}), "
+          f"blocks uniform/fast/refined/edge {stats.blocks_uniform}/{stats.blocks_fast}/"
+          f"{stats.blocks_refined}/{stats.blocks_edge}, {stats.threads} threads, "
+          f"read {stats.bytes_read} B, wrote {stats.bytes_written} B, "
+          f"peak scratch {stats.peak_scratch_bytes} B")
+    sys.stdout.flush()
+
+
+def dump_trace():
+    """Write the DLL's timeline of this session to trace_file (tracing builds only)"""
+    if not _has_trace:
+        return
+    if _dxt_dll.tex_trace_dump(trace_file.encode('utf-8')) == 0:
+        print(f"Trace written: {trace_file}")
+    else:
+        print(f"Could not write trace: {trace_file}")
+    sys.stdout.flush()
+
+
 # ============================================================================
 # TEX Format
 # ============================================================================
@@ -426,7 +544,7 @@ def decompress_dxt1_block(block_data, x, y, width, height, pixels):
                 pixels[pixel_idx:pixel_idx+4] = [r, g, b, a]
 
 
-def decompress_tex_to_rgba(tex):
+def decompress_tex_to_rgba(tex, premultiplied=False):
     """Decompress .tex data to RGBA"""
     width, height = tex.width, tex.height
     
@@ -437,6 +555,10 @@ def decompress_tex_to_rgba(tex):
         data = tex.data[0]
     
     if tex.format == TEXFormat.BGRA8:
+        fast_result = fast_decode_bgra8(data, width, height, premultiplied)
+        if fast_result:
+            return fast_result
+        
         # Uncompressed BGRA to RGBA
         pixels = bytearray(width * height * 4)
         for i in range(0, len(data), 4):
@@ -449,7 +571,7 @@ def decompress_tex_to_rgba(tex):
     
     elif tex.format == TEXFormat.DXT1:
         # Try fast decompression first
-        fast_result = fast_decompress_dxt1(data, width, height)
+        fast_result = fast_decompress_dxt1(data, width, height, premultiplied)
         if fast_result:
             print("Using FAST DLL decompression (DXT1)")
             sys.stdout.flush()
@@ -472,7 +594,7 @@ def decompress_tex_to_rgba(tex):
     
     elif tex.format == TEXFormat.DXT5:
         # Try fast decompression first
-        fast_result = fast_decompress_dxt5(data, width, height)
+        fast_result = fast_decompress_dxt5(data, width, height, premultiplied)
         if fast_result:
             print("Using FAST DLL decompression (DXT5)")
             sys.stdout.flush()
@@ -502,6 +624,28 @@ def decompress_tex_to_rgba(tex):
 # GIMP Plugin
 # ============================================================================
 
+def add_premultiplied_option(procedure):
+    procedure.add_boolean_argument("premultiplied-alpha", "Premultiplied alpha",
+                                   "The texture stores premultiplied alpha (UI textures)",
+                                   False, GObject.ParamFlags.READWRITE)
+
+
+def procedure_config(*run_args):
+    """The Gimp.ProcedureConfig among a run function's arguments, whose position differs
+    between GIMP 3 releases, or None"""
+    return next((value for value in run_args if isinstance(value, Gimp.ProcedureConfig)), None)
+
+
+def premultiplied_option(config):
+    """The premultiplied-alpha option of a load or export, False when it is not set"""
+    if config is None:
+        return False
+    try:
+        return bool(config.get_property("premultiplied-alpha"))
+    except Exception:
+        return False
+
+
 class TexPlugin(Gimp.PlugIn):
     def do_set_i18n(self, procname):
         return False
@@ -521,6 +665,7 @@ class TexPlugin(Gimp.PlugIn):
             procedure.set_menu_label("League of Legends TEX")
             procedure.set_documentation("Load .tex texture files", "Loads DXT1/DXT5/BGRA8 textures", name)
             procedure.set_extensions("tex")
+            add_premultiplied_option(procedure)
             
         elif name == 'file-tex-export':
             procedure = Gimp.ExportProcedure.new(self, name, Gimp.PDBProcType.PLUGIN, False, self.export_tex, None)
@@ -528,6 +673,7 @@ class TexPlugin(Gimp.PlugIn):
             procedure.set_documentation("Export as .tex texture", "Exports image as TEX file (BGRA8)", name)
             procedure.set_image_types("*")
             procedure.set_extensions("tex")
+            add_premultiplied_option(procedure)
         
         if procedure:
             procedure.set_attribution("LtMAO Team", "LtMAO Team", "2024")
@@ -564,7 +710,7 @@ class TexPlugin(Gimp.PlugIn):
             print(f"TEX: {tex.width}x{tex.height}, format={tex.format}, mipmaps={tex.mipmaps}")
             
             print("Decompressing...")
-            rgba = decompress_tex_to_rgba(tex)
+            rgba = decompress_tex_to_rgba(tex, premultiplied_option(procedure_config(args, config, data, *extra)))
             print(f"Decompressed: {len(rgba)} bytes")
             
             # Create GIMP image
@@ -612,6 +758,7 @@ class TexPlugin(Gimp.PlugIn):
             except:
                 pass
             
+            dump_trace()
             print("Load successful!")
             print("="*60)
             sys.stdout.flush()
@@ -642,6 +789,19 @@ class TexPlugin(Gimp.PlugIn):
             path = file.get_path()
             print(f"Exporting to: {path}")
             
+            # Export options dialog; scripts pass the options as procedure arguments instead
+            run_config = procedure_config(args, config, data, *extra)
+            if run_mode == Gimp.RunMode.INTERACTIVE and run_config is not None:
+                GimpUi.init("file-tex-export")
+                dialog = GimpUi.ProcedureDialog.new(procedure, run_config, "Export TEX")
+                dialog.fill(None)
+                confirmed = dialog.run()
+                dialog.destroy()
+                if not confirmed:
+                    return procedure.new_return_values(Gimp.PDBStatusType.CANCEL, GLib.Error())
+            premultiplied = premultiplied_option(run_config)
+            print(f"Premultiplied alpha: {premultiplied}")
+            
             # Duplicate image to avoid modifying the original
             print("Duplicating image...")
             export_image = image.duplicate()
@@ -682,7 +842,8 @@ class TexPlugin(Gimp.PlugIn):
             
             # Compress to DXT5 using fast DLL
             print("Compressing to DXT5...")
-            compressed_data = fast_compress_dxt5(pixel_data, w, h)
+            compressed_data = fast_compress_dxt5(pixel_data, w, h, premultiplied)
+            tex_format = TEXFormat.DXT5
             
             if compressed_data:
                 print(f"Using FAST DLL compression - {len(compressed_data)} bytes")
@@ -691,16 +852,19 @@ class TexPlugin(Gimp.PlugIn):
                 print("Please run build_dxt_dll_direct.bat to enable fast compression")
                 # For now, save as uncompressed BGRA8
                 print("Saving as uncompressed BGRA8...")
+                if premultiplied:
+                    print("Premultiplied alpha needs the DLL, saving straight alpha")
                 # OPTIMIZED: Use numpy-style slicing for fast RGBA->BGRA conversion
                 bgra = bytearray(pixel_data)
                 bgra[0::4], bgra[2::4] = bgra[2::4], bgra[0::4]  # Swap R and B channels
                 compressed_data = bytes(bgra)
+                tex_format = TEXFormat.BGRA8
             
             # Write TEX file
             print("Writing TEX file...")
             tex = TEX()
             tex.width, tex.height = w, h
-            tex.format = TEXFormat.DXT5 if fast_compress_dxt5(pixel_data, w, h) else TEXFormat.BGRA8
+            tex.format = tex_format
             tex.mipmaps = False
             tex.data = [compressed_data]
             tex.write(path)
@@ -708,6 +872,7 @@ class TexPlugin(Gimp.PlugIn):
             # Clean up duplicate image
             export_image.delete()
             
+            dump_trace()
             print(f"Export successful: {path}")
             print("="*60)
             sys.stdout.flush()
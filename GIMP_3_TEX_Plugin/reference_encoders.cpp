@@ -0,0 +1,402 @@
+/*
+Reference BC3 (DXT5) encoders used as a yardstick by dxt_quality (see reference_encoders.h)
+*/
+
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "reference_encoders.h"
+
+struct Vec3 {
+    float r, g, b;
+};
+
+static Vec3 operator+(Vec3 a, Vec3 b) { return {a.r + b.r, a.g + b.g, a.b + b.b}; }
+static Vec3 operator-(Vec3 a, Vec3 b) { return {a.r - b.r, a.g - b.g, a.b - b.b}; }
+static Vec3 operator*(Vec3 a, float s) { return {a.r * s, a.g * s, a.b * s}; }
+static float dot(Vec3 a, Vec3 b) { return a.r * b.r + a.g * b.g + a.b * b.b; }
+
+// Pixels of one block; pixels outside the image repeat the nearest edge pixel so they do
+// not pull the endpoints anywhere new
+struct RefBlock {
+    uint8_t rgba[16][4];
+};
+
+static void load_block(const uint8_t* rgba, int x, int y, int width, int height, RefBlock& block) {
+    for (int py = 0; py < 4; py++) {
+        for (int px = 0; px < 4; px++) {
+            int sx = std::min(x + px, width - 1);
+            int sy = std::min(y + py, height - 1);
+            memcpy(block.rgba[py * 4 + px], rgba + ((size_t)sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+// ============================================================================
+// 565 endpoints
+// ============================================================================
+
+static uint16_t quantize_565(Vec3 c) {
+    int r = (int)std::lround(std::min(std::max(c.r, 0.0f), 255.0f) * 31.0f / 255.0f);
+    int g = (int)std::lround(std::min(std::max(c.g, 0.0f), 255.0f) * 63.0f / 255.0f);
+    int b = (int)std::lround(std::min(std::max(c.b, 0.0f), 255.0f) * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static Vec3 expand_565(uint16_t c) {
+    int r = (c >> 11) & 0x1F;
+    int g = (c >> 5) & 0x3F;
+    int b = c & 0x1F;
+    return {(float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2))};
+}
+
+static void color_palette(uint16_t c0, uint16_t c1, Vec3 palette[4]) {
+    palette[0] = expand_565(c0);
+    palette[1] = expand_565(c1);
+    palette[2] = palette[0] * (2.0f / 3.0f) + palette[1] * (1.0f / 3.0f);
+    palette[3] = palette[0] * (1.0f / 3.0f) + palette[1] * (2.0f / 3.0f);
+}
+
+static Vec3 pixel_color(const RefBlock& block, int i) {
+    return {(float)block.rgba[i][0], (float)block.rgba[i][1], (float)block.rgba[i][2]};
+}
+
+// Nearest palette entry per pixel; returns the squared error
+static float match_colors(const RefBlock& block, uint16_t c0, uint16_t c1, uint32_t* indices) {
+    Vec3 palette[4];
+    color_palette(c0, c1, palette);
+    float total = 0;
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        Vec3 p = pixel_color(block, i);
+        int best = 0;
+        float best_error = 1e30f;
+        for (int j = 0; j < 4; j++) {
+            Vec3 d = p - palette[j];
+            float error = dot(d, d);
+            if (error < best_error) {
+                best_error = error;
+                best = j;
+            }
+        }
+        bits |= (uint32_t)best << (i * 2);
+        total += best_error;
+    }
+    *indices = bits;
+    return total;
+}
+
+// Writes the 8 byte color half in 4 color order (color0 > color1)
+static void write_color_block(uint16_t c0, uint16_t c1, uint32_t indices, uint8_t* output) {
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        indices ^= 0x55555555;  // 0 <-> 1, 2 <-> 3
+    } else if (c0 == c1) {
+        indices = 0;
+    }
+    output[0] = c0 & 0xFF;
+    output[1] = c0 >> 8;
+    output[2] = c1 & 0xFF;
+    output[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        output[4 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+}
+
+// Principal axis of the block colors by power iteration on the covariance matrix
+static Vec3 principal_axis(const RefBlock& block, Vec3* mean_out) {
+    Vec3 mean = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        mean = mean + pixel_color(block, i);
+    }
+    mean = mean * (1.0f / 16.0f);
+
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        Vec3 d = pixel_color(block, i) - mean;
+        cov[0] += d.r * d.r;
+        cov[1] += d.r * d.g;
+        cov[2] += d.r * d.b;
+        cov[3] += d.g * d.g;
+        cov[4] += d.g * d.b;
+        cov[5] += d.b * d.b;
+    }
+
+    Vec3 axis = {0.299f, 0.587f, 0.114f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        Vec3 next = {cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                     cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                     cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b};
+        float length = std::sqrt(dot(next, next));
+        if (length < 1e-6f) {
+            break;
+        }
+        axis = next * (1.0f / length);
+    }
+    *mean_out = mean;
+    return axis;
+}
+
+// Least squares endpoints for fixed indices (weights 1, 0, 2/3, 1/3 on color0)
+static bool refine_endpoints(const RefBlock& block, uint32_t indices, uint16_t* c0, uint16_t* c1) {
+    static const float weight0[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0, bb = 0, ab = 0;
+    Vec3 ax = {0, 0, 0}, bx = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float a = weight0[(indices >> (i * 2)) & 3];
+        float b = 1.0f - a;
+        Vec3 p = pixel_color(block, i);
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        ax = ax + p * a;
+        bx = bx + p * b;
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f) {
+        return false;
+    }
+    float inv = 1.0f / det;
+    *c0 = quantize_565((ax * bb - bx * ab) * inv);
+    *c1 = quantize_565((bx * aa - ax * ab) * inv);
+    return true;
+}
+
+// ============================================================================
+// Alpha
+// ============================================================================
+
+static void alpha_palette(int a0, int a1, int palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+    } else {
+        for (int i = 1; i < 5; i++) {
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// Encodes alpha with the given endpoints; returns the squared error
+static int encode_alpha(const RefBlock& block, int a0, int a1, uint8_t* output) {
+    int palette[8];
+    alpha_palette(a0, a1, palette);
+    uint64_t bits = 0;
+    int total = 0;
+    for (int i = 0; i < 16; i++) {
+        int alpha = block.rgba[i][3];
+        int best = 0;
+        int best_error = 1 << 30;
+        for (int j = 0; j < 8; j++) {
+            int d = alpha - palette[j];
+            if (d * d < best_error) {
+                best_error = d * d;
+                best = j;
+            }
+        }
+        bits |= (uint64_t)best << (i * 3);
+        total += best_error;
+    }
+    output[0] = (uint8_t)a0;
+    output[1] = (uint8_t)a1;
+    for (int i = 0; i < 6; i++) {
+        output[2 + i] = (bits >> (i * 8)) & 0xFF;
+    }
+    return total;
+}
+
+static void alpha_range(const RefBlock& block, bool skip_extremes, int* lo, int* hi) {
+    *lo = 255;
+    *hi = 0;
+    for (int i = 0; i < 16; i++) {
+        int alpha = block.rgba[i][3];
+        if (skip_extremes && (alpha == 0 || alpha == 255)) {
+            continue;
+        }
+        *lo = std::min(*lo, alpha);
+        *hi = std::max(*hi, alpha);
+    }
+    if (*lo > *hi) {
+        *lo = *hi = 0;
+    }
+}
+
+// ============================================================================
+// stb_dxt style
+// ============================================================================
+
+void ref_stb_compress_dxt5_block(const uint8_t* rgba, int x, int y, int width, int height, uint8_t* output) {
+    RefBlock block;
+    load_block(rgba, x, y, width, height, block);
+
+    int lo, hi;
+    alpha_range(block, false, &lo, &hi);
+    encode_alpha(block, hi, lo, output);
+
+    // Endpoints at the extremes of the principal axis
+    Vec3 mean;
+    Vec3 axis = principal_axis(block, &mean);
+    int min_i = 0, max_i = 0;
+    float min_d = 1e30f, max_d = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float d = dot(pixel_color(block, i), axis);
+        if (d < min_d) {
+            min_d = d;
+            min_i = i;
+        }
+        if (d > max_d) {
+            max_d = d;
+            max_i = i;
+        }
+    }
+    uint16_t c0 = quantize_565(pixel_color(block, max_i));
+    uint16_t c1 = quantize_565(pixel_color(block, min_i));
+    uint32_t indices;
+    float error = match_colors(block, c0, c1, &indices);
+
+    // One least squares refinement, kept only when it helps
+    uint16_t r0, r1;
+    if (c0 != c1 && refine_endpoints(block, indices, &r0, &r1)) {
+        uint32_t refined_indices;
+        float refined_error = match_colors(block, r0, r1, &refined_indices);
+        if (refined_error < error) {
+            c0 = r0;
+            c1 = r1;
+            indices = refined_indices;
+        }
+    }
+    write_color_block(c0, c1, indices, output + 8);
+}
+
+// ============================================================================
+// Cluster fit (libsquish style)
+// ============================================================================
+
+// Best 4 cluster split of the pixels ordered along axis; returns false for degenerate input
+static bool cluster_fit(const RefBlock& block, Vec3 axis, uint16_t* best_c0, uint16_t* best_c1, float* best_error) {
+    int order[16];
+    float projection[16];
+    for (int i = 0; i < 16; i++) {
+        order[i] = i;
+        projection[i] = dot(pixel_color(block, i), axis);
+    }
+    std::sort(order, order + 16, [&](int a, int b) { return projection[a] < projection[b]; });
+
+    // Prefix sums of the ordered colors so every split is evaluated in constant time
+    Vec3 prefix[17];
+    prefix[0] = {0, 0, 0};
+    float xx = 0;
+    for (int i = 0; i < 16; i++) {
+        Vec3 p = pixel_color(block, order[i]);
+        prefix[i + 1] = prefix[i] + p;
+        xx += dot(p, p);
+    }
+
+    bool found = false;
+    // Clusters in order: [0,i) -> color1, [i,j) -> 1/3 color0, [j,k) -> 2/3 color0, [k,16) -> color0
+    for (int i = 0; i <= 16; i++) {
+        for (int j = i; j <= 16; j++) {
+            for (int k = j; k <= 16; k++) {
+                float n13 = (float)(j - i), n23 = (float)(k - j), n1 = (float)(16 - k), n0 = (float)i;
+                float aa = n1 + n23 * (4.0f / 9.0f) + n13 * (1.0f / 9.0f);
+                float bb = n0 + n13 * (4.0f / 9.0f) + n23 * (1.0f / 9.0f);
+                float ab = (n13 + n23) * (2.0f / 9.0f);
+                float det = aa * bb - ab * ab;
+                if (std::fabs(det) < 1e-6f) {
+                    continue;
+                }
+                Vec3 s13 = prefix[j] - prefix[i];
+                Vec3 s23 = prefix[k] - prefix[j];
+                Vec3 ax = (prefix[16] - prefix[k]) + s23 * (2.0f / 3.0f) + s13 * (1.0f / 3.0f);
+                Vec3 bx = prefix[i] + s13 * (2.0f / 3.0f) + s23 * (1.0f / 3.0f);
+                float inv = 1.0f / det;
+                uint16_t c0 = quantize_565((ax * bb - bx * ab) * inv);
+                uint16_t c1 = quantize_565((bx * aa - ax * ab) * inv);
+
+                // Error of this split with the quantized endpoints, from the sums alone
+                Vec3 a = expand_565(c0);
+                Vec3 b = expand_565(c1);
+                float error = dot(a, a) * aa + dot(b, b) * bb + xx - 2.0f * (dot(a, ax) + dot(b, bx)) + 2.0f * ab * dot(a, b);
+                if (error < *best_error) {
+                    *best_error = error;
+                    *best_c0 = c0;
+                    *best_c1 = c1;
+                    found = true;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void ref_cluster_compress_dxt5_block(const uint8_t* rgba, int x, int y, int width, int height, uint8_t* output) {
+    RefBlock block;
+    load_block(rgba, x, y, width, height, block);
+
+    // Alpha: 8 level mode over the full range, or 6 levels plus exact 0 and 255
+    uint8_t eight[8], six[8];
+    int lo, hi;
+    alpha_range(block, false, &lo, &hi);
+    int eight_error = encode_alpha(block, hi, lo, eight);
+    alpha_range(block, true, &lo, &hi);
+    int six_error = encode_alpha(block, lo, hi, six);
+    memcpy(output, six_error < eight_error ? six : eight, 8);
+
+    Vec3 mean;
+    Vec3 axis = principal_axis(block, &mean);
+    uint16_t c0 = quantize_565(mean), c1 = c0;
+    float best_error = 1e30f;
+    uint32_t indices;
+
+    // Re-order along the axis of the best endpoints until the split stops improving
+    for (int iteration = 0; iteration < 4; iteration++) {
+        float previous = best_error;
+        if (!cluster_fit(block, axis, &c0, &c1, &best_error) || best_error >= previous) {
+            break;
+        }
+        Vec3 next = expand_565(c0) - expand_565(c1);
+        float length = std::sqrt(dot(next, next));
+        if (length < 1e-6f) {
+            break;
+        }
+        axis = next * (1.0f / length);
+    }
+    match_colors(block, c0, c1, &indices);
+    write_color_block(c0, c1, indices, output + 8);
+}
+
+// ============================================================================
+// Whole image drivers, scheduled like compress_dxt5
+// ============================================================================
+
+template <typename BlockFn>
+static void compress_image(const uint8_t* rgba, int width, int height, uint8_t* output, BlockFn block_fn) {
+    int block_width = (width + 3) / 4;
+    int total_blocks = block_width * ((height + 3) / 4);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 64)
+    #endif
+    for (int i = 0; i < total_blocks; i++) {
+        block_fn(rgba, (i % block_width) * 4, (i / block_width) * 4, width, height, output + (size_t)i * 16);
+    }
+}
+
+void ref_stb_compress_dxt5(const uint8_t* rgba, int width, int height, uint8_t* output) {
+    compress_image(rgba, width, height, output, ref_stb_compress_dxt5_block);
+}
+
+void ref_cluster_compress_dxt5(const uint8_t* rgba, int width, int height, uint8_t* output) {
+    compress_image(rgba, width, height, output, ref_cluster_compress_dxt5_block);
+}
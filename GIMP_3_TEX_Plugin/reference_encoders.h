@@ -0,0 +1,26 @@
+/*
+Reference BC3 (DXT5) encoders used as a yardstick by dxt_quality
+
+These are in-repo implementations of two well known approaches, not part of the plugin
+library and not tuned:
+  stb   - real-time encoder in the style of stb_dxt: principal axis endpoints, one least
+          squares refinement, 8 level alpha from the block's min and max
+  cluster - cluster fit in the style of libsquish: every ordered split of the pixels along
+          the principal axis into the four palette entries, least squares endpoints per
+          split, iterated on the new axis; alpha tries both the 8 and 6 level modes
+Both expand 565 endpoints with bit replication like GPU decoders do.
+*/
+
+#ifndef REFERENCE_ENCODERS_H
+#define REFERENCE_ENCODERS_H
+
+#include <cstdint>
+
+// Same contract as compress_dxt5_block / compress_dxt5 in dxt_compress.h
+void ref_stb_compress_dxt5_block(const uint8_t* rgba, int x, int y, int width, int height, uint8_t* output);
+void ref_cluster_compress_dxt5_block(const uint8_t* rgba, int x, int y, int width, int height, uint8_t* output);
+
+void ref_stb_compress_dxt5(const uint8_t* rgba, int width, int height, uint8_t* output);
+void ref_cluster_compress_dxt5(const uint8_t* rgba, int width, int height, uint8_t* output);
+
+#endif // REFERENCE_ENCODERS_H
@@ -0,0 +1,264 @@
+/*
+Allocation tracking for the GIMP TEX plugin library
+Every heap buffer the library needs goes through tex_alloc / tex_free, which forward to the
+installed TexAllocator and keep byte and call counters so tools can report peak usage.
+The default allocator can back large buffers with huge pages (tex_set_huge_pages): 8K and 16K
+images span hundreds of MB, and the codec's 4 scanline block rows touch a new 4 KB page on
+almost every row, so with regular pages the TLB misses show up in the block loops.
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "dxt_compress.h"
+
+static const size_t ALLOC_ALIGNMENT = 64;
+static const size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+
+// ============================================================================
+// Huge page mappings
+// ============================================================================
+
+static std::atomic<int> g_huge_page_mode{TEX_PAGES_REGULAR};
+static std::atomic<size_t> g_huge_page_min_bytes{8 * HUGE_PAGE_BYTES};
+static std::atomic<long long> g_huge_page_allocs{0};
+
+// Buffers the default allocator mapped itself, with the length of the mapping. Only buffers of
+// at least a few MB get here, so a locked map costs nothing next to the mmap call.
+static std::mutex g_mappings_lock;
+static std::unordered_map<void*, size_t> g_mappings;
+
+static size_t round_up(size_t size, size_t multiple) {
+    return (size + multiple - 1) / multiple * multiple;
+}
+
+#ifdef _WIN32
+
+// Large pages need SeLockMemoryPrivilege, which the user must hold (Local Security Policy,
+// "Lock pages in memory"); without it the explicit mode falls back to regular pages.
+static size_t large_page_size() {
+    static size_t page_size = [] {
+        HANDLE token;
+        if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            TOKEN_PRIVILEGES privileges = {};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)) {
+                AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr);
+            }
+            CloseHandle(token);
+        }
+        return (size_t)GetLargePageMinimum();
+    }();
+    return page_size;
+}
+
+// Windows has no transparent huge pages, so only the explicit mode maps anything itself
+static void* map_huge(size_t size, int mode, size_t* mapped) {
+    size_t page = large_page_size();
+    if (mode != TEX_PAGES_EXPLICIT || page == 0) {
+        return nullptr;
+    }
+    size_t length = round_up(size, page);
+    void* ptr = VirtualAlloc(nullptr, length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (!ptr) {
+        return nullptr;
+    }
+    g_huge_page_allocs.fetch_add(1, std::memory_order_relaxed);
+    *mapped = length;
+    return ptr;
+}
+
+static void unmap_huge(void* ptr, size_t) {
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+#elif defined(__linux__)
+
+// Explicit mode tries the reserved hugetlbfs pool first (vm.nr_hugepages), which is empty on
+// most machines. Otherwise the buffer is mapped on a 2 MB boundary and advised so the kernel
+// can back it with transparent huge pages, which it may decline (THP set to "never").
+static void* map_huge(size_t size, int mode, size_t* mapped) {
+    size_t length = round_up(size, HUGE_PAGE_BYTES);
+#ifdef MAP_HUGETLB
+    if (mode == TEX_PAGES_EXPLICIT) {
+        void* ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            g_huge_page_allocs.fetch_add(1, std::memory_order_relaxed);
+            *mapped = length;
+            return ptr;
+        }
+    }
+#endif
+
+    // Over-allocate by one huge page and trim both ends to get the alignment
+    void* raw = mmap(nullptr, length + HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    uint8_t* start = (uint8_t*)raw;
+    uint8_t* aligned = (uint8_t*)round_up((size_t)start, HUGE_PAGE_BYTES);
+    if (aligned > start) {
+        munmap(start, aligned - start);
+    }
+    size_t tail = (start + length + HUGE_PAGE_BYTES) - (aligned + length);
+    if (tail) {
+        munmap(aligned + length, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    if (madvise(aligned, length, MADV_HUGEPAGE) == 0) {
+        g_huge_page_allocs.fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+    *mapped = length;
+    return aligned;
+}
+
+static void unmap_huge(void* ptr, size_t length) {
+    munmap(ptr, length);
+}
+
+#else
+
+static void* map_huge(size_t, int, size_t*) {
+    return nullptr;
+}
+
+static void unmap_huge(void*, size_t) {
+}
+
+#endif
+
+// ============================================================================
+// Default allocator
+// ============================================================================
+
+static void* default_allocate(void*, size_t size) {
+    int mode = g_huge_page_mode.load(std::memory_order_relaxed);
+    if (mode != TEX_PAGES_REGULAR && size >= g_huge_page_min_bytes.load(std::memory_order_relaxed)) {
+        size_t mapped = 0;
+        void* ptr = map_huge(size, mode, &mapped);
+        if (ptr) {
+            std::lock_guard<std::mutex> lock(g_mappings_lock);
+            g_mappings[ptr] = mapped;
+            return ptr;
+        }
+    }
+
+#ifdef _WIN32
+    return _aligned_malloc(size, ALLOC_ALIGNMENT);
+#else
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, ALLOC_ALIGNMENT, size) == 0 ? ptr : nullptr;
+#endif
+}
+
+static void default_release(void*, void* ptr, size_t size) {
+    if (size >= HUGE_PAGE_BYTES) {
+        size_t mapped = 0;
+        {
+            std::lock_guard<std::mutex> lock(g_mappings_lock);
+            auto it = g_mappings.find(ptr);
+            if (it != g_mappings.end()) {
+                mapped = it->second;
+                g_mappings.erase(it);
+            }
+        }
+        if (mapped) {
+            unmap_huge(ptr, mapped);
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static TexAllocator g_allocator = {default_allocate, default_release, nullptr};
+
+static std::atomic<long long> g_bytes_current{0};
+static std::atomic<long long> g_bytes_peak{0};
+static std::atomic<long long> g_bytes_total{0};
+static std::atomic<long long> g_alloc_count{0};
+static std::atomic<long long> g_free_count{0};
+
+void* tex_alloc(size_t size) {
+    size_t request = size ? size : 1;
+    void* ptr = g_allocator.allocate(g_allocator.user, request);
+    if (!ptr) {
+        return nullptr;
+    }
+
+    long long current = g_bytes_current.fetch_add((long long)request, std::memory_order_relaxed) + (long long)request;
+    long long peak = g_bytes_peak.load(std::memory_order_relaxed);
+    while (current > peak && !g_bytes_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+    }
+    g_bytes_total.fetch_add((long long)request, std::memory_order_relaxed);
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    return ptr;
+}
+
+void tex_free(void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    size_t request = size ? size : 1;
+    g_allocator.release(g_allocator.user, ptr, request);
+    g_bytes_current.fetch_sub((long long)request, std::memory_order_relaxed);
+    g_free_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" {
+
+__declspec(dllexport) void tex_set_allocator(const TexAllocator* allocator) {
+    if (allocator && allocator->allocate && allocator->release) {
+        g_allocator = *allocator;
+    } else {
+        g_allocator = {default_allocate, default_release, nullptr};
+    }
+}
+
+__declspec(dllexport) void tex_get_alloc_stats(TexAllocStats* stats) {
+    if (!stats) {
+        return;
+    }
+    stats->bytes_current = g_bytes_current.load(std::memory_order_relaxed);
+    stats->bytes_peak = g_bytes_peak.load(std::memory_order_relaxed);
+    stats->bytes_total = g_bytes_total.load(std::memory_order_relaxed);
+    stats->alloc_count = g_alloc_count.load(std::memory_order_relaxed);
+    stats->free_count = g_free_count.load(std::memory_order_relaxed);
+    stats->huge_page_allocs = g_huge_page_allocs.load(std::memory_order_relaxed);
+}
+
+__declspec(dllexport) void tex_reset_alloc_stats(void) {
+    g_bytes_peak.store(g_bytes_current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    g_bytes_total.store(0, std::memory_order_relaxed);
+    g_alloc_count.store(0, std::memory_order_relaxed);
+    g_free_count.store(0, std::memory_order_relaxed);
+    g_huge_page_allocs.store(0, std::memory_order_relaxed);
+}
+
+__declspec(dllexport) int tex_set_huge_pages(int mode, long long min_bytes) {
+    if (mode < TEX_PAGES_REGULAR || mode > TEX_PAGES_EXPLICIT || min_bytes < 0) {
+        return TEX_ERR_ARGS;
+    }
+    g_huge_page_mode.store(mode, std::memory_order_relaxed);
+    size_t threshold = (size_t)min_bytes > HUGE_PAGE_BYTES ? (size_t)min_bytes : HUGE_PAGE_BYTES;
+    g_huge_page_min_bytes.store(threshold, std::memory_order_relaxed);
+    return TEX_OK;
+}
+
+} // extern "C"
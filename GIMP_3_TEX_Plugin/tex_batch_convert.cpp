@@ -0,0 +1,592 @@
+/*
+Batch TEX re-encoder with a resumable journal
+
+Re-encodes every .tex file under an input folder to DXT5 into a mirrored output folder.
+The converting thread writes each output to a .tmp file beside its final name and hands it to
+a dedicated journal thread. Every --sync-every outputs or second, that thread fsyncs the batch's
+.tmp files, renames them into place, syncs their folders and only then appends their records
+(output path, hash and size, the input's size and modification time, the encode options) to
+the journal and fsyncs it, so the conversion never waits on the disk and an interrupted run
+picks up where it stopped. On restart an output is trusted when its input and the options are
+unchanged and its size matches the journal; --verify-hash also re-hashes it.
+When built with -DTEX_TRACE (plus tex_trace.cpp), --trace file.json writes a Chrome trace of
+the run: reads, writes, encode bands on every worker and the journal thread's waits and fsyncs.
+--premultiply stores the outputs with premultiplied alpha (inputs are straight alpha).
+--refine encodes with least squares endpoint refinement (TEX_FLAG_REFINE), a few times slower;
+it is closer to the source as GPUs decode it, not as this library and the plugins preview it.
+--mips writes the full mip chain generated from the source's full size level; with --refine the
+chain is encoded smallest level first, every level seeded from the one below (TEX_FLAG_MIP_SEEDED).
+--bleed gives fully transparent pixels the nearest visible color before encoding and mip
+generation (TEX_FLAG_ALPHA_BLEED), which removes dark or colored halos around sprite edges.
+Every output's zstd size inside a WAD is predicted (tex_estimate_compressed_size) and totalled;
+with --budget BYTES outputs predicted above it are listed and the run exits with 4.
+
+Compile with: g++ -O3 -march=native -fopenmp -o tex_batch_convert.exe tex_batch_convert.cpp dxt_compress.cpp tex_file.cpp tex_mip.cpp tex_alloc.cpp tex_size_estimate.cpp
+Usage: tex_batch_convert <input_dir> <output_dir> [--journal file] [--sync-every N] [--verify-hash] [--premultiply] [--refine] [--mips] [--bleed] [--budget BYTES] [--trace file.json]
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "dxt_compress.h"
+#include "tex_trace.h"
+
+namespace fs = std::filesystem;
+
+static const char JOURNAL_MAGIC[8] = {'T', 'E', 'X', 'J', 'R', 'N', 'L', '2'};
+
+// JournalRecord::options bit for --mips, above the TEX_FLAG_* encode flags
+static const uint32_t JOURNAL_OPTION_MIPS = 1u << 31;
+
+struct JournalRecord {
+    std::string path;  // output path relative to the output folder, '/' separated
+    uint64_t hash;
+    uint64_t size;
+    uint64_t input_size;
+    int64_t input_mtime;  // file clock ticks
+    uint32_t options;     // TEX_FLAG_* encode flags | JOURNAL_OPTION_MIPS
+};
+
+static uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void sync_file(FILE* f) {
+    fflush(f);
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    fsync(fileno(f));
+#endif
+}
+
+// Makes a rename inside the folder durable; Windows has no directory handles to flush
+static void sync_directory(const fs::path& dir) {
+#ifndef _WIN32
+    int fd = open(dir.string().c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#else
+    (void)dir;
+#endif
+}
+
+static bool read_file(const fs::path& path, std::vector<uint8_t>& bytes) {
+    TEX_TRACE_SCOPE("io", "read_file");
+    FILE* f = fopen(path.string().c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    std::error_code ec;
+    uintmax_t size = fs::file_size(path, ec);
+    bytes.resize(ec ? 0 : (size_t)size);
+    bool ok = !ec && fread(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    fclose(f);
+    return ok;
+}
+
+// Serialize one record: u32 path length, path, u64 hash, u64 size, u64 input size,
+// i64 input mtime, u32 options, u32 check
+static const size_t RECORD_FIXED_BYTES = 4 + 8 + 8 + 8 + 8 + 4 + 4;
+
+static void encode_record(const JournalRecord& record, std::vector<uint8_t>& out) {
+    out.clear();
+    uint32_t path_len = (uint32_t)record.path.size();
+    out.insert(out.end(), (const uint8_t*)&path_len, (const uint8_t*)&path_len + 4);
+    out.insert(out.end(), record.path.begin(), record.path.end());
+    out.insert(out.end(), (const uint8_t*)&record.hash, (const uint8_t*)&record.hash + 8);
+    out.insert(out.end(), (const uint8_t*)&record.size, (const uint8_t*)&record.size + 8);
+    out.insert(out.end(), (const uint8_t*)&record.input_size, (const uint8_t*)&record.input_size + 8);
+    out.insert(out.end(), (const uint8_t*)&record.input_mtime, (const uint8_t*)&record.input_mtime + 8);
+    out.insert(out.end(), (const uint8_t*)&record.options, (const uint8_t*)&record.options + 4);
+    uint32_t check = (uint32_t)fnv1a(out.data(), out.size());
+    out.insert(out.end(), (const uint8_t*)&check, (const uint8_t*)&check + 4);
+}
+
+// Load every complete record; a torn record at the end (crash mid-write) is dropped, and a
+// journal from an older version of the tool counts as empty
+static std::unordered_map<std::string, JournalRecord> load_journal(const fs::path& path, uint64_t* valid_bytes) {
+    std::unordered_map<std::string, JournalRecord> records;
+    *valid_bytes = 0;
+
+    std::vector<uint8_t> bytes;
+    if (!read_file(path, bytes) || bytes.size() < 8 || memcmp(bytes.data(), JOURNAL_MAGIC, 8) != 0) {
+        return records;
+    }
+
+    size_t pos = 8;
+    while (pos + 4 <= bytes.size()) {
+        uint32_t path_len;
+        memcpy(&path_len, &bytes[pos], 4);
+        size_t record_size = (size_t)path_len + RECORD_FIXED_BYTES;
+        if (path_len > 4096 || pos + record_size > bytes.size()) {
+            break;
+        }
+        uint32_t check;
+        memcpy(&check, &bytes[pos + record_size - 4], 4);
+        if ((uint32_t)fnv1a(&bytes[pos], record_size - 4) != check) {
+            break;
+        }
+
+        JournalRecord record;
+        record.path.assign((const char*)&bytes[pos + 4], path_len);
+        const uint8_t* fields = &bytes[pos + 4 + path_len];
+        memcpy(&record.hash, fields, 8);
+        memcpy(&record.size, fields + 8, 8);
+        memcpy(&record.input_size, fields + 16, 8);
+        memcpy(&record.input_mtime, fields + 24, 8);
+        memcpy(&record.options, fields + 32, 4);
+        records[record.path] = record;
+        pos += record_size;
+    }
+    *valid_bytes = pos;
+    return records;
+}
+
+// An output written to temp_path that becomes output_path, and is journaled, once committed
+struct PendingOutput {
+    JournalRecord record;
+    fs::path temp_path;
+    fs::path output_path;
+};
+
+// Commits outputs from a background thread in batches of sync_every or whatever a second
+// brought: fsync every .tmp, rename them into place, sync their folders, then append and fsync
+// their journal records
+class JournalWriter {
+public:
+    JournalWriter(FILE* file, int sync_every) : file_(file), sync_every_(sync_every) {
+        thread_ = std::thread(&JournalWriter::run, this);
+    }
+
+    ~JournalWriter() { finish(); }
+
+    void append(PendingOutput output) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(output));
+        }
+        wake_.notify_one();
+    }
+
+    // Commits what is still queued and stops the thread. Returns the number of outputs that
+    // could not be committed (each reported on stderr).
+    int finish() {
+        if (thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_one();
+            thread_.join();
+        }
+        return failures_;
+    }
+
+private:
+    void run() {
+        std::vector<PendingOutput> batch;
+        auto last_commit = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            {
+                TEX_TRACE_SCOPE("queue", "journal_wait");
+                wake_.wait_for(lock, std::chrono::seconds(1), [this] { return stopping_ || !queue_.empty(); });
+            }
+
+            while (!queue_.empty()) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            bool stopping = stopping_;
+            lock.unlock();
+
+            auto now = std::chrono::steady_clock::now();
+            if (!batch.empty() && (stopping || (int)batch.size() >= sync_every_ || now - last_commit >= std::chrono::seconds(1))) {
+                commit(batch);
+                batch.clear();
+                last_commit = now;
+            }
+
+            lock.lock();
+            if (stopping && queue_.empty()) {
+                break;
+            }
+        }
+    }
+
+    void commit(std::vector<PendingOutput>& batch) {
+        std::error_code ec;
+        std::vector<bool> committed(batch.size(), false);
+        std::vector<fs::path> folders;
+        {
+            TEX_TRACE_SCOPE("io", "output_fsync");
+            for (size_t i = 0; i < batch.size(); i++) {
+                FILE* f = fopen(batch[i].temp_path.string().c_str(), "r+b");
+                if (f) {
+                    sync_file(f);
+                    committed[i] = fclose(f) == 0;
+                }
+            }
+        }
+        {
+            TEX_TRACE_SCOPE("io", "output_rename");
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (committed[i]) {
+                    fs::rename(batch[i].temp_path, batch[i].output_path, ec);
+                    committed[i] = !ec;
+                }
+                if (!committed[i]) {
+                    fprintf(stderr, "FAILED to write: %s\n", batch[i].output_path.string().c_str());
+                    fs::remove(batch[i].temp_path, ec);
+                    failures_++;
+                    continue;
+                }
+                fs::path folder = batch[i].output_path.parent_path();
+                if (std::find(folders.begin(), folders.end(), folder) == folders.end()) {
+                    folders.push_back(folder);
+                }
+            }
+            for (const fs::path& folder : folders) {
+                sync_directory(folder);
+            }
+        }
+
+        TEX_TRACE_SCOPE("io", "journal_fsync");
+        std::vector<uint8_t> encoded;
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (committed[i]) {
+                encode_record(batch[i].record, encoded);
+                fwrite(encoded.data(), 1, encoded.size(), file_);
+            }
+        }
+        sync_file(file_);
+    }
+
+    FILE* file_;
+    int sync_every_;
+    int failures_ = 0;
+    bool stopping_ = false;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<PendingOutput> queue_;
+    std::thread thread_;
+};
+
+// Totals over every converted file, printed at the end of the run
+struct RunStats {
+    TexStats decode = {};
+    TexStats encode = {};
+    double read_ms = 0;
+    double write_ms = 0;
+    double estimate_ms = 0;
+    long long bytes_read = 0;
+    long long bytes_written = 0;
+    long long bytes_packed = 0;  // predicted zstd size of the outputs
+    long long peak_scratch_bytes = 0;
+    int over_budget = 0;
+};
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Decode the full size level of any supported TEX and write it back as DXT5, with a generated
+// mip chain when mips is set
+static bool convert_file(const fs::path& input, std::vector<uint8_t>& output, int encode_flags, bool mips, RunStats& run) {
+    std::vector<uint8_t> bytes;
+    TexHeader header;
+    auto read_start = std::chrono::steady_clock::now();
+    bool read_ok = read_file(input, bytes);
+    run.read_ms += ms_since(read_start);
+    run.bytes_read += (long long)bytes.size();
+    if (!read_ok || bytes.size() < 12 || tex_parse_header(bytes.data(), &header) != TEX_OK) {
+        return false;
+    }
+
+    long long offset = 12 + tex_level_offset(header, 0);
+    long long level_size = tex_level_size(header.format, header.width, header.height);
+    if (offset + level_size > (long long)bytes.size()) {
+        return false;
+    }
+
+    // BGRA8 sources are encoded straight from the file data; the encoder reads BGRA pixels
+    std::vector<uint8_t> rgba;
+    const uint8_t* pixels = bytes.data() + offset;
+    TexStats call;
+    if (header.format == TEX_FORMAT_BGRA8) {
+        encode_flags |= TEX_FLAG_BGRA_PIXELS;
+    } else {
+        rgba.resize((size_t)header.width * header.height * 4);
+        if (tex_decode_level_ex(header.format, pixels, header.width, header.height, rgba.data(), 0, &call) != TEX_OK) {
+            return false;
+        }
+        tex_stats_accumulate(run.decode, call);
+        pixels = rgba.data();
+    }
+
+    TexHeader output_header = {header.width, header.height, TEX_FORMAT_DXT5, mips};
+    long long dxt5_size = tex_level_offset(output_header, 0) + tex_level_size(TEX_FORMAT_DXT5, header.width, header.height);
+    output.assign(12 + (size_t)dxt5_size, 0);
+    const uint8_t tex_header[12] = {
+        'T', 'E', 'X', 0,
+        (uint8_t)(header.width & 0xFF), (uint8_t)(header.width >> 8),
+        (uint8_t)(header.height & 0xFF), (uint8_t)(header.height >> 8),
+        1, TEX_FORMAT_DXT5, 0, (uint8_t)(mips ? 1 : 0)
+    };
+    memcpy(output.data(), tex_header, 12);
+    if (mips) {
+        if (compress_dxt5_mips_ex(pixels, header.width, header.height, output.data() + 12, encode_flags | TEX_FLAG_MIP_SEEDED, &call) != TEX_OK) {
+            return false;
+        }
+    } else {
+        compress_dxt5_ex(pixels, header.width, header.height, output.data() + 12, encode_flags, &call);
+    }
+    tex_stats_accumulate(run.encode, call);
+    run.peak_scratch_bytes = std::max(run.peak_scratch_bytes, (long long)(bytes.capacity() + rgba.capacity() + output.capacity()));
+    return true;
+}
+
+static void print_codec_stats(const char* label, const TexStats& s) {
+    printf("  %-7s %9.1f ms (blocks %.1f ms), %lld uniform / %lld fast / %lld refined / %lld edge blocks, %d threads\n",
+           label, s.total_ms, s.blocks_ms, s.blocks_uniform, s.blocks_fast, s.blocks_refined, s.blocks_edge, s.threads);
+    if (s.blocks_refined) {
+        printf("  %-7s %9.2f refinement steps per refined block\n", "", (double)s.refine_steps / s.blocks_refined);
+    }
+}
+
+// Size and modification time of an input, which the journal keys its outputs on
+static bool input_identity(const fs::path& path, uint64_t* size, int64_t* mtime) {
+    std::error_code ec;
+    *size = (uint64_t)fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    *mtime = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+// Cheap check that a journaled output was made from this input with these options and is still
+// on disk as written; the hash is only recomputed when asked for
+static bool output_is_complete(const fs::path& path, const JournalRecord& record, uint64_t input_size,
+                               int64_t input_mtime, uint32_t options, bool verify_hash) {
+    if (record.input_size != input_size || record.input_mtime != input_mtime || record.options != options) {
+        return false;
+    }
+    std::error_code ec;
+    if (fs::file_size(path, ec) != record.size || ec) {
+        return false;
+    }
+    if (!verify_hash) {
+        return true;
+    }
+    std::vector<uint8_t> bytes;
+    return read_file(path, bytes) && fnv1a(bytes.data(), bytes.size()) == record.hash;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <input_dir> <output_dir> [--journal file] [--sync-every N] [--verify-hash] [--premultiply] [--refine] [--mips] [--bleed] [--budget BYTES] [--trace file.json]\n", argv[0]);
+        return 1;
+    }
+
+    fs::path input_dir = argv[1];
+    fs::path output_dir = argv[2];
+    fs::path journal_path = output_dir / ".tex_batch_journal";
+    int sync_every = 64;
+    bool verify_hash = false;
+    long long budget = 0;
+    int encode_flags = 0;
+    bool mips = false;
+#ifdef TEX_TRACE
+    const char* trace_path = nullptr;
+#endif
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journal_path = argv[++i];
+        } else if (strcmp(argv[i], "--sync-every") == 0 && i + 1 < argc) {
+            sync_every = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--verify-hash") == 0) {
+            verify_hash = true;
+        } else if (strcmp(argv[i], "--premultiply") == 0) {
+            encode_flags |= TEX_FLAG_PREMULTIPLIED;
+        } else if (strcmp(argv[i], "--refine") == 0) {
+            encode_flags |= TEX_FLAG_REFINE;
+        } else if (strcmp(argv[i], "--mips") == 0) {
+            mips = true;
+        } else if (strcmp(argv[i], "--bleed") == 0) {
+            encode_flags |= TEX_FLAG_ALPHA_BLEED;
+        } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            budget = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+#ifdef TEX_TRACE
+            trace_path = argv[++i];
+#else
+            fprintf(stderr, "--trace needs a build with -DTEX_TRACE\n");
+            return 1;
+#endif
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::error_code ec;
+    fs::create_directories(output_dir, ec);
+
+    // Resume: drop any torn tail so new records are appended after the last good one
+    uint64_t valid_bytes = 0;
+    std::unordered_map<std::string, JournalRecord> completed = load_journal(journal_path, &valid_bytes);
+    if (valid_bytes == 0) {
+        FILE* f = fopen(journal_path.string().c_str(), "wb");
+        if (!f) {
+            fprintf(stderr, "ERROR: cannot create journal %s\n", journal_path.string().c_str());
+            return 1;
+        }
+        fwrite(JOURNAL_MAGIC, 1, 8, f);
+        fclose(f);
+        valid_bytes = 8;
+    } else {
+        fs::resize_file(journal_path, valid_bytes, ec);
+    }
+    printf("Journal: %s (%zu completed outputs)\n", journal_path.string().c_str(), completed.size());
+
+    FILE* journal_file = fopen(journal_path.string().c_str(), "ab");
+    if (!journal_file) {
+        fprintf(stderr, "ERROR: cannot open journal %s\n", journal_path.string().c_str());
+        return 1;
+    }
+
+    uint32_t options = (uint32_t)encode_flags | (mips ? JOURNAL_OPTION_MIPS : 0);
+    std::vector<fs::path> inputs;
+    for (auto it = fs::recursive_directory_iterator(input_dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file() && it->path().extension() == ".tex") {
+            inputs.push_back(it->path());
+        }
+    }
+
+    int converted = 0;
+    int skipped = 0;
+    int failed = 0;
+    RunStats run;
+    auto start = std::chrono::steady_clock::now();
+    {
+        JournalWriter journal(journal_file, sync_every);
+        std::vector<uint8_t> output;
+
+        for (const fs::path& input : inputs) {
+            std::string relative = fs::relative(input, input_dir).generic_string();
+            fs::path output_path = output_dir / relative;
+
+            uint64_t input_size = 0;
+            int64_t input_mtime = 0;
+            bool identified = input_identity(input, &input_size, &input_mtime);
+            auto done = completed.find(relative);
+            if (identified && done != completed.end() &&
+                output_is_complete(output_path, done->second, input_size, input_mtime, options, verify_hash)) {
+                skipped++;
+                continue;
+            }
+
+            if (!convert_file(input, output, encode_flags, mips, run)) {
+                fprintf(stderr, "FAILED: %s\n", input.string().c_str());
+                failed++;
+                continue;
+            }
+
+            // Never leave a torn output under the real name: write a .tmp beside it, which the
+            // journal thread flushes and renames into place before journaling it
+            TEX_TRACE_SCOPE("io", "write_output");
+            auto write_start = std::chrono::steady_clock::now();
+            fs::create_directories(output_path.parent_path(), ec);
+            fs::path temp_path = output_path;
+            temp_path += ".tmp";
+            FILE* f = fopen(temp_path.string().c_str(), "wb");
+            bool written = f && fwrite(output.data(), 1, output.size(), f) == output.size();
+            if (f) {
+                written = fclose(f) == 0 && written;
+            }
+            if (!written) {
+                fprintf(stderr, "FAILED to write: %s\n", output_path.string().c_str());
+                fs::remove(temp_path, ec);
+                failed++;
+                continue;
+            }
+            run.write_ms += ms_since(write_start);
+            run.bytes_written += (long long)output.size();
+
+            // An input whose size or time could not be read is journaled with zeros, so it is
+            // converted again on the next run
+            JournalRecord record = {relative, fnv1a(output.data(), output.size()), (uint64_t)output.size(),
+                                    identified ? input_size : 0, identified ? input_mtime : 0, options};
+            journal.append({std::move(record), temp_path, output_path});
+            converted++;
+
+            auto estimate_start = std::chrono::steady_clock::now();
+            TexSizeEstimate estimate;
+            if (tex_estimate_compressed_size(output.data(), (long long)output.size(), &estimate) == TEX_OK) {
+                run.bytes_packed += estimate.predicted_bytes;
+                if (budget > 0 && estimate.predicted_bytes > budget) {
+                    printf("OVER BUDGET: %s (predicted %lld bytes packed, budget %lld)\n", relative.c_str(), estimate.predicted_bytes, budget);
+                    run.over_budget++;
+                }
+            }
+            run.estimate_ms += ms_since(estimate_start);
+        }
+
+        int uncommitted = journal.finish();
+        converted -= uncommitted;
+        failed += uncommitted;
+    }
+    fclose(journal_file);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Converted %d, skipped %d (already done), failed %d in %.2f s\n", converted, skipped, failed, seconds);
+    if (converted > 0) {
+        printf("  read    %9.1f ms, %.1f MB\n", run.read_ms, run.bytes_read / 1e6);
+        print_codec_stats("decode", run.decode);
+        print_codec_stats("encode", run.encode);
+        printf("  write   %9.1f ms, %.1f MB\n", run.write_ms, run.bytes_written / 1e6);
+        printf("  packed  %9.1f ms, %.1f MB predicted in a WAD (zstd)\n", run.estimate_ms, run.bytes_packed / 1e6);
+        if (budget > 0) {
+            printf("  %d outputs over the %lld byte budget\n", run.over_budget, budget);
+        }
+        printf("  peak scratch %.1f MB\n", run.peak_scratch_bytes / 1e6);
+    }
+#ifdef TEX_TRACE
+    if (trace_path && tex_trace_dump(trace_path) != TEX_OK) {
+        fprintf(stderr, "ERROR: cannot write trace %s\n", trace_path);
+    }
+#endif
+    if (failed) {
+        return 2;
+    }
+    return run.over_budget ? 4 : 0;
+}
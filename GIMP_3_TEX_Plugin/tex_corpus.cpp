@@ -0,0 +1,273 @@
+/*
+Deterministic synthetic texture corpus for benchmarks and quality tests
+*/
+
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "tex_corpus.h"
+
+static const char* KIND_NAMES[CORPUS_KIND_COUNT] = {
+    "gradient", "noise", "sprite", "alpha_edge", "normal_map", "tileable"
+};
+
+// splitmix64, used both as the seeded generator and as a coordinate hash
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+struct Rng {
+    uint64_t state;
+    explicit Rng(uint64_t seed) : state(seed) {}
+    uint64_t next() { return mix64(state++); }
+    int range(int lo, int hi) { return lo + (int)(next() % (uint64_t)(hi - lo + 1)); }
+};
+
+static uint64_t hash_pixel(uint64_t seed, int x, int y) {
+    return mix64(seed ^ ((uint64_t)(uint32_t)x << 32) ^ (uint32_t)y);
+}
+
+static uint8_t clamp_u8(int v) {
+    return (uint8_t)std::min(255, std::max(0, v));
+}
+
+// Integer sine, phase 0..65535 is one period, result in -32767..32767 (Bhaskara I)
+static int isin(uint32_t phase) {
+    phase &= 0xFFFF;
+    int64_t t = phase & 0x7FFF;
+    int64_t u = t * (32768 - t);
+    int64_t value = 32767 * 16 * u / (5LL * 32768 * 32768 - 4 * u);
+    return (phase & 0x8000) ? -(int)value : (int)value;
+}
+
+static void generate_gradient(uint64_t seed, int width, int height, uint8_t* rgba) {
+    Rng rng(seed);
+    uint8_t stops[3][4];
+    for (auto& stop : stops) {
+        for (int c = 0; c < 4; c++) {
+            stop[c] = (uint8_t)rng.range(0, 255);
+        }
+        stop[3] = (uint8_t)std::max<int>(stop[3], 128);
+    }
+    int dx = rng.range(-16, 16);
+    int dy = rng.range(1, 16);
+
+    // Project every pixel on (dx, dy) and map the projection range onto 0..65536
+    int64_t p0 = std::min<int64_t>(0, (int64_t)dx * (width - 1));
+    int64_t p1 = std::max<int64_t>(0, (int64_t)dx * (width - 1)) + (int64_t)dy * (height - 1);
+    int64_t span = std::max<int64_t>(p1 - p0, 1);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int64_t t = (((int64_t)x * dx + (int64_t)y * dy - p0) * 65536) / span;
+            const uint8_t* a = t < 32768 ? stops[0] : stops[1];
+            const uint8_t* b = t < 32768 ? stops[1] : stops[2];
+            int f = (int)(t < 32768 ? t * 2 : (t - 32768) * 2);
+            uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+            for (int c = 0; c < 4; c++) {
+                p[c] = (uint8_t)((a[c] * (65536 - f) + b[c] * f + 32768) >> 16);
+            }
+        }
+    }
+}
+
+static void generate_noise(uint64_t seed, int width, int height, uint8_t* rgba) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint64_t h = hash_pixel(seed, x, y);
+            uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+            memcpy(p, &h, 4);
+        }
+    }
+}
+
+static void generate_sprite(uint64_t seed, int width, int height, uint8_t* rgba) {
+    // Transparent background that still carries arbitrary RGB, like exported sprites do
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint64_t h = hash_pixel(seed, x, y);
+            uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+            p[0] = (uint8_t)h;
+            p[1] = (uint8_t)(h >> 8);
+            p[2] = (uint8_t)(h >> 16);
+            p[3] = 0;
+        }
+    }
+
+    Rng rng(seed);
+    int shape_count = rng.range(3, 8);
+    int size = std::min(width, height);
+    for (int s = 0; s < shape_count; s++) {
+        bool circle = rng.next() & 1;
+        double cx = rng.range(0, width - 1) + 0.5;
+        double cy = rng.range(0, height - 1) + 0.5;
+        double rx = std::max(1.0, size * rng.range(4, 20) / 100.0);
+        double ry = circle ? rx : std::max(1.0, size * rng.range(3, 12) / 100.0);
+        double corner = circle ? rx : std::min(rx, ry) * rng.range(10, 60) / 100.0;
+        double outline = std::max(1.0, size / 128.0);
+        uint8_t fill[3] = {(uint8_t)rng.range(0, 255), (uint8_t)rng.range(0, 255), (uint8_t)rng.range(0, 255)};
+
+        int x0 = std::max(0, (int)(cx - rx - 2)), x1 = std::min(width - 1, (int)(cx + rx + 2));
+        int y0 = std::max(0, (int)(cy - ry - 2)), y1 = std::min(height - 1, (int)(cy + ry + 2));
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                // Signed distance to a rounded rectangle (a circle when corner == radius)
+                double qx = std::fabs(x + 0.5 - cx) - (rx - corner);
+                double qy = std::fabs(y + 0.5 - cy) - (ry - corner);
+                double ox = std::max(qx, 0.0), oy = std::max(qy, 0.0);
+                double d = std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0) - corner;
+
+                double coverage = std::min(1.0, std::max(0.0, 0.5 - d));
+                if (coverage <= 0) {
+                    continue;
+                }
+                double edge = std::min(1.0, std::max(0.0, d + outline + 0.5));  // dark outline near the edge
+                uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+                int alpha = (int)(coverage * 255 + 0.5);
+                for (int c = 0; c < 3; c++) {
+                    int color = (int)(fill[c] * (1.0 - edge * 0.75) + 0.5);
+                    // Composite over what is already there
+                    p[c] = clamp_u8((color * alpha + p[c] * p[3] * (255 - alpha) / 255) / std::max(1, alpha + p[3] * (255 - alpha) / 255));
+                }
+                p[3] = clamp_u8(alpha + p[3] * (255 - alpha) / 255);
+            }
+        }
+    }
+}
+
+static void generate_alpha_edge(uint64_t seed, int width, int height, uint8_t* rgba) {
+    Rng rng(seed);
+    const int plane_count = 4;
+    int64_t nx[plane_count], ny[plane_count], offset[plane_count];
+    for (int i = 0; i < plane_count; i++) {
+        nx[i] = rng.range(-64, 64);
+        ny[i] = rng.range(-64, 64);
+        int px = rng.range(0, width - 1), py = rng.range(0, height - 1);
+        offset[i] = nx[i] * px + ny[i] * py;
+    }
+    uint8_t colors[1 << plane_count][3];
+    for (auto& color : colors) {
+        color[0] = (uint8_t)rng.range(0, 255);
+        color[1] = (uint8_t)rng.range(0, 255);
+        color[2] = (uint8_t)rng.range(0, 255);
+    }
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int region = 0;
+            for (int i = 0; i < plane_count; i++) {
+                region |= (nx[i] * x + ny[i] * y >= offset[i]) << i;
+            }
+            uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+            p[0] = colors[region][0];
+            p[1] = colors[region][1];
+            p[2] = colors[region][2];
+            p[3] = (__builtin_popcount(region) & 1) ? 255 : 0;
+        }
+    }
+}
+
+static void generate_normal_map(uint64_t seed, int width, int height, uint8_t* rgba) {
+    Rng rng(seed);
+    const int octaves = 4;
+    int fx[octaves], fy[octaves], phase_x[octaves], phase_y[octaves];
+    for (int i = 0; i < octaves; i++) {
+        // Whole cycles across the image so the map tiles, higher octaves are weaker
+        fx[i] = rng.range(1, 4) << i;
+        fy[i] = rng.range(1, 4) << i;
+        phase_x[i] = rng.range(0, 65535);
+        phase_y[i] = rng.range(0, 65535);
+    }
+
+    // Bump heights in pixels, scaled with the image so every size has similar slopes
+    double amplitude = std::max(width, height) / 32.0;
+    auto height_at = [&](int x, int y) {
+        int64_t h = 0;
+        for (int i = 0; i < octaves; i++) {
+            uint32_t tx = (uint32_t)((int64_t)fx[i] * x * 65536 / width + phase_x[i]);
+            uint32_t ty = (uint32_t)((int64_t)fy[i] * y * 65536 / height + phase_y[i]);
+            h += ((int64_t)isin(tx) * isin(ty)) >> i;
+        }
+        return amplitude * (double)h / (32767.0 * 32767.0);
+    };
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double dx = height_at(x + 1, y) - height_at(x - 1, y);
+            double dy = height_at(x, y + 1) - height_at(x, y - 1);
+            double nz = 2.0;  // central differences span two pixels
+            double length = std::sqrt(dx * dx + dy * dy + nz * nz);
+            uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+            p[0] = clamp_u8((int)((-dx / length * 0.5 + 0.5) * 255 + 0.5));
+            p[1] = clamp_u8((int)((-dy / length * 0.5 + 0.5) * 255 + 0.5));
+            p[2] = clamp_u8((int)((nz / length * 0.5 + 0.5) * 255 + 0.5));
+            p[3] = 255;
+        }
+    }
+}
+
+static void generate_tileable(uint64_t seed, int width, int height, uint8_t* rgba) {
+    Rng rng(seed);
+    // Whole numbers of periods across the image so the left/right and top/bottom edges meet
+    int kx[3], ky[3], phase[3];
+    for (int i = 0; i < 3; i++) {
+        kx[i] = rng.range(1, 6);
+        ky[i] = rng.range(1, 6);
+        phase[i] = rng.range(0, 65535);
+    }
+    int bricks_x = rng.range(2, 8), bricks_y = rng.range(2, 8);
+    uint8_t base[3] = {(uint8_t)rng.range(64, 192), (uint8_t)rng.range(64, 192), (uint8_t)rng.range(64, 192)};
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int wave[3];
+            for (int i = 0; i < 3; i++) {
+                uint32_t t = (uint32_t)((int64_t)kx[i] * x * 65536 / width + (int64_t)ky[i] * y * 65536 / height + phase[i]);
+                wave[i] = isin(t) / 512;  // -64..64
+            }
+            // Brick mortar lines on a grid that divides the image evenly
+            int row = (int)((int64_t)y * bricks_y / height);
+            int shift = (row & 1) ? width / (2 * bricks_x) : 0;
+            bool mortar = ((int64_t)y * bricks_y) % height < bricks_y * 2 ||
+                          ((int64_t)((x + shift) % width) * bricks_x) % width < bricks_x * 2;
+
+            uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+            for (int c = 0; c < 3; c++) {
+                p[c] = mortar ? (uint8_t)(base[c] / 3) : clamp_u8(base[c] + wave[c]);
+            }
+            p[3] = 255;
+        }
+    }
+}
+
+const char* corpus_kind_name(CorpusKind kind) {
+    return kind < CORPUS_KIND_COUNT ? KIND_NAMES[kind] : "unknown";
+}
+
+CorpusKind corpus_kind_from_name(const char* name) {
+    for (int i = 0; i < CORPUS_KIND_COUNT; i++) {
+        if (strcmp(name, KIND_NAMES[i]) == 0) {
+            return (CorpusKind)i;
+        }
+    }
+    return CORPUS_KIND_COUNT;
+}
+
+void corpus_generate(CorpusKind kind, uint64_t seed, int width, int height, uint8_t* rgba) {
+    // Different kinds never share a random stream for the same seed
+    uint64_t kind_seed = mix64(seed * CORPUS_KIND_COUNT + kind);
+    switch (kind) {
+        case CORPUS_GRADIENT:   generate_gradient(kind_seed, width, height, rgba); break;
+        case CORPUS_NOISE:      generate_noise(kind_seed, width, height, rgba); break;
+        case CORPUS_SPRITE:     generate_sprite(kind_seed, width, height, rgba); break;
+        case CORPUS_ALPHA_EDGE: generate_alpha_edge(kind_seed, width, height, rgba); break;
+        case CORPUS_NORMAL_MAP: generate_normal_map(kind_seed, width, height, rgba); break;
+        case CORPUS_TILEABLE:   generate_tileable(kind_seed, width, height, rgba); break;
+        default: memset(rgba, 0, (size_t)width * height * 4); break;
+    }
+}
@@ -0,0 +1,31 @@
+/*
+Deterministic synthetic texture corpus for benchmarks and quality tests
+The same (kind, seed, width, height) always produces the same pixels on every machine:
+only integer math and correctly rounded float operations are used, no libm transcendentals.
+*/
+
+#ifndef TEX_CORPUS_H
+#define TEX_CORPUS_H
+
+#include <cstdint>
+
+enum CorpusKind {
+    CORPUS_GRADIENT,    // smooth multi-stop gradients
+    CORPUS_NOISE,       // high frequency per pixel noise
+    CORPUS_SPRITE,      // UI sprite: shapes with soft edges on a large transparent area
+    CORPUS_ALPHA_EDGE,  // hard 0/255 alpha edges across colored regions
+    CORPUS_NORMAL_MAP,  // tangent space normals from a height field
+    CORPUS_TILEABLE,    // periodic pattern that wraps seamlessly at the image border
+    CORPUS_KIND_COUNT
+};
+
+// Short name used on command lines and in reports ("gradient", "noise", ...)
+const char* corpus_kind_name(CorpusKind kind);
+
+// Parse a kind name, returns CORPUS_KIND_COUNT when unknown
+CorpusKind corpus_kind_from_name(const char* name);
+
+// Fill width * height * 4 bytes of RGBA
+void corpus_generate(CorpusKind kind, uint64_t seed, int width, int height, uint8_t* rgba);
+
+#endif // TEX_CORPUS_H
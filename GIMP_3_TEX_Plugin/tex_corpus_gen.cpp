@@ -0,0 +1,133 @@
+/*
+Writes the synthetic texture corpus as BGRA8 .tex files
+
+Every kind is written at every power of two size from --min-size to --max-size plus a few
+odd sizes that are not multiples of 4. Output names are <kind>_<width>x<height>_s<seed>.tex.
+
+Compile with: g++ -O3 -march=native -fopenmp -o tex_corpus_gen.exe tex_corpus_gen.cpp tex_corpus.cpp dxt_compress.cpp tex_file.cpp tex_mip.cpp
+Usage: tex_corpus_gen <output_dir> [--seed N] [--min-size N] [--max-size N] [--kinds a,b,...]
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "dxt_compress.h"
+#include "tex_corpus.h"
+
+namespace fs = std::filesystem;
+
+static const int ODD_SIZES[][2] = {{3, 5}, {13, 7}, {100, 60}, {257, 129}};
+
+static bool write_bgra8_tex(const fs::path& path, const uint8_t* rgba, int width, int height) {
+    std::vector<uint8_t> bytes(12 + (size_t)width * height * 4);
+    const uint8_t header[12] = {
+        'T', 'E', 'X', 0,
+        (uint8_t)(width & 0xFF), (uint8_t)(width >> 8),
+        (uint8_t)(height & 0xFF), (uint8_t)(height >> 8),
+        1, TEX_FORMAT_BGRA8, 0, 0
+    };
+    memcpy(bytes.data(), header, 12);
+    size_t pixel_count = (size_t)width * height;
+    for (size_t i = 0; i < pixel_count; i++) {
+        bytes[12 + i * 4] = rgba[i * 4 + 2];
+        bytes[12 + i * 4 + 1] = rgba[i * 4 + 1];
+        bytes[12 + i * 4 + 2] = rgba[i * 4];
+        bytes[12 + i * 4 + 3] = rgba[i * 4 + 3];
+    }
+
+    FILE* f = fopen(path.string().c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    fclose(f);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <output_dir> [--seed N] [--min-size N] [--max-size N] [--kinds a,b,...]\n", argv[0]);
+        return 1;
+    }
+
+    fs::path output_dir = argv[1];
+    uint64_t seed = 1;
+    int min_size = 1;
+    int max_size = 2048;
+    std::vector<CorpusKind> kinds;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--min-size") == 0 && i + 1 < argc) {
+            min_size = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            max_size = std::min(8192, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--kinds") == 0 && i + 1 < argc) {
+            std::string list = argv[++i];
+            size_t start = 0;
+            while (start <= list.size()) {
+                size_t comma = list.find(',', start);
+                std::string name = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+                CorpusKind kind = corpus_kind_from_name(name.c_str());
+                if (kind == CORPUS_KIND_COUNT) {
+                    fprintf(stderr, "Unknown kind: %s\n", name.c_str());
+                    return 1;
+                }
+                kinds.push_back(kind);
+                if (comma == std::string::npos) {
+                    break;
+                }
+                start = comma + 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (kinds.empty()) {
+        for (int k = 0; k < CORPUS_KIND_COUNT; k++) {
+            kinds.push_back((CorpusKind)k);
+        }
+    }
+
+    std::vector<std::pair<int, int>> sizes;
+    for (int size = 1; size <= max_size; size *= 2) {
+        if (size >= min_size) {
+            sizes.push_back({size, size});
+        }
+    }
+    for (const auto& odd : ODD_SIZES) {
+        if (odd[0] <= max_size && odd[1] <= max_size) {
+            sizes.push_back({odd[0], odd[1]});
+        }
+    }
+
+    std::error_code ec;
+    fs::create_directories(output_dir, ec);
+
+    int written = 0;
+    std::vector<uint8_t> rgba;
+    for (CorpusKind kind : kinds) {
+        for (const auto& size : sizes) {
+            rgba.resize((size_t)size.first * size.second * 4);
+            corpus_generate(kind, seed, size.first, size.second, rgba.data());
+
+            char name[128];
+            snprintf(name, sizeof(name), "%s_%dx%d_s%llu.tex", corpus_kind_name(kind), size.first, size.second,
+                     (unsigned long long)seed);
+            if (!write_bgra8_tex(output_dir / name, rgba.data(), size.first, size.second)) {
+                fprintf(stderr, "ERROR: cannot write %s\n", (output_dir / name).string().c_str());
+                return 1;
+            }
+            written++;
+        }
+    }
+    printf("Wrote %d textures to %s\n", written, output_dir.string().c_str());
+    return 0;
+}
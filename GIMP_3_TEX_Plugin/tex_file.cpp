@@ -0,0 +1,199 @@
+/*
+TEX file layout helpers for the GIMP TEX plugin library
+Mirrors TEX.read() in gimp_tex_plugin_3.py so native tools can read mip levels directly
+*/
+
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+
+#include "dxt_compress.h"
+#include "tex_trace.h"
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Pixels per parallel chunk of the BGRA8 conversions; smaller images run on the calling thread
+static const long long SWIZZLE_CHUNK_PIXELS = 1 << 18;
+
+// Swap bytes 0 and 2 of every pixel in [begin, end). dst may equal src.
+static void swizzle_span(const uint8_t* src, uint8_t* dst, long long begin, long long end) {
+    long long i = begin;
+#ifdef __AVX2__
+    const __m256i order256 = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                              2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    for (; i + 8 <= end; i += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(pixels, order256));
+    }
+#endif
+#ifdef __SSSE3__
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    for (; i + 4 <= end; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(pixels, order));
+    }
+#endif
+    for (; i < end; i++) {
+        uint32_t pixel;
+        memcpy(&pixel, src + i * 4, 4);
+        pixel = (pixel & 0xFF00FF00u) | ((pixel >> 16) & 0xFFu) | ((pixel & 0xFFu) << 16);
+        memcpy(dst + i * 4, &pixel, 4);
+    }
+}
+
+// BGRA to RGBA with the color divided by alpha
+static void unpremultiply_swizzle_span(const uint8_t* src, uint8_t* dst, long long begin, long long end) {
+    for (long long i = begin; i < end; i++) {
+        uint8_t blue = src[i * 4];
+        uint8_t green = src[i * 4 + 1];
+        uint8_t red = src[i * 4 + 2];
+        uint8_t alpha = src[i * 4 + 3];
+        dst[i * 4] = tex_unpremultiply_channel(red, alpha);
+        dst[i * 4 + 1] = tex_unpremultiply_channel(green, alpha);
+        dst[i * 4 + 2] = tex_unpremultiply_channel(blue, alpha);
+        dst[i * 4 + 3] = alpha;
+    }
+}
+
+// Runs span(src, dst, begin, end) over the image in chunks, in parallel when there is more
+// than one chunk. Returns the number of threads that ran.
+template <typename SpanFn>
+static int for_each_pixel_chunk(const uint8_t* src, uint8_t* dst, long long pixel_count, SpanFn span) {
+    long long chunks = (pixel_count + SWIZZLE_CHUNK_PIXELS - 1) / SWIZZLE_CHUNK_PIXELS;
+    int threads = 1;
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static) reduction(max:threads) if (chunks > 1)
+    #endif
+    for (long long chunk = 0; chunk < chunks; chunk++) {
+        long long begin = chunk * SWIZZLE_CHUNK_PIXELS;
+        span(src, dst, begin, std::min(pixel_count, begin + SWIZZLE_CHUNK_PIXELS));
+        #ifdef _OPENMP
+        threads = std::max(threads, omp_get_num_threads());
+        #endif
+    }
+    return threads;
+}
+
+void tex_bgra8_to_rgba_span(const uint8_t* src, uint8_t* dst, long long begin, long long end, bool unpremultiply) {
+    if (unpremultiply) {
+        unpremultiply_swizzle_span(src, dst, begin, end);
+    } else {
+        swizzle_span(src, dst, begin, end);
+    }
+}
+
+// Parse the 12 byte TEX header ("TEX\0", u16 width, u16 height, u8, u8 format, u8, bool mipmaps)
+int tex_parse_header(const uint8_t* bytes, TexHeader* header) {
+    TEX_TRACE_SCOPE("parse", "header_parse");
+    uint32_t signature = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    if (signature != 0x00584554) {  // "TEX\0"
+        return TEX_ERR_FORMAT;
+    }
+
+    header->width = bytes[4] | (bytes[5] << 8);
+    header->height = bytes[6] | (bytes[7] << 8);
+    header->format = bytes[9];
+    header->mipmaps = bytes[11] != 0;
+
+    if (header->width <= 0 || header->height <= 0) {
+        return TEX_ERR_FORMAT;
+    }
+    if (tex_level_size(header->format, header->width, header->height) < 0) {
+        return TEX_ERR_FORMAT;
+    }
+    return TEX_OK;
+}
+
+// Byte offset of a mip level inside the data section (levels are stored smallest first)
+long long tex_level_offset(const TexHeader& header, int level) {
+    if (!header.mipmaps) {
+        return 0;
+    }
+
+    int mipmap_count = tex_mipmap_count(header.width, header.height);
+    long long offset = 0;
+    for (int i = mipmap_count - 1; i > level; i--) {
+        int level_width = std::max(header.width >> i, 1);
+        int level_height = std::max(header.height >> i, 1);
+        offset += tex_level_size(header.format, level_width, level_height);
+    }
+    return offset;
+}
+
+extern "C" {
+
+// Number of mip levels for a mipmapped texture (bit length of the larger side)
+__declspec(dllexport) int tex_mipmap_count(int width, int height) {
+    int size = std::max(width, height);
+    int count = 0;
+    while (size > 0) {
+        count++;
+        size >>= 1;
+    }
+    return count;
+}
+
+// Size in bytes of one mip level, or -1 for unsupported formats
+__declspec(dllexport) long long tex_level_size(int format, int width, int height) {
+    const TexCodecDescriptor* codec = tex_find_codec(format);
+    if (!codec) {
+        return -1;
+    }
+    long long blocks_x = (width + codec->block_dim - 1) / codec->block_dim;
+    long long blocks_y = (height + codec->block_dim - 1) / codec->block_dim;
+    return blocks_x * blocks_y * codec->block_bytes;
+}
+
+// Decode one mip level of any supported format to RGBA
+__declspec(dllexport) int tex_decode_level_ex(int format, const uint8_t* data, int width, int height, uint8_t* rgba, int flags, TexStats* stats) {
+    switch (format) {
+        case TEX_FORMAT_DXT1:
+            decompress_dxt1_ex(data, width, height, rgba, flags, stats);
+            return TEX_OK;
+        case TEX_FORMAT_DXT5:
+            decompress_dxt5_ex(data, width, height, rgba, flags, stats);
+            return TEX_OK;
+        case TEX_FORMAT_BGRA8: {
+            TEX_TRACE_SCOPE("codec", "swizzle_bgra8");
+            auto start = std::chrono::steady_clock::now();
+            long long pixel_count = (long long)width * height;
+            int threads = (flags & TEX_FLAG_PREMULTIPLIED)
+                              ? for_each_pixel_chunk(data, rgba, pixel_count, unpremultiply_swizzle_span)
+                              : for_each_pixel_chunk(data, rgba, pixel_count, swizzle_span);
+            if (stats) {
+                memset(stats, 0, sizeof(*stats));
+                stats->total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                stats->threads = threads;
+                stats->bytes_read = pixel_count * 4;
+                stats->bytes_written = pixel_count * 4;
+            }
+            return TEX_OK;
+        }
+        default:
+            return TEX_ERR_FORMAT;
+    }
+}
+
+// Swap the red and blue channels: BGRA8 to RGBA and back. src and dst may be the same buffer
+// but must not otherwise overlap.
+__declspec(dllexport) void tex_swizzle_bgra(const uint8_t* src, uint8_t* dst, long long pixel_count) {
+    TEX_TRACE_SCOPE("codec", "swizzle_bgra");
+    if (!src || !dst || pixel_count <= 0) {
+        return;
+    }
+    for_each_pixel_chunk(src, dst, pixel_count, swizzle_span);
+}
+
+__declspec(dllexport) int tex_decode_level(int format, const uint8_t* data, int width, int height, uint8_t* rgba) {
+    return tex_decode_level_ex(format, data, width, height, rgba, 0, nullptr);
+}
+
+} // extern "C"
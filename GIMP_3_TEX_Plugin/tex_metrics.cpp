@@ -0,0 +1,182 @@
+/*
+Image quality metrics for comparing decoded textures against their source
+Inner loops are plain integer accumulations over a row so the compiler vectorizes them;
+rows are spread over threads with OpenMP.
+*/
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "tex_metrics.h"
+
+static double psnr_from_sse(double sse, double samples) {
+    if (sse <= 0 || samples <= 0) {
+        return 99.0;
+    }
+    double mse = sse / samples;
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// Sum of squared differences over channels first_channel .. first_channel + channel_count - 1
+static double channel_sse(const uint8_t* a, const uint8_t* b, int width, int height, int first_channel, int channel_count) {
+    double total = 0;
+
+    #ifdef _OPENMP
+    #pragma omp parallel for reduction(+:total) schedule(static)
+    #endif
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row_a = a + (size_t)y * width * 4;
+        const uint8_t* row_b = b + (size_t)y * width * 4;
+        uint64_t row_sse = 0;
+        for (int i = 0; i < width * 4; i++) {
+            int channel = i & 3;
+            int d = row_a[i] - row_b[i];
+            row_sse += (channel >= first_channel && channel < first_channel + channel_count) ? (uint32_t)(d * d) : 0;
+        }
+        total += (double)row_sse;
+    }
+    return total;
+}
+
+double tex_psnr_rgb(const uint8_t* a, const uint8_t* b, int width, int height) {
+    double sse = channel_sse(a, b, width, height, 0, 3);
+    return psnr_from_sse(sse, (double)width * height * 3);
+}
+
+double tex_psnr_alpha(const uint8_t* a, const uint8_t* b, int width, int height) {
+    double sse = channel_sse(a, b, width, height, 3, 1);
+    return psnr_from_sse(sse, (double)width * height);
+}
+
+static void to_luma(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& luma) {
+    luma.resize((size_t)width * height);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = rgba + (size_t)y * width * 4;
+        uint8_t* out = &luma[(size_t)y * width];
+        for (int x = 0; x < width; x++) {
+            out[x] = (uint8_t)((77 * row[x * 4] + 150 * row[x * 4 + 1] + 29 * row[x * 4 + 2] + 128) >> 8);
+        }
+    }
+}
+
+double tex_ssim(const uint8_t* a, const uint8_t* b, int width, int height) {
+    const int window = 8;
+    const int step = 4;
+    const double c1 = (0.01 * 255) * (0.01 * 255);
+    const double c2 = (0.03 * 255) * (0.03 * 255);
+
+    std::vector<uint8_t> luma_a, luma_b;
+    to_luma(a, width, height, luma_a);
+    to_luma(b, width, height, luma_b);
+
+    // Images smaller than one window are measured as a single window
+    int win_w = std::min(window, width);
+    int win_h = std::min(window, height);
+    int windows_x = (width - win_w) / step + 1;
+    int windows_y = (height - win_h) / step + 1;
+    double n = (double)win_w * win_h;
+
+    double total = 0;
+    #ifdef _OPENMP
+    #pragma omp parallel for reduction(+:total) schedule(static)
+    #endif
+    for (int wy = 0; wy < windows_y; wy++) {
+        for (int wx = 0; wx < windows_x; wx++) {
+            uint32_t sum_a = 0, sum_b = 0, sum_aa = 0, sum_bb = 0, sum_ab = 0;
+            for (int y = wy * step; y < wy * step + win_h; y++) {
+                const uint8_t* row_a = &luma_a[(size_t)y * width + wx * step];
+                const uint8_t* row_b = &luma_b[(size_t)y * width + wx * step];
+                for (int x = 0; x < win_w; x++) {
+                    uint32_t va = row_a[x], vb = row_b[x];
+                    sum_a += va;
+                    sum_b += vb;
+                    sum_aa += va * va;
+                    sum_bb += vb * vb;
+                    sum_ab += va * vb;
+                }
+            }
+            double mean_a = sum_a / n, mean_b = sum_b / n;
+            double var_a = sum_aa / n - mean_a * mean_a;
+            double var_b = sum_bb / n - mean_b * mean_b;
+            double cov = sum_ab / n - mean_a * mean_b;
+            total += ((2 * mean_a * mean_b + c1) * (2 * cov + c2)) /
+                     ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+        }
+    }
+    return total / ((double)windows_x * windows_y);
+}
+
+// ============================================================================
+// Standard BC3 decode
+// ============================================================================
+
+static void expand_565(uint16_t color, int rgb[3]) {
+    int r = color >> 11, g = (color >> 5) & 0x3F, b = color & 0x1F;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+void tex_decode_dxt5_standard(const uint8_t* blocks, int width, int height, uint8_t* rgba) {
+    int blocks_x = (width + 3) / 4;
+    int blocks_y = (height + 3) / 4;
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (int by = 0; by < blocks_y; by++) {
+        for (int bx = 0; bx < blocks_x; bx++) {
+            const uint8_t* block = blocks + ((size_t)by * blocks_x + bx) * 16;
+
+            int alpha[8] = {block[0], block[1]};
+            if (alpha[0] > alpha[1]) {
+                for (int i = 1; i < 7; i++) {
+                    alpha[i + 1] = ((7 - i) * alpha[0] + i * alpha[1]) / 7;
+                }
+            } else {
+                for (int i = 1; i < 5; i++) {
+                    alpha[i + 1] = ((5 - i) * alpha[0] + i * alpha[1]) / 5;
+                }
+                alpha[6] = 0;
+                alpha[7] = 255;
+            }
+            uint64_t alpha_bits = 0;
+            for (int i = 0; i < 6; i++) {
+                alpha_bits |= (uint64_t)block[2 + i] << (8 * i);
+            }
+
+            int palette[4][3];
+            expand_565((uint16_t)(block[8] | (block[9] << 8)), palette[0]);
+            expand_565((uint16_t)(block[10] | (block[11] << 8)), palette[1]);
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            uint32_t color_bits = block[12] | (block[13] << 8) | (block[14] << 16) | ((uint32_t)block[15] << 24);
+
+            for (int i = 0; i < 16; i++) {
+                int x = bx * 4 + (i & 3);
+                int y = by * 4 + (i >> 2);
+                if (x >= width || y >= height) {
+                    continue;
+                }
+                uint8_t* out = rgba + ((size_t)y * width + x) * 4;
+                const int* color = palette[(color_bits >> (2 * i)) & 3];
+                out[0] = (uint8_t)color[0];
+                out[1] = (uint8_t)color[1];
+                out[2] = (uint8_t)color[2];
+                out[3] = (uint8_t)alpha[(alpha_bits >> (3 * i)) & 7];
+            }
+        }
+    }
+}
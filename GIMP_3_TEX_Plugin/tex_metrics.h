@@ -0,0 +1,25 @@
+/*
+Image quality metrics for comparing decoded textures against their source
+All functions take two RGBA images of the same size and run in parallel over rows.
+*/
+
+#ifndef TEX_METRICS_H
+#define TEX_METRICS_H
+
+#include <cstdint>
+
+// PSNR in dB over the R, G and B channels (alpha ignored). Identical images give 99.
+double tex_psnr_rgb(const uint8_t* a, const uint8_t* b, int width, int height);
+
+// PSNR in dB over the alpha channel only
+double tex_psnr_alpha(const uint8_t* a, const uint8_t* b, int width, int height);
+
+// Mean SSIM of the luma channel over 8x8 windows placed every 4 pixels
+double tex_ssim(const uint8_t* a, const uint8_t* b, int width, int height);
+
+// Decodes DXT5 blocks the way GPUs and standard BC3 decoders do: 565 endpoints expanded with
+// bit replication, interpolated entries rounded down. Quality is scored on this decode, not on
+// the library's own shift-only one, so every encoder is judged by what players will see.
+void tex_decode_dxt5_standard(const uint8_t* blocks, int width, int height, uint8_t* rgba);
+
+#endif // TEX_METRICS_H
@@ -0,0 +1,374 @@
+/*
+Mip level generation for the GIMP TEX plugin library
+Every level halves both sides of the one above (never below 1 pixel), matching the level sizes
+tex_mipmap_count and tex_level_offset assume, with a 2x2 box filter
+Alpha bleeding gives fully transparent pixels the color of the nearest visible one, found by
+jump flooding each tile, so their arbitrary RGB cannot pull DXT endpoints or mip averages
+*/
+
+#include <cstdint>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "dxt_compress.h"
+#include "tex_trace.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Output rows per parallel chunk; smaller levels run on the calling thread
+static const int DOWNSAMPLE_CHUNK_ROWS = 64;
+
+// Output rows [y_begin, y_end) of the next level. A side that is already 1 pixel (or odd at
+// the end) reuses its last source row / column, so every output pixel averages 4 samples.
+static void downsample_rows(const uint8_t* src, int width, int height, uint8_t* dst, int dst_width, int y_begin, int y_end) {
+    for (int y = y_begin; y < y_end; y++) {
+        const uint8_t* row0 = src + (size_t)std::min(y * 2, height - 1) * width * 4;
+        const uint8_t* row1 = src + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+        uint8_t* out = dst + (size_t)y * dst_width * 4;
+        for (int x = 0; x < dst_width; x++) {
+            int x0 = std::min(x * 2, width - 1) * 4;
+            int x1 = std::min(x * 2 + 1, width - 1) * 4;
+            for (int c = 0; c < 4; c++) {
+                out[x * 4 + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Alpha bleeding
+// ============================================================================
+
+// Side of the square tiles bled in parallel; each floods a window reaching radius pixels past it
+static const int BLEED_TILE = 128;
+static const int BLEED_DEFAULT_RADIUS = 16;
+static const int BLEED_MAX_RADIUS = 1024;
+
+// Window cells are flooded in 8x8 groups; groups with no visible pixel within twice the radius
+// (the farthest a jump chain toward a cell in reach can wander) are skipped
+static const int FLOOD_GROUP_SHIFT = 3;
+
+// Window cells hold the nearest visible pixel found so far as x | y << 16 in window
+// coordinates, or -1 for none yet
+static inline int seed_distance(int32_t seed, int x, int y) {
+    int dx = (seed & 0xFFFF) - x;
+    int dy = (seed >> 16) - y;
+    return dx * dx + dy * dy;
+}
+
+struct FloodWindow {
+    int width;
+    int height;
+    const uint8_t* active;  // per cell group
+    int groups_x;
+
+    bool is_active(int x, int y) const {
+        return active[(y >> FLOOD_GROUP_SHIFT) * groups_x + (x >> FLOOD_GROUP_SHIFT)] != 0;
+    }
+};
+
+// Cells [x_begin, x_end) of row y: keep the closest of the current seed and the seeds step cells
+// away in the 8 directions, earlier candidates winning ties
+static void flood_cells(const FloodWindow& w, const int32_t* src, int32_t* dst, int step, int y, int x_begin, int x_end) {
+    for (int x = x_begin; x < x_end; x++) {
+        int32_t best = src[(size_t)y * w.width + x];
+        int best_distance = best >= 0 ? seed_distance(best, x, y) : INT_MAX;
+        if (best_distance == 0 || !w.is_active(x, y)) {
+            dst[(size_t)y * w.width + x] = best;
+            continue;
+        }
+        for (int dy = -step; dy <= step; dy += step) {
+            int ny = y + dy;
+            if (ny < 0 || ny >= w.height) {
+                continue;
+            }
+            for (int dx = -step; dx <= step; dx += step) {
+                int nx = x + dx;
+                if ((dx == 0 && dy == 0) || nx < 0 || nx >= w.width) {
+                    continue;
+                }
+                int32_t seed = src[(size_t)ny * w.width + nx];
+                if (seed >= 0) {
+                    int distance = seed_distance(seed, x, y);
+                    if (distance < best_distance) {
+                        best = seed;
+                        best_distance = distance;
+                    }
+                }
+            }
+        }
+        dst[(size_t)y * w.width + x] = best;
+    }
+}
+
+// One jump flooding pass over the window. With vector set (and AVX2 built in), groups whose
+// horizontal neighbours all lie inside the row go 8 cells at a time; the vector and scalar
+// paths make the same choices, which dxt_fuzz checks through tex_alpha_bleed_variant.
+static void flood_pass(const FloodWindow& w, const int32_t* src, int32_t* dst, int step, bool vector) {
+    for (int y = 0; y < w.height; y++) {
+        int x = 0;
+#ifdef __AVX2__
+        if (!vector) {
+            flood_cells(w, src, dst, step, y, 0, w.width);
+            continue;
+        }
+        int x_end = std::min((step + 7) & ~7, w.width);
+        flood_cells(w, src, dst, step, y, 0, x_end);
+        x = x_end;
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i none = _mm256_set1_epi32(-1);
+        const __m256i far = _mm256_set1_epi32(INT_MAX);
+        for (; x + 8 + step <= w.width; x += 8) {
+            __m256i best = _mm256_loadu_si256((const __m256i*)(src + (size_t)y * w.width + x));
+            if (!w.is_active(x, y)) {
+                _mm256_storeu_si256((__m256i*)(dst + (size_t)y * w.width + x), best);
+                continue;
+            }
+            // Cell and seed are both x | y << 16, so one 16 bit subtract and a multiply-add give dx^2 + dy^2
+            __m256i cell = _mm256_add_epi32(_mm256_set1_epi32(x | y << 16), lanes);
+            auto distance = [&](__m256i seed) {
+                __m256i delta = _mm256_sub_epi16(seed, cell);
+                return _mm256_madd_epi16(delta, delta);
+            };
+            __m256i best_distance = _mm256_blendv_epi8(distance(best), far, _mm256_cmpeq_epi32(best, none));
+            if (_mm256_testz_si256(best_distance, best_distance)) {
+                _mm256_storeu_si256((__m256i*)(dst + (size_t)y * w.width + x), best);
+                continue;
+            }
+            for (int dy = -step; dy <= step; dy += step) {
+                int ny = y + dy;
+                if (ny < 0 || ny >= w.height) {
+                    continue;
+                }
+                for (int dx = -step; dx <= step; dx += step) {
+                    if (dx == 0 && dy == 0) {
+                        continue;
+                    }
+                    __m256i seed = _mm256_loadu_si256((const __m256i*)(src + (size_t)ny * w.width + x + dx));
+                    __m256i d = distance(seed);
+                    __m256i closer = _mm256_andnot_si256(_mm256_cmpeq_epi32(seed, none), _mm256_cmpgt_epi32(best_distance, d));
+                    best = _mm256_blendv_epi8(best, seed, closer);
+                    best_distance = _mm256_blendv_epi8(best_distance, d, closer);
+                }
+            }
+            _mm256_storeu_si256((__m256i*)(dst + (size_t)y * w.width + x), best);
+        }
+#else
+        (void)vector;
+#endif
+        flood_cells(w, src, dst, step, y, x, w.width);
+    }
+}
+
+// active[g] = any visible group within reach groups of g (Chebyshev); visible and rows are
+// groups_x x groups_y scratch
+static void mark_active_groups(const uint8_t* visible, uint8_t* rows, uint8_t* active, int groups_x, int groups_y, int reach) {
+    for (int gy = 0; gy < groups_y; gy++) {
+        for (int gx = 0; gx < groups_x; gx++) {
+            uint8_t any = 0;
+            for (int x = std::max(0, gx - reach); x <= std::min(groups_x - 1, gx + reach); x++) {
+                any |= visible[gy * groups_x + x];
+            }
+            rows[gy * groups_x + gx] = any;
+        }
+    }
+    for (int gy = 0; gy < groups_y; gy++) {
+        for (int gx = 0; gx < groups_x; gx++) {
+            uint8_t any = 0;
+            for (int y = std::max(0, gy - reach); y <= std::min(groups_y - 1, gy + reach); y++) {
+                any |= rows[y * groups_x + gx];
+            }
+            active[gy * groups_x + gx] = any;
+        }
+    }
+}
+
+// Sums of the visible pixels' color, and whether any pixel is fully transparent
+struct BleedTotals {
+    long long sum[3];
+    long long visible;
+    bool any_transparent;
+};
+
+static BleedTotals bleed_totals(const uint8_t* rgba, long long pixel_count) {
+    long long r = 0, g = 0, b = 0, visible = 0;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static) reduction(+ : r, g, b, visible) if (pixel_count > (1 << 18))
+    #endif
+    for (long long i = 0; i < pixel_count; i++) {
+        const uint8_t* p = rgba + i * 4;
+        if (p[3]) {
+            r += p[0];
+            g += p[1];
+            b += p[2];
+            visible++;
+        }
+    }
+    return BleedTotals{{r, g, b}, visible, visible < pixel_count};
+}
+
+// Per thread scratch of bleed_tile: two cell buffers and three group maps for the window
+static size_t bleed_scratch_bytes(int radius) {
+    size_t side = (size_t)BLEED_TILE + 2 * radius;
+    size_t group_side = (side + (1 << FLOOD_GROUP_SHIFT) - 1) >> FLOOD_GROUP_SHIFT;
+    return 2 * side * side * sizeof(int32_t) + 3 * group_side * group_side;
+}
+
+// Bleeds the transparent pixels of one tile. Only transparent RGB is written and only visible
+// pixels are read from, so tiles can run concurrently.
+static void bleed_tile(uint8_t* rgba, int width, int height, int tile_x, int tile_y, int radius, const uint8_t fill[3],
+                       uint8_t* scratch, bool vector) {
+    int x0 = tile_x * BLEED_TILE, x1 = std::min(width, x0 + BLEED_TILE);
+    int y0 = tile_y * BLEED_TILE, y1 = std::min(height, y0 + BLEED_TILE);
+    bool any_transparent = false;
+    for (int y = y0; y < y1 && !any_transparent; y++) {
+        for (int x = x0; x < x1; x++) {
+            if (rgba[((size_t)y * width + x) * 4 + 3] == 0) {
+                any_transparent = true;
+                break;
+            }
+        }
+    }
+    if (!any_transparent) {
+        return;
+    }
+
+    int wx0 = std::max(0, x0 - radius), wx1 = std::min(width, x1 + radius);
+    int wy0 = std::max(0, y0 - radius), wy1 = std::min(height, y1 + radius);
+    int window_width = wx1 - wx0, window_height = wy1 - wy0;
+    size_t window_cells = (size_t)window_width * window_height;
+    int groups_x = (window_width + (1 << FLOOD_GROUP_SHIFT) - 1) >> FLOOD_GROUP_SHIFT;
+    int groups_y = (window_height + (1 << FLOOD_GROUP_SHIFT) - 1) >> FLOOD_GROUP_SHIFT;
+    size_t groups = (size_t)groups_x * groups_y;
+    int32_t* current = (int32_t*)scratch;
+    int32_t* next = current + window_cells;
+    uint8_t* visible_groups = (uint8_t*)(next + window_cells);
+    uint8_t* active = visible_groups + groups;
+    memset(visible_groups, 0, groups);
+    bool any_visible = false;
+    for (int y = 0; y < window_height; y++) {
+        const uint8_t* row = rgba + ((size_t)(wy0 + y) * width + wx0) * 4;
+        uint8_t* group_row = visible_groups + (y >> FLOOD_GROUP_SHIFT) * groups_x;
+        for (int x = 0; x < window_width; x++) {
+            bool visible = row[x * 4 + 3] != 0;
+            current[(size_t)y * window_width + x] = visible ? (x | y << 16) : -1;
+            group_row[x >> FLOOD_GROUP_SHIFT] |= visible;
+            any_visible |= visible;
+        }
+    }
+
+    if (any_visible) {
+        int reach = (2 * radius + (1 << FLOOD_GROUP_SHIFT) - 1) >> FLOOD_GROUP_SHIFT;
+        mark_active_groups(visible_groups, active + groups, active, groups_x, groups_y, reach);
+        FloodWindow window = {window_width, window_height, active, groups_x};
+        int step = 1;
+        while (step * 2 <= radius) {
+            step *= 2;
+        }
+        for (; step >= 1; step /= 2) {
+            flood_pass(window, current, next, step, vector);
+            std::swap(current, next);
+        }
+    }
+
+    int radius_squared = radius * radius;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            uint8_t* p = rgba + ((size_t)y * width + x) * 4;
+            if (p[3] != 0) {
+                continue;
+            }
+            int32_t seed = any_visible ? current[(size_t)(y - wy0) * window_width + (x - wx0)] : -1;
+            const uint8_t* color = fill;
+            if (seed >= 0 && seed_distance(seed, x - wx0, y - wy0) <= radius_squared) {
+                color = rgba + ((size_t)(wy0 + (seed >> 16)) * width + wx0 + (seed & 0xFFFF)) * 4;
+            }
+            p[0] = color[0];
+            p[1] = color[1];
+            p[2] = color[2];
+        }
+    }
+}
+
+extern "C" {
+
+// Next smaller mip level of a 4 channel image: dst is max(width / 2, 1) x max(height / 2, 1)
+__declspec(dllexport) void tex_downsample_mip(const uint8_t* src, int width, int height, uint8_t* dst) {
+    TEX_TRACE_SCOPE("mip", "downsample");
+    int dst_width = std::max(width >> 1, 1);
+    int dst_height = std::max(height >> 1, 1);
+    int chunks = (dst_height + DOWNSAMPLE_CHUNK_ROWS - 1) / DOWNSAMPLE_CHUNK_ROWS;
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if (chunks > 1)
+    #endif
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        int y_begin = chunk * DOWNSAMPLE_CHUNK_ROWS;
+        downsample_rows(src, width, height, dst, dst_width, y_begin, std::min(dst_height, y_begin + DOWNSAMPLE_CHUNK_ROWS));
+    }
+}
+
+} // extern "C"
+
+int tex_alpha_bleed_variant(uint8_t* rgba, int width, int height, int radius, bool vector) {
+    TEX_TRACE_SCOPE("mip", "alpha_bleed");
+    if (!rgba || width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF || radius < 0 || radius > BLEED_MAX_RADIUS) {
+        return TEX_ERR_ARGS;
+    }
+    if (radius == 0) {
+        radius = BLEED_DEFAULT_RADIUS;
+    }
+    BleedTotals totals = bleed_totals(rgba, (long long)width * height);
+    if (!totals.any_transparent || totals.visible == 0) {
+        return TEX_OK;
+    }
+    uint8_t fill[3];
+    for (int c = 0; c < 3; c++) {
+        fill[c] = (uint8_t)((totals.sum[c] + totals.visible / 2) / totals.visible);
+    }
+
+    int tiles_x = (width + BLEED_TILE - 1) / BLEED_TILE;
+    int tiles_y = (height + BLEED_TILE - 1) / BLEED_TILE;
+    int tiles = tiles_x * tiles_y;
+    size_t scratch_bytes = bleed_scratch_bytes(radius);
+    bool failed = false;
+
+    #ifdef _OPENMP
+    #pragma omp parallel if (tiles > 1)
+    #endif
+    {
+        TexBuffer scratch(scratch_bytes);
+        if (!scratch.ok()) {
+            #ifdef _OPENMP
+            #pragma omp atomic write
+            #endif
+            failed = true;
+        }
+        #ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+        #endif
+        for (int tile = 0; tile < tiles; tile++) {
+            if (scratch.ok()) {
+                bleed_tile(rgba, width, height, tile % tiles_x, tile / tiles_x, radius, fill, scratch.data(), vector);
+            }
+        }
+    }
+    return failed ? TEX_ERR_NOMEM : TEX_OK;
+}
+
+extern "C" {
+
+// Transparent pixels within radius of a visible one take its color, the rest the mean visible
+// color. Tiles are flooded independently, so the result does not depend on the thread count.
+__declspec(dllexport) int tex_alpha_bleed(uint8_t* rgba, int width, int height, int radius) {
+    return tex_alpha_bleed_variant(rgba, width, height, radius, true);
+}
+
+} // extern "C"
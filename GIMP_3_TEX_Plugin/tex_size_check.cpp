@@ -0,0 +1,233 @@
+/*
+Checks tex_estimate_compressed_size against zstd
+
+Every corpus kind at seed 3 (the seed the estimator's model was not fitted on), at 64 - 1024
+pixels plus the odd sizes, is written as DXT5 (compress_dxt5), DXT1 (the color half of those
+blocks) and BGRA8 TEX data, estimated, and compared with its zstd level 3 size:
+  every file    within 25 % or 8 KB of zstd
+  every format  mean error within 8 % over the files that compress to 4 KB or more
+The zstd sizes are checked in below (REFERENCE_SIZES, zstd 1.5.4) so the check runs without
+zstd. Built with -DTEX_SIZE_CHECK_ZSTD and -lzstd it compresses the files itself instead, and
+--print-table writes the table to paste back here; do that whenever compress_dxt5's output
+changes. Exit status 1 when a tolerance is exceeded.
+
+Compile with: g++ -O3 -march=native -fopenmp -o tex_size_check.exe tex_size_check.cpp tex_corpus.cpp dxt_compress.cpp tex_file.cpp tex_mip.cpp tex_trace.cpp tex_alloc.cpp tex_size_estimate.cpp
+Usage: tex_size_check [--verbose] [--print-table]
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#ifdef TEX_SIZE_CHECK_ZSTD
+#include <zstd.h>
+#endif
+
+#include "dxt_compress.h"
+#include "tex_corpus.h"
+
+static const uint64_t SEED = 3;
+static const int SIZES[][2] = {{64, 64}, {128, 128}, {256, 256}, {512, 512}, {1024, 1024},
+                               {3, 5}, {13, 7}, {100, 60}, {257, 129}};
+static const int SIZE_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+
+static const double FILE_TOLERANCE = 0.25;
+static const long long FILE_TOLERANCE_BYTES = 8 * 1024;
+static const double MEAN_TOLERANCE = 0.08;
+static const long long MEAN_MIN_BYTES = 4 * 1024;
+
+struct FormatInfo {
+    const char* name;
+    int format;
+};
+
+static const FormatInfo FORMATS[] = {
+    {"dxt5", TEX_FORMAT_DXT5},
+    {"dxt1", TEX_FORMAT_DXT1},
+    {"bgra8", TEX_FORMAT_BGRA8},
+};
+static const int FORMAT_COUNT = sizeof(FORMATS) / sizeof(FORMATS[0]);
+
+// zstd 1.5.4 level 3 sizes of the files, in CorpusKind then SIZES order, columns as FORMATS
+static const long long REFERENCE_SIZES[CORPUS_KIND_COUNT * SIZE_COUNT][FORMAT_COUNT] = {
+    {2276, 1091, 2789},  // gradient 64x64
+    {4826, 1960, 4716},  // gradient 128x128
+    {8876, 3387, 10865},  // gradient 256x256
+    {12607, 4486, 29618},  // gradient 512x512
+    {21537, 6510, 72955},  // gradient 1024x1024
+    {53, 37, 81},  // gradient 3x5
+    {149, 85, 386},  // gradient 13x7
+    {3276, 1417, 3189},  // gradient 100x60
+    {7223, 2781, 6103},  // gradient 257x129
+    {4118, 2070, 16406},  // noise 64x64
+    {16406, 8052, 65558},  // noise 128x128
+    {65558, 31913, 262174},  // noise 256x256
+    {262174, 127350, 1048624},  // noise 512x512
+    {1048624, 509317, 4194425},  // noise 1024x1024
+    {53, 37, 81},  // noise 3x5
+    {149, 85, 386},  // noise 13x7
+    {6022, 3022, 24022},  // noise 100x60
+    {33725, 16639, 132639},  // noise 257x129
+    {2340, 2070, 13587},  // sprite 64x64
+    {8393, 7832, 53055},  // sprite 128x128
+    {31967, 30632, 211553},  // sprite 256x256
+    {128552, 120950, 844403},  // sprite 512x512
+    {519553, 480541, 3360490},  // sprite 1024x1024
+    {53, 37, 81},  // sprite 3x5
+    {135, 85, 364},  // sprite 13x7
+    {3312, 3022, 20088},  // sprite 100x60
+    {17121, 16603, 110848},  // sprite 257x129
+    {427, 281, 240},  // alpha_edge 64x64
+    {531, 365, 732},  // alpha_edge 128x128
+    {1251, 829, 1643},  // alpha_edge 256x256
+    {1803, 1307, 2149},  // alpha_edge 512x512
+    {3073, 2114, 3337},  // alpha_edge 1024x1024
+    {53, 37, 49},  // alpha_edge 3x5
+    {107, 77, 77},  // alpha_edge 13x7
+    {595, 381, 419},  // alpha_edge 100x60
+    {1080, 675, 858},  // alpha_edge 257x129
+    {605, 569, 3533},  // normal_map 64x64
+    {2060, 1987, 13891},  // normal_map 128x128
+    {7327, 7344, 55153},  // normal_map 256x256
+    {27291, 26605, 212298},  // normal_map 512x512
+    {104227, 107887, 838198},  // normal_map 1024x1024
+    {53, 37, 81},  // normal_map 3x5
+    {116, 85, 356},  // normal_map 13x7
+    {2858, 2709, 5213},  // normal_map 100x60
+    {14816, 14455, 106089},  // normal_map 257x129
+    {1484, 1442, 7680},  // tileable 64x64
+    {5525, 5392, 41073},  // tileable 128x128
+    {22051, 23202, 187630},  // tileable 256x256
+    {90149, 89729, 767024},  // tileable 512x512
+    {352050, 370432, 2767375},  // tileable 1024x1024
+    {53, 37, 31},  // tileable 3x5
+    {76, 53, 33},  // tileable 13x7
+    {2060, 2018, 12958},  // tileable 100x60
+    {11372, 11887, 91441},  // tileable 257x129
+};
+
+// Single level TEX file of the texture in the given format
+static void build_tex(int format, const uint8_t* rgba, const uint8_t* dxt5, int width, int height,
+                      std::vector<uint8_t>& tex) {
+    long long data_size = tex_level_size(format, width, height);
+    tex.resize(12 + (size_t)data_size);
+    const uint8_t header[12] = {
+        'T', 'E', 'X', 0,
+        (uint8_t)(width & 0xFF), (uint8_t)(width >> 8),
+        (uint8_t)(height & 0xFF), (uint8_t)(height >> 8),
+        1, (uint8_t)format, 0, 0
+    };
+    memcpy(tex.data(), header, 12);
+    uint8_t* data = tex.data() + 12;
+    if (format == TEX_FORMAT_DXT5) {
+        memcpy(data, dxt5, (size_t)data_size);
+    } else if (format == TEX_FORMAT_DXT1) {
+        for (long long block = 0; block < data_size / 8; block++) {
+            memcpy(data + block * 8, dxt5 + block * 16 + 8, 8);
+        }
+    } else {
+        tex_swizzle_bgra(rgba, data, (long long)width * height);
+    }
+}
+
+#ifdef TEX_SIZE_CHECK_ZSTD
+static long long zstd_size(const std::vector<uint8_t>& tex) {
+    std::vector<uint8_t> compressed(ZSTD_compressBound(tex.size()));
+    size_t size = ZSTD_compress(compressed.data(), compressed.size(), tex.data(), tex.size(), 3);
+    return ZSTD_isError(size) ? -1 : (long long)size;
+}
+#endif
+
+int main(int argc, char** argv) {
+    bool verbose = false;
+    bool print_table = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[i], "--print-table") == 0) {
+            print_table = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--verbose] [--print-table]\n", argv[0]);
+            return 1;
+        }
+    }
+#ifndef TEX_SIZE_CHECK_ZSTD
+    if (print_table) {
+        fprintf(stderr, "ERROR: --print-table needs a build with -DTEX_SIZE_CHECK_ZSTD -lzstd\n");
+        return 1;
+    }
+#endif
+
+    double error_sum[FORMAT_COUNT] = {};
+    int error_count[FORMAT_COUNT] = {};
+    double worst_error[FORMAT_COUNT] = {};
+    int failures = 0;
+    std::vector<uint8_t> rgba, dxt5, tex;
+
+    for (int kind = 0; kind < CORPUS_KIND_COUNT; kind++) {
+        const char* kind_name = corpus_kind_name((CorpusKind)kind);
+        for (int s = 0; s < SIZE_COUNT; s++) {
+            int width = SIZES[s][0];
+            int height = SIZES[s][1];
+            rgba.resize((size_t)width * height * 4);
+            dxt5.resize((size_t)tex_level_size(TEX_FORMAT_DXT5, width, height));
+            corpus_generate((CorpusKind)kind, SEED, width, height, rgba.data());
+            compress_dxt5(rgba.data(), width, height, dxt5.data());
+
+            long long actual[FORMAT_COUNT];
+            for (int f = 0; f < FORMAT_COUNT; f++) {
+                build_tex(FORMATS[f].format, rgba.data(), dxt5.data(), width, height, tex);
+#ifdef TEX_SIZE_CHECK_ZSTD
+                actual[f] = zstd_size(tex);
+#else
+                actual[f] = REFERENCE_SIZES[kind * SIZE_COUNT + s][f];
+#endif
+                TexSizeEstimate estimate;
+                int status = tex_estimate_compressed_size(tex.data(), (long long)tex.size(), &estimate);
+                if (status != TEX_OK || actual[f] <= 0) {
+                    printf("FAIL %s %dx%d %s: status %d, zstd size %lld\n", kind_name, width, height,
+                           FORMATS[f].name, status, actual[f]);
+                    failures++;
+                    continue;
+                }
+
+                long long difference = estimate.predicted_bytes - actual[f];
+                double error = (double)difference / actual[f];
+                bool ok = std::fabs(error) <= FILE_TOLERANCE || std::llabs(difference) <= FILE_TOLERANCE_BYTES;
+                if (actual[f] >= MEAN_MIN_BYTES) {
+                    error_sum[f] += std::fabs(error);
+                    error_count[f]++;
+                    worst_error[f] = std::max(worst_error[f], std::fabs(error));
+                }
+                if (!ok) {
+                    failures++;
+                }
+                if (!ok || verbose) {
+                    printf("%s %-10s %4dx%-4d %-5s zstd %8lld predicted %8lld %+6.1f %%\n", ok ? "    " : "FAIL",
+                           kind_name, width, height, FORMATS[f].name, actual[f], estimate.predicted_bytes, error * 100);
+                }
+            }
+            if (print_table) {
+                printf("    {%lld, %lld, %lld},  // %s %dx%d\n", actual[0], actual[1], actual[2], kind_name, width, height);
+            }
+        }
+    }
+
+    printf("Files within %.0f %% or %lld KB of zstd: %s\n", FILE_TOLERANCE * 100, FILE_TOLERANCE_BYTES / 1024,
+           failures ? "no" : "yes");
+    for (int f = 0; f < FORMAT_COUNT; f++) {
+        double mean = error_count[f] ? error_sum[f] / error_count[f] : 0;
+        bool ok = mean <= MEAN_TOLERANCE;
+        printf("%-5s mean error %4.1f %% (limit %.0f %%), worst %4.1f %% over %d files of %lld KB or more%s\n",
+               FORMATS[f].name, mean * 100, MEAN_TOLERANCE * 100, worst_error[f] * 100, error_count[f],
+               MEAN_MIN_BYTES / 1024, ok ? "" : "  FAIL");
+        if (!ok) {
+            failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}
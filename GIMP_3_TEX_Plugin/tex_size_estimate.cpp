@@ -0,0 +1,296 @@
+/*
+Compressed size predictor for TEX files packed into WADs
+
+Predicts the zstd (level 3, the WAD default) size of a TEX file without compressing it, from
+statistics gathered in a single pass over the data:
+  - a greedy match parse like zstd level 3's double fast strategy: candidates are looked up every
+    4 bytes (DXT fields and BGRA8 pixels are 4 byte aligned) from hashes of the next 8 and 5
+    bytes, after the last match distance, and matches are extended back over the literals so
+    the ones starting between two searched positions are found too
+  - the order 0 entropy of the bytes left as literals, per 128 KB zstd block
+The prediction adds the literal and offset bits to per sequence and per block costs fitted
+against zstd 1.5 level 3 on corpus seeds 1 and 2. On seed 3, which the fit did not see, every
+file is within 25 % or 8 KB of zstd, and for files that compress to 4 KB or more the mean error
+is 7 % for DXT5, 3 % for DXT1 and 2 % for BGRA8 (tex_size_check measures this). Smooth
+gradients in DXT5 are overestimated the most, by up to a fifth. The statistics are returned as
+well so tools can show why a texture is large.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "dxt_compress.h"
+#include "tex_trace.h"
+
+static const int CHUNK_BYTES = 128 * 1024;   // zstd block size, literals are entropy coded per block
+static const int MIN_MATCH_BYTES = 5;        // shortest match zstd level 3 looks for
+static const int MIN_REPEAT_BYTES = 4;       // and at a repeat offset
+static const int STRIDE_BYTES = 4;           // matches are searched at every 4th byte
+static const int LONG_KEY_BYTES = 8;         // bytes hashed into the long match table
+static const int SHORT_KEY_BYTES = 5;        // bytes hashed into the short match table
+static const int LONG_TABLE_BITS = 16;
+static const int SHORT_TABLE_BITS = 15;
+static const int REPEAT_OFFSETS = 3;         // zstd keeps the last three match distances
+static const int SEARCH_STRENGTH = 8;        // zstd searches one byte further apart every 256 literal bytes
+static const long long WINDOW_BYTES = 1 << 21;  // zstd level 3 window
+
+// Model fitted against zstd 1.5 level 3 on the corpus (seeds 1 and 2, all three formats):
+// bytes = (literal_bits + offset_bits) / 8 + SEQUENCE * new offset sequences + REPEAT * repeat
+//         offset sequences + FRAME + BLOCK * blocks
+// Literal and offset bits are stored as such by zstd, only the sequence costs are fitted
+static const double MODEL_SEQUENCE = 1.0;
+static const double MODEL_REPEAT = 1.25;
+static const double MODEL_FRAME = 6.0;    // frame header
+static const double MODEL_BLOCK = 3.0;    // block header, per 128 KB of input
+
+// Huffman table cost per distinct literal byte value; below it zstd keeps literals raw, as it
+// always does for fewer than MIN_HUFFMAN_LITERALS of them
+static const double HUFFMAN_TABLE_BYTES_PER_SYMBOL = 0.5;
+static const int MIN_HUFFMAN_LITERALS = 64;
+
+static uint64_t load64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+// Number of equal bytes at a and b, at most limit
+static long long match_length(const uint8_t* a, const uint8_t* b, long long limit) {
+    long long length = 0;
+    while (length + 8 <= limit) {
+        uint64_t diff = load64(a + length) ^ load64(b + length);
+        if (diff) {
+            return length + (__builtin_ctzll(diff) >> 3);
+        }
+        length += 8;
+    }
+    while (length < limit && a[length] == b[length]) {
+        length++;
+    }
+    return length;
+}
+
+// Table index of the first key_bytes bytes of a 64 bit load
+static uint32_t key_hash(uint64_t word, int key_bytes, int table_bits) {
+    return (uint32_t)(((word << (64 - 8 * key_bytes)) * 0x9E3779B97F4A7C15ULL) >> (64 - table_bits));
+}
+
+// Greedy parse of the data into literals and matches, the way zstd's double fast strategy
+// (level 3) sees it, plus the literal byte histograms
+class SizeModel {
+public:
+    SizeModel(uint32_t* long_table, uint32_t* short_table) : long_table_(long_table), short_table_(short_table) {
+        memset(counts_, 0, sizeof(counts_));
+    }
+
+    void parse(const uint8_t* data, long long size) {
+        long long pos = 0;
+        long long anchor = 0;                    // first byte not yet covered by a match
+        long long repeats[REPEAT_OFFSETS] = {};  // zstd's repeat offsets, most recent first
+
+        while (pos + LONG_KEY_BYTES <= size) {
+            const uint8_t* p = data + pos;
+            uint64_t word = load64(p);
+            // Slots hold position + 1, 0 is empty; positions past 4 GB wrap, which only costs
+            // matches since every candidate is compared
+            uint32_t& long_slot = long_table_[key_hash(word, LONG_KEY_BYTES, LONG_TABLE_BITS)];
+            uint32_t& short_slot = short_table_[key_hash(word, SHORT_KEY_BYTES, SHORT_TABLE_BITS)];
+            long long candidates[2] = {pos - ((long long)long_slot - 1), pos - ((long long)short_slot - 1)};
+            long_slot = (uint32_t)(pos + 1);
+            short_slot = (uint32_t)(pos + 1);
+
+            // zstd takes the last distance whenever it matches, then a long match, then a short one
+            long long best_length = 0;
+            long long best_distance = 0;
+            bool repeat = false;
+            if (repeats[0] && repeats[0] <= pos) {
+                best_length = match_length(p, p - repeats[0], size - pos);
+                best_distance = repeats[0];
+                repeat = best_length >= MIN_REPEAT_BYTES;
+            }
+            if (!repeat) {
+                best_length = 0;
+                for (long long distance : candidates) {
+                    if (distance > 0 && distance <= pos && distance <= WINDOW_BYTES) {
+                        long long length = match_length(p, p - distance, size - pos);
+                        if (length > best_length) {
+                            best_length = length;
+                            best_distance = distance;
+                        }
+                    }
+                    if (best_length >= LONG_KEY_BYTES) {
+                        break;
+                    }
+                }
+            }
+
+            if (!repeat && best_length < MIN_MATCH_BYTES) {
+                // Search less often the longer nothing matches, as zstd does on incompressible data
+                pos += STRIDE_BYTES * (1 + ((pos - anchor) >> (SEARCH_STRENGTH + 2)));
+                continue;
+            }
+
+            // Extend the match back over the literals before it, which catches matches that
+            // start between two searched positions
+            long long start = pos;
+            while (start > anchor && start > best_distance && data[start - 1] == data[start - 1 - best_distance]) {
+                start--;
+            }
+            long long end = pos + best_length;
+            add_literals(data + anchor, start - anchor);
+            matched_bytes_ += end - start;
+            sequences_++;
+            if (repeat) {
+                repeat_sequences_++;
+            } else {
+                offset_bits_ += 63 - __builtin_clzll((uint64_t)best_distance);
+                memmove(repeats + 1, repeats, (REPEAT_OFFSETS - 1) * sizeof(long long));
+            }
+            repeats[0] = best_distance;
+
+            // Index the first and last positions the match covered as zstd does, then continue at
+            // the next searched position; the bytes skipped to get there wait as literals
+            long long last_indexed = (end - LONG_KEY_BYTES) / STRIDE_BYTES * STRIDE_BYTES;
+            for (long long next : {pos + STRIDE_BYTES, last_indexed}) {
+                if (next <= pos || next + LONG_KEY_BYTES > end) {
+                    continue;
+                }
+                uint64_t next_word = load64(data + next);
+                long_table_[key_hash(next_word, LONG_KEY_BYTES, LONG_TABLE_BITS)] = (uint32_t)(next + 1);
+                short_table_[key_hash(next_word, SHORT_KEY_BYTES, SHORT_TABLE_BITS)] = (uint32_t)(next + 1);
+            }
+            // zstd then tries the second last distance right where the match ended
+            while (repeats[1] && repeats[1] <= end && end < size) {
+                long long length = match_length(data + end, data + end - repeats[1], size - end);
+                if (length < MIN_REPEAT_BYTES) {
+                    break;
+                }
+                std::swap(repeats[0], repeats[1]);
+                matched_bytes_ += length;
+                sequences_++;
+                repeat_sequences_++;
+                end += length;
+            }
+            anchor = end;
+            pos = (end + STRIDE_BYTES - 1) / STRIDE_BYTES * STRIDE_BYTES;
+        }
+        add_literals(data + anchor, size - anchor);
+    }
+
+    void finish(TexSizeEstimate* estimate) {
+        flush_chunk();
+        estimate->literal_bytes = literal_bytes_;
+        estimate->literal_entropy_bits = literal_bits_;
+        estimate->matched_bytes = matched_bytes_;
+        estimate->sequences = sequences_;
+        estimate->repeat_sequences = repeat_sequences_;
+        // zstd stores a block raw when compressing it does not pay off
+        long long blocks = (estimate->raw_bytes + CHUNK_BYTES - 1) / CHUNK_BYTES;
+        double overhead = MODEL_FRAME + MODEL_BLOCK * blocks;
+        double predicted = (literal_bits_ + offset_bits_) / 8 + MODEL_SEQUENCE * (sequences_ - repeat_sequences_) +
+                           MODEL_REPEAT * repeat_sequences_ + overhead;
+        predicted = std::min(predicted, estimate->raw_bytes + overhead);
+        estimate->predicted_bytes = (long long)std::ceil(predicted);
+    }
+
+private:
+    void add_literals(const uint8_t* bytes, long long count) {
+        while (count > 0) {
+            int piece = (int)std::min(count, (long long)(CHUNK_BYTES - chunk_literals_));
+            count_literals(bytes, piece);
+            bytes += piece;
+            count -= piece;
+            if (chunk_literals_ == CHUNK_BYTES) {
+                flush_chunk();
+            }
+        }
+    }
+
+    void count_literals(const uint8_t* bytes, int count) {
+        // Four interleaved histograms so runs of equal bytes do not serialize on one counter
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint32_t quad;
+            memcpy(&quad, bytes + i, 4);
+            counts_[0][quad & 0xFF]++;
+            counts_[1][(quad >> 8) & 0xFF]++;
+            counts_[2][(quad >> 16) & 0xFF]++;
+            counts_[3][quad >> 24]++;
+        }
+        for (; i < count; i++) {
+            counts_[i & 3][bytes[i]]++;
+        }
+        chunk_literals_ += count;
+    }
+
+    // Entropy of the chunk's literals, or their raw size when a Huffman table does not pay off
+    void flush_chunk() {
+        if (chunk_literals_ == 0) {
+            return;
+        }
+        double bits = 0;
+        int symbols = 0;
+        double inv_total = 1.0 / chunk_literals_;
+        for (int i = 0; i < 256; i++) {
+            uint32_t count = counts_[0][i] + counts_[1][i] + counts_[2][i] + counts_[3][i];
+            if (count) {
+                bits -= count * std::log2(count * inv_total);
+                symbols++;
+            }
+        }
+        bits += symbols * HUFFMAN_TABLE_BYTES_PER_SYMBOL * 8;
+        bool huffman = chunk_literals_ >= MIN_HUFFMAN_LITERALS && bits < chunk_literals_ * 8.0;
+        literal_bits_ += huffman ? bits : chunk_literals_ * 8.0;
+        literal_bytes_ += chunk_literals_;
+        chunk_literals_ = 0;
+        memset(counts_, 0, sizeof(counts_));
+    }
+
+    uint32_t* long_table_;
+    uint32_t* short_table_;
+    uint32_t counts_[4][256];
+    long long chunk_literals_ = 0;
+    double literal_bits_ = 0;
+    long long literal_bytes_ = 0;
+    long long matched_bytes_ = 0;
+    long long sequences_ = 0;
+    long long repeat_sequences_ = 0;
+    long long offset_bits_ = 0;
+};
+
+extern "C" {
+
+__declspec(dllexport) int tex_estimate_compressed_size(const uint8_t* tex, long long size, TexSizeEstimate* estimate) {
+    TEX_TRACE_SCOPE("codec", "size_estimate");
+    if (!tex || !estimate || size < 12) {
+        return TEX_ERR_ARGS;
+    }
+    memset(estimate, 0, sizeof(*estimate));
+
+    TexHeader header;
+    int status = tex_parse_header(tex, &header);
+    if (status != TEX_OK) {
+        return status;
+    }
+    long long data_size = tex_level_offset(header, 0) + tex_level_size(header.format, header.width, header.height);
+    if (size < 12 + data_size) {
+        return TEX_ERR_FORMAT;
+    }
+
+    TexBuffer tables(sizeof(uint32_t) * ((1 << LONG_TABLE_BITS) + (1 << SHORT_TABLE_BITS)));
+    if (!tables.ok()) {
+        return TEX_ERR_NOMEM;
+    }
+    memset(tables.data(), 0, tables.size());
+    uint32_t* long_table = (uint32_t*)tables.data();
+    SizeModel model(long_table, long_table + (1 << LONG_TABLE_BITS));
+    model.parse(tex, 12 + data_size);
+
+    estimate->raw_bytes = 12 + data_size;
+    model.finish(estimate);
+    return TEX_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,585 @@
+/*
+Persistent thumbnail cache for TEX files
+
+All thumbnails live in one packed file that is memory mapped by every user:
+
+    [CacheFileHeader][slot_count x CacheSlot][data region]
+
+Slots are an open addressed index keyed by (path hash, mtime, file size, dimension).
+Thumbnails are appended to the data region; when it fills up the writer invalidates
+every slot and starts again from the front.
+
+Readers never take a lock. Each slot carries a sequence counter that the writer makes
+odd while the slot (or the data it points to) is being changed, so a reader that sees
+the same even value before and after copying knows the copy is consistent.
+
+Only one writer may have a cache file open at a time: a writable open takes an exclusive
+lock on <cache>.lock (flock, LockFileEx on Windows) and falls back to a read only cache when
+another process holds it. A missing or damaged cache file is rebuilt as <cache>.tmp and
+renamed over the old one, so readers that still have the old file mapped keep a complete
+cache instead of one truncated under them.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "dxt_compress.h"
+#include "tex_trace.h"
+
+static const char CACHE_MAGIC[8] = {'T', 'E', 'X', 'T', 'H', 'M', 'B', '1'};
+static const int CACHE_MAX_PROBES = 16;
+
+struct CacheFileHeader {
+    char magic[8];
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t data_capacity;
+    std::atomic<uint64_t> data_used;
+    std::atomic<uint32_t> generation;
+    uint8_t padding[28];
+};
+
+struct CacheSlot {
+    std::atomic<uint32_t> seq;  // odd while the writer is changing this slot
+    uint32_t dim;               // requested thumbnail dimension, 0 = empty slot
+    uint64_t path_hash;
+    int64_t mtime;
+    uint64_t file_size;
+    uint64_t data_offset;
+    uint32_t data_size;
+    uint16_t thumb_width;
+    uint16_t thumb_height;
+    uint8_t padding[16];
+};
+
+static_assert(sizeof(CacheFileHeader) == 64, "cache header must stay 64 bytes");
+static_assert(sizeof(CacheSlot) == 64, "cache slot must stay one cache line");
+
+struct ThumbCache {
+    uint8_t* base;
+    uint64_t mapped_size;
+    bool writable;
+    std::mutex write_lock;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+    HANDLE lock_file = INVALID_HANDLE_VALUE;
+#else
+    int fd;
+    int lock_fd = -1;
+#endif
+
+    CacheFileHeader* header() { return (CacheFileHeader*)base; }
+    CacheSlot* slots() { return (CacheSlot*)(base + sizeof(CacheFileHeader)); }
+    uint8_t* data() { return base + sizeof(CacheFileHeader) + (uint64_t)header()->slot_count * sizeof(CacheSlot); }
+};
+
+struct ThumbKey {
+    uint64_t path_hash;
+    int64_t mtime;
+    uint64_t file_size;
+    uint32_t dim;
+};
+
+// FNV-1a, good enough to spread paths over the slot table
+static uint64_t hash_path(const char* path) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char* p = path; *p; p++) {
+        hash ^= (uint8_t)*p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool stat_file(const char* path, int64_t* mtime, uint64_t* file_size) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path, &st) != 0) {
+        return false;
+    }
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+#endif
+    *mtime = (int64_t)st.st_mtime;
+    *file_size = (uint64_t)st.st_size;
+    return true;
+}
+
+static int seek_file(FILE* f, long long offset) {
+#ifdef _WIN32
+    return _fseeki64(f, offset, SEEK_SET);
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET);
+#endif
+}
+
+// Maps an existing cache file (size 0) or creates a new one of the given size, replacing any
+// file already at path. Existing files shorter than the header are refused before mapping.
+static bool map_cache_file(ThumbCache* cache, const char* path, uint64_t size) {
+    bool create = size != 0;
+#ifdef _WIN32
+    DWORD access = cache->writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+    cache->file = CreateFileA(path, access, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                              create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (cache->file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    if (!create) {
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(cache->file, &file_size) || (uint64_t)file_size.QuadPart < sizeof(CacheFileHeader)) {
+            CloseHandle(cache->file);
+            return false;
+        }
+        size = (uint64_t)file_size.QuadPart;
+    }
+    cache->mapping = CreateFileMappingA(cache->file, NULL, cache->writable ? PAGE_READWRITE : PAGE_READONLY,
+                                        (DWORD)(size >> 32), (DWORD)size, NULL);
+    if (!cache->mapping) {
+        CloseHandle(cache->file);
+        return false;
+    }
+    cache->base = (uint8_t*)MapViewOfFile(cache->mapping, cache->writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+    if (!cache->base) {
+        CloseHandle(cache->mapping);
+        CloseHandle(cache->file);
+        return false;
+    }
+#else
+    cache->fd = open(path, cache->writable ? (O_RDWR | (create ? O_CREAT | O_TRUNC : 0)) : O_RDONLY, 0644);
+    if (cache->fd < 0) {
+        return false;
+    }
+    if (!create) {
+        struct stat st;
+        if (fstat(cache->fd, &st) != 0 || (uint64_t)st.st_size < sizeof(CacheFileHeader)) {
+            close(cache->fd);
+            return false;
+        }
+        size = (uint64_t)st.st_size;
+    } else if (ftruncate(cache->fd, (off_t)size) != 0) {
+        close(cache->fd);
+        return false;
+    }
+    void* base = mmap(NULL, size, cache->writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, cache->fd, 0);
+    if (base == MAP_FAILED) {
+        close(cache->fd);
+        return false;
+    }
+    cache->base = (uint8_t*)base;
+#endif
+    cache->mapped_size = size;
+    return true;
+}
+
+static void unmap_cache_file(ThumbCache* cache) {
+#ifdef _WIN32
+    UnmapViewOfFile(cache->base);
+    CloseHandle(cache->mapping);
+    CloseHandle(cache->file);
+#else
+    munmap(cache->base, cache->mapped_size);
+    close(cache->fd);
+#endif
+    cache->base = nullptr;
+}
+
+// A mapped file is a usable cache when its geometry accounts for exactly the mapped bytes.
+// map_cache_file has made sure the header itself is there.
+static bool cache_file_valid(ThumbCache* cache) {
+    CacheFileHeader* header = cache->header();
+    if (memcmp(header->magic, CACHE_MAGIC, 8) != 0 || header->slot_count == 0) {
+        return false;
+    }
+    uint64_t slots_end = sizeof(CacheFileHeader) + (uint64_t)header->slot_count * sizeof(CacheSlot);
+    return slots_end <= cache->mapped_size && header->data_capacity == cache->mapped_size - slots_end &&
+           header->data_used.load(std::memory_order_relaxed) <= header->data_capacity;
+}
+
+// Exclusive writer lock on <cache_path>.lock, held until the cache is closed. It lives beside
+// the cache file because a rebuild replaces that file. Fails when another writer holds it.
+static bool lock_writer(ThumbCache* cache, const char* cache_path) {
+    std::string lock_path = std::string(cache_path) + ".lock";
+#ifdef _WIN32
+    cache->lock_file = CreateFileA(lock_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                   NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (cache->lock_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    OVERLAPPED overlapped = {};
+    if (!LockFileEx(cache->lock_file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped)) {
+        CloseHandle(cache->lock_file);
+        cache->lock_file = INVALID_HANDLE_VALUE;
+        return false;
+    }
+#else
+    cache->lock_fd = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (cache->lock_fd < 0) {
+        return false;
+    }
+    if (flock(cache->lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        close(cache->lock_fd);
+        cache->lock_fd = -1;
+        return false;
+    }
+#endif
+    return true;
+}
+
+// Closing the lock file releases the lock
+static void unlock_writer(ThumbCache* cache) {
+#ifdef _WIN32
+    if (cache->lock_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(cache->lock_file);
+        cache->lock_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (cache->lock_fd >= 0) {
+        close(cache->lock_fd);
+        cache->lock_fd = -1;
+    }
+#endif
+}
+
+// Atomically puts from in place of to. Windows refuses while another process has the old file
+// open without FILE_SHARE_DELETE.
+static bool replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+static bool slot_matches(const CacheSlot& slot, const ThumbKey& key) {
+    return slot.dim == key.dim && slot.path_hash == key.path_hash &&
+           slot.mtime == key.mtime && slot.file_size == key.file_size;
+}
+
+// Lock-free lookup, copies the thumbnail out if a consistent matching slot is found
+static bool cache_lookup(ThumbCache* cache, const ThumbKey& key, uint8_t* rgba, int* out_width, int* out_height) {
+    CacheFileHeader* header = cache->header();
+    uint32_t slot_count = header->slot_count;
+    CacheSlot* slots = cache->slots();
+
+    for (int probe = 0; probe < CACHE_MAX_PROBES; probe++) {
+        CacheSlot& slot = slots[(key.path_hash + probe) % slot_count];
+
+        uint32_t seq_before = slot.seq.load(std::memory_order_acquire);
+        if (seq_before & 1) {
+            continue;  // being rewritten, treat as a miss for this probe
+        }
+        if (slot.dim == 0) {
+            return false;
+        }
+        if (!slot_matches(slot, key)) {
+            continue;
+        }
+
+        // A writer may be changing the slot under us and the file may be damaged, so everything
+        // that sizes the copy is checked against the caller's buffer and the data region before
+        // the copy; the seq check below only decides whether the copy is kept
+        uint64_t data_offset = slot.data_offset;
+        uint64_t data_size = slot.data_size;
+        uint32_t width = slot.thumb_width;
+        uint32_t height = slot.thumb_height;
+        uint64_t data_capacity = header->data_capacity;
+        if (width == 0 || height == 0 || width > key.dim || height > key.dim ||
+            data_size != (uint64_t)width * height * 4 ||
+            data_offset > data_capacity || data_size > data_capacity - data_offset) {
+            return false;
+        }
+        memcpy(rgba, cache->data() + data_offset, data_size);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq_before) {
+            return false;
+        }
+        *out_width = (int)width;
+        *out_height = (int)height;
+        return true;
+    }
+    return false;
+}
+
+static void slot_begin_write(CacheSlot& slot) {
+    slot.seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+static void slot_end_write(CacheSlot& slot) {
+    slot.seq.fetch_add(1, std::memory_order_release);
+}
+
+// Writer side, caller holds write_lock
+static void cache_store(ThumbCache* cache, const ThumbKey& key, const uint8_t* rgba, int width, int height) {
+    CacheFileHeader* header = cache->header();
+    CacheSlot* slots = cache->slots();
+    uint64_t data_size = (uint64_t)width * height * 4;
+
+    // The slot stores 32 bit sizes
+    if (data_size > header->data_capacity || data_size > UINT32_MAX) {
+        return;
+    }
+
+    // Out of space: invalidate everything before the data region gets overwritten
+    uint64_t data_offset = header->data_used.load(std::memory_order_relaxed);
+    if (data_offset + data_size > header->data_capacity) {
+        for (uint32_t i = 0; i < header->slot_count; i++) {
+            if (slots[i].dim != 0) {
+                slot_begin_write(slots[i]);
+                slots[i].dim = 0;
+                slot_end_write(slots[i]);
+            }
+        }
+        header->generation.fetch_add(1, std::memory_order_relaxed);
+        data_offset = 0;
+    }
+
+    // Pick the matching slot, else the first empty one, else evict the home slot
+    uint32_t slot_count = header->slot_count;
+    CacheSlot* target = &slots[key.path_hash % slot_count];
+    for (int probe = 0; probe < CACHE_MAX_PROBES; probe++) {
+        CacheSlot& slot = slots[(key.path_hash + probe) % slot_count];
+        if (slot.dim == 0 || slot_matches(slot, key)) {
+            target = &slot;
+            break;
+        }
+    }
+
+    slot_begin_write(*target);
+    memcpy(cache->data() + data_offset, rgba, data_size);
+    target->dim = key.dim;
+    target->path_hash = key.path_hash;
+    target->mtime = key.mtime;
+    target->file_size = key.file_size;
+    target->data_offset = data_offset;
+    target->data_size = (uint32_t)data_size;
+    target->thumb_width = (uint16_t)width;
+    target->thumb_height = (uint16_t)height;
+    slot_end_write(*target);
+
+    // Keep thumbnails 64 byte aligned inside the data region
+    header->data_used.store((data_offset + data_size + 63) & ~(uint64_t)63, std::memory_order_release);
+}
+
+// Area average downsample of an RGBA image into a thumbnail
+static void downsample_rgba(const uint8_t* src, int src_width, int src_height, uint8_t* dst, int dst_width, int dst_height) {
+    for (int ty = 0; ty < dst_height; ty++) {
+        int y0 = (int)((long long)ty * src_height / dst_height);
+        int y1 = std::max(y0 + 1, (int)((long long)(ty + 1) * src_height / dst_height));
+        for (int tx = 0; tx < dst_width; tx++) {
+            int x0 = (int)((long long)tx * src_width / dst_width);
+            int x1 = std::max(x0 + 1, (int)((long long)(tx + 1) * src_width / dst_width));
+
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* row = src + ((long long)y * src_width + x0) * 4;
+                for (int x = 0; x < x1 - x0; x++) {
+                    sum[0] += row[x * 4];
+                    sum[1] += row[x * 4 + 1];
+                    sum[2] += row[x * 4 + 2];
+                    sum[3] += row[x * 4 + 3];
+                }
+            }
+
+            uint32_t count = (uint32_t)((y1 - y0) * (x1 - x0));
+            uint8_t* out = dst + ((long long)ty * dst_width + tx) * 4;
+            for (int c = 0; c < 4; c++) {
+                out[c] = (uint8_t)((sum[c] + count / 2) / count);
+            }
+        }
+    }
+}
+
+// Decode the smallest mip level that still covers max_dim and shrink it to fit
+static int generate_thumbnail(const char* tex_path, int max_dim, uint8_t* rgba, int* out_width, int* out_height) {
+    FILE* f = fopen(tex_path, "rb");
+    if (!f) {
+        return TEX_ERR_IO;
+    }
+
+    uint8_t header_bytes[12];
+    TexHeader header;
+    if (fread(header_bytes, 1, 12, f) != 12 || tex_parse_header(header_bytes, &header) != TEX_OK) {
+        fclose(f);
+        return TEX_ERR_FORMAT;
+    }
+
+    // Mip aware: pick the smallest level whose larger side is still >= max_dim
+    int level = 0;
+    if (header.mipmaps) {
+        int mipmap_count = tex_mipmap_count(header.width, header.height);
+        while (level + 1 < mipmap_count &&
+               std::max(std::max(header.width >> (level + 1), 1), std::max(header.height >> (level + 1), 1)) >= max_dim) {
+            level++;
+        }
+    }
+    int level_width = std::max(header.width >> level, 1);
+    int level_height = std::max(header.height >> level, 1);
+    long long level_size = tex_level_size(header.format, level_width, level_height);
+
+    TexBuffer level_data((size_t)level_size);
+    TexBuffer level_rgba((size_t)level_width * level_height * 4);
+    if (!level_data.ok() || !level_rgba.ok()) {
+        fclose(f);
+        return TEX_ERR_NOMEM;
+    }
+
+    {
+        TEX_TRACE_SCOPE("io", "read_level");
+        if (seek_file(f, 12 + tex_level_offset(header, level)) != 0 ||
+            fread(level_data.data(), 1, (size_t)level_size, f) != (size_t)level_size) {
+            fclose(f);
+            return TEX_ERR_IO;
+        }
+        fclose(f);
+    }
+
+    int status = tex_decode_level(header.format, level_data.data(), level_width, level_height, level_rgba.data());
+    if (status != TEX_OK) {
+        return status;
+    }
+
+    // Fit inside max_dim x max_dim keeping the aspect ratio, never upscale
+    int largest = std::max(level_width, level_height);
+    int thumb_width = level_width;
+    int thumb_height = level_height;
+    if (largest > max_dim) {
+        thumb_width = std::max(1, (int)((long long)level_width * max_dim / largest));
+        thumb_height = std::max(1, (int)((long long)level_height * max_dim / largest));
+    }
+
+    {
+        TEX_TRACE_SCOPE("mip", "thumbnail_downsample");
+        downsample_rgba(level_rgba.data(), level_width, level_height, rgba, thumb_width, thumb_height);
+    }
+    *out_width = thumb_width;
+    *out_height = thumb_height;
+    return TEX_OK;
+}
+
+static void destroy_cache(ThumbCache* cache) {
+    unlock_writer(cache);
+    cache->~ThumbCache();
+    tex_free(cache, sizeof(ThumbCache));
+}
+
+extern "C" {
+
+// Open (or create when writable) a cache file. Returns NULL on failure. A writable open while
+// another writer has the file gives a read only cache.
+// slot_count and data_capacity are only used when a new file is created.
+__declspec(dllexport) void* tex_thumbcache_open(const char* cache_path, int slot_count, long long data_capacity, int writable) {
+    void* memory = tex_alloc(sizeof(ThumbCache));
+    if (!memory) {
+        return nullptr;
+    }
+    ThumbCache* cache = new (memory) ThumbCache();
+    cache->writable = writable != 0 && lock_writer(cache, cache_path);
+
+    // Existing cache file: map it with whatever geometry it was created with
+    if (map_cache_file(cache, cache_path, 0)) {
+        if (cache_file_valid(cache)) {
+            return cache;
+        }
+        unmap_cache_file(cache);
+    }
+    if (!cache->writable || slot_count <= 0 || data_capacity <= 0) {
+        destroy_cache(cache);
+        return nullptr;
+    }
+
+    // Build a fresh cache file beside the old one, then rename it into place
+    std::string temp_path = std::string(cache_path) + ".tmp";
+    uint64_t total_size = sizeof(CacheFileHeader) + (uint64_t)slot_count * sizeof(CacheSlot) + (uint64_t)data_capacity;
+    if (!map_cache_file(cache, temp_path.c_str(), total_size)) {
+        destroy_cache(cache);
+        return nullptr;
+    }
+    memset(cache->base, 0, sizeof(CacheFileHeader) + (size_t)slot_count * sizeof(CacheSlot));
+    CacheFileHeader* header = cache->header();
+    header->slot_count = (uint32_t)slot_count;
+    header->data_capacity = (uint64_t)data_capacity;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, CACHE_MAGIC, 8);
+    unmap_cache_file(cache);
+
+    if (!replace_file(temp_path.c_str(), cache_path)) {
+        remove(temp_path.c_str());
+        destroy_cache(cache);
+        return nullptr;
+    }
+    if (!map_cache_file(cache, cache_path, 0)) {
+        destroy_cache(cache);
+        return nullptr;
+    }
+    if (!cache_file_valid(cache)) {
+        unmap_cache_file(cache);
+        destroy_cache(cache);
+        return nullptr;
+    }
+    return cache;
+}
+
+__declspec(dllexport) void tex_thumbcache_close(void* cache) {
+    ThumbCache* thumb_cache = (ThumbCache*)cache;
+    if (!thumb_cache) {
+        return;
+    }
+    unmap_cache_file(thumb_cache);
+    destroy_cache(thumb_cache);
+}
+
+// Fetch a thumbnail of at most max_dim x max_dim pixels into rgba (max_dim * max_dim * 4 bytes).
+// Returns 1 for a cache hit, 0 when it was generated, or a negative TEX_ERR_* code.
+// cache may be NULL to decode without caching.
+__declspec(dllexport) int tex_thumbnail(void* cache, const char* tex_path, int max_dim, uint8_t* rgba, int* out_width, int* out_height) {
+    if (!tex_path || !rgba || !out_width || !out_height || max_dim <= 0 || max_dim > 65535) {
+        return TEX_ERR_ARGS;
+    }
+
+    ThumbCache* thumb_cache = (ThumbCache*)cache;
+    ThumbKey key;
+    if (!stat_file(tex_path, &key.mtime, &key.file_size)) {
+        return TEX_ERR_IO;
+    }
+    key.path_hash = hash_path(tex_path);
+    key.dim = (uint32_t)max_dim;
+
+    if (thumb_cache && cache_lookup(thumb_cache, key, rgba, out_width, out_height)) {
+        return 1;
+    }
+
+    int status = generate_thumbnail(tex_path, max_dim, rgba, out_width, out_height);
+    if (status != TEX_OK) {
+        return status;
+    }
+
+    if (thumb_cache && thumb_cache->writable) {
+        std::lock_guard<std::mutex> lock(thumb_cache->write_lock);
+        cache_store(thumb_cache, key, rgba, *out_width, *out_height);
+    }
+    return 0;
+}
+
+} // extern "C"
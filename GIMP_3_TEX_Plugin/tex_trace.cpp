@@ -0,0 +1,89 @@
+/*
+Per thread event rings behind the TEX_TRACE_* macros (see tex_trace.h)
+Only compiled into anything when TEX_TRACE is defined.
+*/
+
+#ifdef TEX_TRACE
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "dxt_compress.h"
+#include "tex_trace.h"
+
+static const uint64_t RING_EVENTS = 1 << 15;  // 1 MB per thread
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+// Written only by its owning thread; head is published with release so the dump sees
+// complete events
+struct TraceRing {
+    int tid;
+    std::atomic<uint64_t> head{0};
+    TraceEvent events[RING_EVENTS];
+};
+
+static const auto g_epoch = std::chrono::steady_clock::now();
+static std::mutex g_rings_mutex;
+static std::vector<TraceRing*> g_rings;  // never freed, pool threads outlive any dump
+static thread_local TraceRing* t_ring = nullptr;
+
+// The registry lock is taken once per thread, on its first event
+static TraceRing* thread_ring() {
+    if (!t_ring) {
+        TraceRing* ring = new TraceRing();
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        ring->tid = (int)g_rings.size() + 1;
+        g_rings.push_back(ring);
+        t_ring = ring;
+    }
+    return t_ring;
+}
+
+uint64_t tex_trace_now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+void tex_trace_record(const char* category, const char* name, uint64_t start_ns, uint64_t end_ns) {
+    TraceRing* ring = thread_ring();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->events[head % RING_EVENTS] = {category, name, start_ns, end_ns};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+extern "C" __declspec(dllexport) int tex_trace_dump(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return TEX_ERR_IO;
+    }
+
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"tex\"}}");
+    for (TraceRing* ring : g_rings) {
+        fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+                ring->tid, ring->tid);
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first = head > RING_EVENTS ? head - RING_EVENTS : 0;
+        for (uint64_t i = first; i < head; i++) {
+            const TraceEvent& e = ring->events[i % RING_EVENTS];
+            fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                    e.name, e.category, ring->tid, e.start_ns / 1000.0, (e.end_ns - e.start_ns) / 1000.0);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    bool ok = fclose(f) == 0;
+    return ok ? TEX_OK : TEX_ERR_IO;
+}
+
+#endif // TEX_TRACE
@@ -0,0 +1,48 @@
+/*
+Compile time optional timeline tracing in Chrome trace event format
+
+Build with -DTEX_TRACE (and tex_trace.cpp) to record; otherwise every macro expands to nothing.
+Each thread appends events to its own fixed size ring buffer, so recording takes no locks;
+when a buffer fills the oldest events are overwritten. Call tex_trace_dump() after the traced
+work has finished and open the file in chrome://tracing or https://ui.perfetto.dev.
+
+Categories used: parse, codec, mip, io, queue. Names must be string literals.
+*/
+
+#ifndef TEX_TRACE_H
+#define TEX_TRACE_H
+
+#ifdef TEX_TRACE
+
+#include <cstdint>
+
+uint64_t tex_trace_now();
+void tex_trace_record(const char* category, const char* name, uint64_t start_ns, uint64_t end_ns);
+
+// Writes every recorded event to path, returns TEX_OK or TEX_ERR_IO
+extern "C" __declspec(dllexport) int tex_trace_dump(const char* path);
+
+// Records one complete event covering the enclosing scope
+class TexTraceScope {
+public:
+    TexTraceScope(const char* category, const char* name) : category_(category), name_(name), start_(tex_trace_now()) {}
+    ~TexTraceScope() { tex_trace_record(category_, name_, start_, tex_trace_now()); }
+
+private:
+    const char* category_;
+    const char* name_;
+    uint64_t start_;
+};
+
+#define TEX_TRACE_CONCAT_(a, b) a##b
+#define TEX_TRACE_CONCAT(a, b) TEX_TRACE_CONCAT_(a, b)
+#define TEX_TRACE_SCOPE(category, name) TexTraceScope TEX_TRACE_CONCAT(tex_trace_scope_, __LINE__)(category, name)
+
+#else
+
+// sizeof keeps non literal names "used" without evaluating anything
+#define TEX_TRACE_SCOPE(category, name) do { (void)sizeof(category); (void)sizeof(name); } while (0)
+
+#endif // TEX_TRACE
+
+#endif // TEX_TRACE_H